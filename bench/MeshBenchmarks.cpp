@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "OBJLoader.h"
+#include "SyntheticData.h"
+#include "VertexFormat.h"
+
+//Every mesh benchmark takes the number of grid cells along a side, so it runs over 2 * quads^2 triangles
+
+static void BM_ParseOBJ(benchmark::State& state)
+{
+	std::string text = makeGridOBJ((int)state.range(0));
+	OBJMesh mesh;
+	for (auto _ : state)
+	{
+		parseOBJ(text.data(), text.size(), mesh);
+		benchmark::DoNotOptimize(mesh.corners.data());
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+	state.counters["triangles"] = (double)(mesh.corners.size() / 3);
+}
+BENCHMARK(BM_ParseOBJ)->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+static void BM_BuildIndexedMesh(benchmark::State& state)
+{
+	std::string text = makeGridOBJ((int)state.range(0));
+	OBJMesh mesh;
+	parseOBJ(text.data(), text.size(), mesh);
+	std::vector<Vertex> vertices;
+	std::vector<Normal> normals;
+	std::vector<UV> uvs;
+	expandOBJ(mesh, vertices, normals, uvs);
+	for (auto _ : state)
+	{
+		IndexedMesh indexed;
+		buildIndexedMesh(vertices, normals, uvs, indexed);
+		benchmark::DoNotOptimize(indexed.indices.data());
+	}
+	state.SetItemsProcessed(state.iterations() * vertices.size());
+}
+BENCHMARK(BM_BuildIndexedMesh)->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+//Includes copying the index buffer back to file order every iteration, which is small next to the optimization
+static void BM_OptimizeVertexCache(benchmark::State& state)
+{
+	std::string text = makeGridOBJ((int)state.range(0));
+	OBJMesh mesh;
+	parseOBJ(text.data(), text.size(), mesh);
+	std::vector<Vertex> vertices;
+	std::vector<Normal> normals;
+	std::vector<UV> uvs;
+	expandOBJ(mesh, vertices, normals, uvs);
+	IndexedMesh indexed;
+	buildIndexedMesh(vertices, normals, uvs, indexed);
+	std::vector<uint32_t> indices;
+	for (auto _ : state)
+	{
+		indices = indexed.indices;
+		optimizeVertexCache(&indices[0], indices.size(), indexed.vertices.size());
+		benchmark::DoNotOptimize(indices.data());
+	}
+	state.SetItemsProcessed(state.iterations() * indices.size() / 3);
+	state.counters["ACMR"] = computeACMR(&indices[0], indices.size(), indexed.vertices.size());
+}
+BENCHMARK(BM_OptimizeVertexCache)->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+
+//Everything loading an .obj without a baked mesh does on the CPU: parsing, indexing, both optimizations and baking to the demo's vertex format
+static void BM_LoadOBJ(benchmark::State& state)
+{
+	std::string text = makeGridOBJ((int)state.range(0));
+	const VertexFormat format = { PositionFormat::Unorm16, NormalFormat::Octahedral16, UVFormat::Half };
+	SourceStamp stamp;
+	std::vector<char> baked;
+	for (auto _ : state)
+	{
+		OBJMesh mesh;
+		parseOBJ(text.data(), text.size(), mesh);
+		std::vector<Vertex> vertices;
+		std::vector<Normal> normals;
+		std::vector<UV> uvs;
+		expandOBJ(mesh, vertices, normals, uvs);
+		IndexedMesh indexed;
+		buildIndexedMesh(vertices, normals, uvs, indexed);
+		optimizeVertexCache(&indexed.indices[0], indexed.indices.size(), indexed.vertices.size());
+		optimizeVertexFetch(indexed);
+		bakeMesh(indexed, format, stamp, baked);
+		benchmark::DoNotOptimize(baked.data());
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_LoadOBJ)->Arg(16)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,186 @@
+#include <benchmark/benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "HeightField.h"
+#include "InstanceCulling.h"
+#include "InstanceTransform.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+#include "Scatter.h"
+#include "ShadowCascades.h"
+#include "SyntheticData.h"
+#include "TerrainLOD.h"
+
+static const float TERRAIN_SIZE = 50.f;
+static const int TERRAIN_SAMPLES = 256;
+
+//A camera standing on the terrain, looking over it the way the demo starts
+static glm::mat4 getCameraView()
+{
+	return glm::lookAt(glm::vec3(20.f, 4.f, 20.f), glm::vec3(45.f, 2.f, 40.f), glm::vec3(0.f, 1.f, 0.f));
+}
+
+static glm::mat4 getCameraProjection()
+{
+	return glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.5f, 150.f);
+}
+
+//Takes the tree density like the demo's --tree-density, the scatter's minimum distance shrinks with its square root
+static void BM_ScatterInstances(benchmark::State& state)
+{
+	std::vector<float> heights = makeTerrainHeights(TERRAIN_SAMPLES);
+	HeightField field = { heights.data(), TERRAIN_SAMPLES, TERRAIN_SIZE };
+	ScatterSettings settings;
+	settings.size = TERRAIN_SIZE;
+	settings.minDistance = 3.f / std::sqrt((float)state.range(0));
+	settings.maxSlope = glm::radians(35.f);
+	JobSystem jobs;
+	ScatterInstances instances;
+	for (auto _ : state)
+	{
+		scatterInstances(settings, [&field](float x, float z) { return sampleHeight(field, x, z); }, jobs, instances);
+		benchmark::DoNotOptimize(instances.x.data());
+	}
+	state.counters["instances"] = (double)instances.x.size();
+}
+BENCHMARK(BM_ScatterInstances)->Arg(1)->Arg(16)->Arg(256)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_CullInstances(benchmark::State& state)
+{
+	size_t count = (size_t)state.range(0);
+	std::vector<glm::vec3> centers = makeRandomPoints(count, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE, 3.f, TERRAIN_SIZE));
+	InstanceBounds bounds;
+	for (const glm::vec3& center : centers)
+		addInstance(bounds, center, 1.f);
+	Frustum frustum = extractFrustum(getCameraProjection() * getCameraView());
+	std::vector<uint32_t> visible;
+	for (auto _ : state)
+	{
+		cullInstances(frustum, bounds, visible);
+		benchmark::DoNotOptimize(visible.data());
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+	state.counters["visible"] = (double)visible.size();
+}
+BENCHMARK(BM_CullInstances)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+//Hills as high as the demo's height map, the synthetic ones only rise 2 units
+static std::vector<float> makeHillyHeights()
+{
+	std::vector<float> heights = makeTerrainHeights(TERRAIN_SAMPLES);
+	for (float& height : heights)
+		height *= 4.f;
+	return heights;
+}
+
+//A camera standing between the hills, so the ones in front hide part of the terrain
+static glm::mat4 getHillCameraViewProjection(const HeightField& field)
+{
+	glm::vec3 eye(20.f, sampleHeight(field, 20.f, 20.f) + 3.f, 20.f);
+	return getCameraProjection() * glm::lookAt(eye, glm::vec3(45.f, eye.y - 2.f, 40.f), glm::vec3(0.f, 1.f, 0.f));
+}
+
+//Takes the number of occluder cells along each side
+static void BM_RasterizeOccluders(benchmark::State& state)
+{
+	std::vector<float> heights = makeHillyHeights();
+	HeightField field = { heights.data(), TERRAIN_SAMPLES, TERRAIN_SIZE };
+	OccluderMesh occluder;
+	buildTerrainOccluder(field, (int)state.range(0), occluder);
+	glm::mat4 viewProjection = getHillCameraViewProjection(field);
+	JobSystem jobs;
+	OcclusionBuffer buffer;
+	initOcclusionBuffer(buffer, 256, 144);
+	for (auto _ : state)
+	{
+		rasterizeOccluders(buffer, viewProjection, occluder, jobs);
+		benchmark::DoNotOptimize(buffer.levels[0].depth.data());
+	}
+	state.counters["triangles"] = (double)buffer.triangles.size();
+}
+BENCHMARK(BM_RasterizeOccluders)->Arg(32)->Arg(64)->Arg(128)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+//Occlusion culling of the trees in the frustum for one frame, rasterization included. Takes the tree count and reports the share of the trees
+//in the frustum that the terrain hides
+static void BM_OcclusionCulling(benchmark::State& state)
+{
+	size_t count = (size_t)state.range(0);
+	std::vector<float> heights = makeHillyHeights();
+	HeightField field = { heights.data(), TERRAIN_SAMPLES, TERRAIN_SIZE };
+	OccluderMesh occluder;
+	buildTerrainOccluder(field, 64, occluder);
+	std::vector<glm::vec3> points = makeRandomPoints(count, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE, 0.f, TERRAIN_SIZE));
+	InstanceBounds bounds;
+	for (const glm::vec3& point : points)
+		addInstance(bounds, glm::vec3(point.x, sampleHeight(field, point.x, point.z) + 1.5f, point.z), 1.5f);
+	glm::mat4 viewProjection = getHillCameraViewProjection(field);
+	std::vector<uint32_t> inFrustum, visible;
+	cullInstances(extractFrustum(viewProjection), bounds, inFrustum);
+	JobSystem jobs;
+	OcclusionBuffer buffer;
+	initOcclusionBuffer(buffer, 256, 144);
+	for (auto _ : state)
+	{
+		visible = inFrustum;
+		rasterizeOccluders(buffer, viewProjection, occluder, jobs);
+		cullOccludedInstances(buffer, bounds, jobs, visible);
+		benchmark::DoNotOptimize(visible.data());
+	}
+	state.counters["inFrustum"] = (double)inFrustum.size();
+	state.counters["visible"] = (double)visible.size();
+	state.counters["cullRate"] = 1.0 - (double)visible.size() / inFrustum.size();
+}
+BENCHMARK(BM_OcclusionCulling)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_WriteInstanceTransforms(benchmark::State& state)
+{
+	size_t count = (size_t)state.range(0);
+	std::vector<glm::vec3> positions = makeRandomPoints(count, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE, 3.f, TERRAIN_SIZE));
+	std::vector<glm::mat4> models(count);
+	std::vector<uint32_t> indices(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		models[i] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.f), positions[i]), (float)i, glm::vec3(0.f, 1.f, 0.f)), glm::vec3(2.f));
+		indices[i] = (uint32_t)i;
+	}
+	std::vector<InstanceTransform> out(count);
+	for (auto _ : state)
+	{
+		writeInstanceTransforms(models.data(), indices.data(), count, out.data());
+		benchmark::DoNotOptimize(out.data());
+	}
+	state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_WriteInstanceTransforms)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18);
+
+static void BM_SelectTerrainLOD(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	TerrainLOD lod;
+	buildTerrainLOD(heights.data(), samples, TERRAIN_SIZE, lod);
+	computeLODRanges(lod, glm::radians(70.f), 1080.f, 2.f);
+	Frustum frustum = extractFrustum(getCameraProjection() * getCameraView());
+	TerrainDrawList drawList;
+	for (auto _ : state)
+	{
+		selectTerrainLOD(lod, glm::vec3(20.f, 4.f, 20.f), frustum, drawList);
+		benchmark::DoNotOptimize(drawList.patches.data());
+	}
+	state.counters["patches"] = (double)drawList.patches.size();
+}
+BENCHMARK(BM_SelectTerrainLOD)->Arg(256)->Arg(1024)->Arg(2048);
+
+static void BM_FitShadowCascades(benchmark::State& state)
+{
+	CascadeSettings settings;
+	settings.count = (int)state.range(0);
+	AABB sceneBounds = { glm::vec3(0.f), glm::vec3(TERRAIN_SIZE, 8.f, TERRAIN_SIZE) };
+	ShadowCascade cascades[MAX_SHADOW_CASCADES];
+	glm::mat4 view = getCameraView();
+	for (auto _ : state)
+	{
+		fitShadowCascades(settings, view, glm::radians(70.f), 16.f / 9.f, 0.5f, glm::vec3(-11.f, -5.f, -11.f), sceneBounds, cascades);
+		benchmark::DoNotOptimize(cascades);
+	}
+}
+BENCHMARK(BM_FitShadowCascades)->Arg(1)->Arg(MAX_SHADOW_CASCADES);
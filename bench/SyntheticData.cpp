@@ -0,0 +1,85 @@
+#include "SyntheticData.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	float getHillHeight(float x, float z)
+	{
+		return 1.5f + 0.75f * std::sin(x * 9.f) * std::cos(z * 7.f) + 0.25f * std::sin((x + z) * 23.f);
+	}
+}
+
+std::vector<uint8_t> makeHeightMapPixels(int size)
+{
+	std::vector<uint8_t> pixels(size * size * 4);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			//The demo reads a height as the sum of the channels over 256 times 3
+			float height = getHillHeight(x / (float)size, y / (float)size);
+			int channel = std::min(std::max((int)(height / 9.f * 256.f), 0), 255);
+			uint8_t* pixel = &pixels[(y * size + x) * 4];
+			pixel[0] = pixel[1] = pixel[2] = (uint8_t)channel;
+			pixel[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+std::vector<float> makeTerrainHeights(int samples)
+{
+	std::vector<float> heights((samples + 1) * (samples + 1));
+	for (int z = 0; z <= samples; z++)
+	{
+		for (int x = 0; x <= samples; x++)
+			heights[z * (samples + 1) + x] = getHillHeight(x / (float)samples, z / (float)samples);
+	}
+	return heights;
+}
+
+std::string makeGridOBJ(int quads)
+{
+	std::string text;
+	char line[128];
+	for (int z = 0; z <= quads; z++)
+	{
+		for (int x = 0; x <= quads; x++)
+		{
+			float u = x / (float)quads, v = z / (float)quads;
+			snprintf(line, sizeof(line), "v %f %f %f\n", u * 10.f, getHillHeight(u, v), v * 10.f);
+			text += line;
+			snprintf(line, sizeof(line), "vt %f %f\n", u, v);
+			text += line;
+			glm::vec3 normal = glm::normalize(glm::vec3(std::sin(u * 9.f), 1.f, std::cos(v * 7.f)));
+			snprintf(line, sizeof(line), "vn %f %f %f\n", normal.x, normal.y, normal.z);
+			text += line;
+		}
+	}
+	for (int z = 0; z < quads; z++)
+	{
+		for (int x = 0; x < quads; x++)
+		{
+			//.obj indices start at 1, and every vertex has a uv and a normal at the same index
+			int a = z * (quads + 1) + x + 1, b = a + 1, c = a + quads + 1, d = c + 1;
+			snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b);
+			text += line;
+			snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", b, b, b, c, c, c, d, d, d);
+			text += line;
+		}
+	}
+	return text;
+}
+
+std::vector<glm::vec3> makeRandomPoints(size_t count, const glm::vec3& min, const glm::vec3& max, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::vector<glm::vec3> points(count);
+	for (glm::vec3& point : points)
+		point = min + (max - min) * glm::vec3(unit(random), unit(random), unit(random));
+	return points;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+//Deterministic inputs for the benchmarks, so every run and every machine measures the same work without reading the demo's assets
+
+//RGBA8 height map of size x size pixels with rolling hills in all three color channels
+std::vector<uint8_t> makeHeightMapPixels(int size);
+
+//(samples + 1)^2 heights of the same hills, between 0.5 and 2.5
+std::vector<float> makeTerrainHeights(int samples);
+
+//.obj text of a wavy grid of quads x quads cells with positions, uvs and normals, two triangles per cell
+std::string makeGridOBJ(int quads);
+
+//count points spread uniformly over [min, max]
+std::vector<glm::vec3> makeRandomPoints(size_t count, const glm::vec3& min, const glm::vec3& max, uint32_t seed = 1);
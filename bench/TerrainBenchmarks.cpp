@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+#include "HeightField.h"
+#include "HeightPyramid.h"
+#include "JobSystem.h"
+#include "SyntheticData.h"
+#include "TerrainGeneration.h"
+#include "TerrainLOD.h"
+
+//The terrain spans 50 units like the demo's. Generation benchmarks take the sample count and the number of job threads, 0 meaning one per hardware thread
+static const float TERRAIN_SIZE = 50.f;
+//Points sampled by the height query benchmarks, enough to leave the cache warm but not resident in L1
+static const size_t QUERY_COUNT = 4096;
+
+static void BM_GetTerrainHeight(benchmark::State& state)
+{
+	int size = (int)state.range(0);
+	std::vector<uint8_t> pixels = makeHeightMapPixels(size);
+	HeightMapImage image = { pixels.data(), size, size };
+	std::vector<glm::vec3> points = makeRandomPoints(QUERY_COUNT, glm::vec3(0.f), glm::vec3(1.f));
+	for (auto _ : state)
+	{
+		float sum = 0.f;
+		for (const glm::vec3& point : points)
+			sum += getTerrainHeight(image, point.x, point.z);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_GetTerrainHeight)->Arg(256)->Arg(1024)->Arg(4096);
+
+static void BM_GenerateTerrainHeights(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<uint8_t> pixels = makeHeightMapPixels(1024);
+	HeightMapImage image = { pixels.data(), 1024, 1024 };
+	JobSystem jobs((unsigned)state.range(1));
+	std::vector<float> heights;
+	for (auto _ : state)
+	{
+		generateTerrainHeights(image, samples, jobs, heights);
+		benchmark::DoNotOptimize(heights.data());
+	}
+	state.SetItemsProcessed(state.iterations() * heights.size());
+}
+BENCHMARK(BM_GenerateTerrainHeights)->ArgsProduct({ { 1024, 4096 }, { 1, 2, 4, 8, 0 } })->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_GenerateTerrainNormals(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	JobSystem jobs((unsigned)state.range(1));
+	std::vector<int16_t> normals;
+	for (auto _ : state)
+	{
+		generateTerrainNormals(heights.data(), samples, jobs, normals);
+		benchmark::DoNotOptimize(normals.data());
+	}
+	state.SetItemsProcessed(state.iterations() * heights.size());
+}
+BENCHMARK(BM_GenerateTerrainNormals)->ArgsProduct({ { 1024, 4096 }, { 1, 2, 4, 8, 0 } })->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void BM_BuildTerrainLOD(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	for (auto _ : state)
+	{
+		TerrainLOD lod;
+		buildTerrainLOD(heights.data(), samples, TERRAIN_SIZE, lod);
+		benchmark::DoNotOptimize(lod.nodes.data());
+	}
+	state.SetItemsProcessed(state.iterations() * heights.size());
+}
+BENCHMARK(BM_BuildTerrainLOD)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+static void BM_BuildHeightPyramid(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	HeightField field = { heights.data(), samples, TERRAIN_SIZE };
+	for (auto _ : state)
+	{
+		HeightPyramid pyramid;
+		buildHeightPyramid(field, pyramid);
+		benchmark::DoNotOptimize(&pyramid);
+	}
+	state.SetItemsProcessed(state.iterations() * heights.size());
+}
+BENCHMARK(BM_BuildHeightPyramid)->Arg(256)->Arg(1024)->Arg(2048)->Unit(benchmark::kMicrosecond);
+
+//One query at a time, the way the demo's collision and scattering call it
+static void BM_SampleHeight(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	HeightField field = { heights.data(), samples, TERRAIN_SIZE };
+	std::vector<glm::vec3> points = makeRandomPoints(QUERY_COUNT, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE));
+	for (auto _ : state)
+	{
+		float sum = 0.f;
+		for (const glm::vec3& point : points)
+			sum += sampleHeight(field, point.x, point.z);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_SampleHeight)->Arg(256)->Arg(1024)->Arg(2048);
+
+//Batched queries with normals and slopes, the SIMD path
+static void BM_SampleHeights(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	HeightField field = { heights.data(), samples, TERRAIN_SIZE };
+	std::vector<glm::vec3> points = makeRandomPoints(QUERY_COUNT, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE));
+	std::vector<float> x(QUERY_COUNT), z(QUERY_COUNT), results(QUERY_COUNT), slopes(QUERY_COUNT);
+	std::vector<glm::vec3> normals(QUERY_COUNT);
+	for (size_t i = 0; i < QUERY_COUNT; i++)
+	{
+		x[i] = points[i].x;
+		z[i] = points[i].z;
+	}
+	for (auto _ : state)
+	{
+		sampleHeights(field, x.data(), z.data(), QUERY_COUNT, results.data(), normals.data(), slopes.data());
+		benchmark::DoNotOptimize(results.data());
+	}
+	state.SetItemsProcessed(state.iterations() * QUERY_COUNT);
+}
+BENCHMARK(BM_SampleHeights)->Arg(256)->Arg(1024)->Arg(2048);
+
+//Rays from above the terrain pointing down at a shallow angle, like picking from a walking camera
+static void BM_RaycastHeightField(benchmark::State& state)
+{
+	int samples = (int)state.range(0);
+	std::vector<float> heights = makeTerrainHeights(samples);
+	HeightField field = { heights.data(), samples, TERRAIN_SIZE };
+	HeightPyramid pyramid;
+	buildHeightPyramid(field, pyramid);
+	const size_t rayCount = 256;
+	std::vector<glm::vec3> origins = makeRandomPoints(rayCount, glm::vec3(0.f, 4.f, 0.f), glm::vec3(TERRAIN_SIZE, 6.f, TERRAIN_SIZE));
+	std::vector<glm::vec3> directions = makeRandomPoints(rayCount, glm::vec3(-1.f, -0.3f, -1.f), glm::vec3(1.f, -0.1f, 1.f), 2);
+	for (glm::vec3& direction : directions)
+		direction = glm::normalize(direction);
+	std::vector<RayHit> hits(rayCount);
+	for (auto _ : state)
+	{
+		raycastHeightField(field, pyramid, origins.data(), directions.data(), rayCount, 150.f, hits.data());
+		benchmark::DoNotOptimize(hits.data());
+	}
+	state.SetItemsProcessed(state.iterations() * rayCount);
+}
+BENCHMARK(BM_RaycastHeightField)->Arg(256)->Arg(1024)->Arg(2048)->Arg(4096);
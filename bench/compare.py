@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Compares two Google Benchmark JSON results and flags benchmarks that got slower than a threshold.
+
+Runs with repetitions are compared by their median. Benchmarks registered with UseRealTime() are compared by
+wall time, every other one by CPU time. Exits with 1 if any benchmark regressed or is missing from the current run, so it can gate CI.
+
+    demo_bench --benchmark_repetitions=5 --benchmark_report_aggregates_only=true --benchmark_out=current.json
+    python3 bench/compare.py baseline.json current.json --threshold 0.1
+"""
+
+import argparse
+import json
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_times(path):
+    """Returns {benchmark name: time in ns}, preferring median aggregates over single iterations"""
+    with open(path) as file:
+        results = json.load(file)
+    medians, iterations = {}, {}
+    for benchmark in results["benchmarks"]:
+        name = benchmark.get("run_name", benchmark["name"])
+        metric = "real_time" if name.endswith("/real_time") else "cpu_time"
+        time = benchmark[metric] * TIME_UNITS[benchmark.get("time_unit", "ns")]
+        if benchmark.get("run_type") == "aggregate":
+            if benchmark.get("aggregate_name") == "median":
+                medians[name] = time
+        else:
+            iterations.setdefault(name, []).append(time)
+    times = {name: sum(values) / len(values) for name, values in iterations.items()}
+    times.update(medians)
+    return times
+
+
+def format_time(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.3f %s" % (ns / scale, unit)
+    return "%.1f ns" % ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flags benchmark regressions against a baseline")
+    parser.add_argument("baseline", help="Google Benchmark JSON output to compare against")
+    parser.add_argument("current", help="Google Benchmark JSON output of the change")
+    parser.add_argument("--threshold", type=float, default=0.1, help="relative slowdown that counts as a regression, 0.1 is 10%%")
+    parser.add_argument("--filter", default="", help="only compare benchmarks whose name contains this")
+    parser.add_argument("--require-baseline", action="store_true",
+                        help="also fail when the current run has benchmarks the baseline doesn't, so a stored baseline can't fall behind the suite")
+    args = parser.parse_args()
+
+    baseline = load_times(args.baseline)
+    current = load_times(args.current)
+    regressions = 0
+    missing = 0
+    width = max([len(name) for name in list(baseline) + list(current)] + [9])
+    print("%-*s %14s %14s %9s" % (width, "Benchmark", "Baseline", "Current", "Change"))
+    for name in baseline:
+        if args.filter not in name:
+            continue
+        if name not in current:
+            print("%-*s %14s %14s %9s" % (width, name, format_time(baseline[name]), "missing", ""))
+            missing += 1
+            continue
+        change = current[name] / baseline[name] - 1.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            flag = "  faster"
+        print("%-*s %14s %14s %+8.1f%%%s" % (width, name, format_time(baseline[name]), format_time(current[name]), change * 100.0, flag))
+    uncovered = 0
+    for name in current:
+        if name not in baseline and args.filter in name:
+            print("%-*s %14s %14s %9s" % (width, name, "new", format_time(current[name]), ""))
+            uncovered += 1
+
+    failed = False
+    if regressions:
+        print("%d benchmark(s) regressed by more than %.0f%%" % (regressions, args.threshold * 100.0))
+        failed = True
+    # A benchmark that was renamed, removed or crashed before writing its result can't be compared, so it fails like a regression
+    if missing:
+        print("%d benchmark(s) of the baseline are missing from the current run, they were renamed, removed or didn't finish" % missing)
+        failed = True
+    if uncovered and args.require_baseline:
+        print("%d benchmark(s) are missing from the baseline, record it again" % uncovered)
+        failed = True
+    if failed:
+        return 1
+    print("No regressions above %.0f%%" % (args.threshold * 100.0))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
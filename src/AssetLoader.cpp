@@ -0,0 +1,103 @@
+#include "AssetLoader.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+
+AssetLoader::AssetLoader(unsigned threadCount)
+{
+	pending = 0;
+	running = true;
+	for (unsigned i = 0; i < std::max(threadCount, 1u); i++)
+		threads.emplace_back(&AssetLoader::loaderLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	requestCondition.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+void AssetLoader::load(std::function<size_t()> decode, std::function<void()> upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Request request;
+		request.decode = std::move(decode);
+		request.upload = std::move(upload);
+		requests.push_back(std::move(request));
+		pending++;
+	}
+	requestCondition.notify_one();
+}
+
+size_t AssetLoader::uploadAssets(size_t budget)
+{
+	size_t uploaded = 0;
+	while (true)
+	{
+		Request request;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (completions.empty() || (uploaded > 0 && uploaded + completions.front().bytes > budget))
+				break;
+			request = std::move(completions.front());
+			completions.pop_front();
+		}
+		//Uploads run without the lock, so they can queue more assets
+		request.upload();
+		uploaded += request.bytes;
+		std::lock_guard<std::mutex> lock(mutex);
+		pending--;
+	}
+	return uploaded;
+}
+
+void AssetLoader::finish()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			completionCondition.wait(lock, [this]() { return pending == 0 || !completions.empty(); });
+			if (pending == 0)
+				return;
+		}
+		uploadAssets(SIZE_MAX);
+	}
+}
+
+size_t AssetLoader::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
+
+void AssetLoader::loaderLoop()
+{
+	while (true)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			requestCondition.wait(lock, [this]() { return !running || !requests.empty(); });
+			if (!running)
+				return;
+			request = std::move(requests.front());
+			requests.pop_front();
+		}
+		{
+			PROFILE_SCOPE("Asset decode");
+			request.bytes = request.decode();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			completions.push_back(std::move(request));
+		}
+		completionCondition.notify_all();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class AssetState { Loading, Ready, Failed };
+
+//Loads assets in two steps: decode runs on a loader thread and produces a CPU side payload, upload sends it to the GPU on the thread that owns the GL context.
+//Loader threads are separate from the JobSystem because they spend much of their time blocked on file reads, which would stall compute jobs
+class AssetLoader
+{
+public:
+	explicit AssetLoader(unsigned threadCount = 2);
+	//Waits for the decodes that are running, queued ones are dropped
+	~AssetLoader();
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	//Queues decode, which returns the number of bytes its upload will send to the GPU. Decodes start in the order they were queued
+	void load(std::function<size_t()> decode, std::function<void()> upload);
+
+	//Runs the uploads of finished decodes in the order they finished until budget bytes have been uploaded. The first ready upload always runs,
+	//so an asset larger than the budget still gets through. Returns the number of bytes uploaded
+	size_t uploadAssets(size_t budget);
+
+	//Waits for every queued asset and uploads all of them
+	void finish();
+
+	//Number of assets that haven't been uploaded yet
+	size_t getPendingCount() const;
+
+private:
+	struct Request
+	{
+		std::function<size_t()> decode;
+		std::function<void()> upload;
+		size_t bytes = 0;
+	};
+
+	void loaderLoop();
+
+	std::vector<std::thread> threads;
+	mutable std::mutex mutex;
+	std::condition_variable requestCondition, completionCondition;
+	std::deque<Request> requests, completions;
+	size_t pending;
+	bool running;
+};
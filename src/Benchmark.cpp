@@ -0,0 +1,269 @@
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "TerrainLOD.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	//Nearest rank percentile of sorted times, in milliseconds
+	double getTimePercentile(const std::vector<float>& sorted, double percentile)
+	{
+		size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+		return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1] * 1000.0;
+	}
+
+	//Writes "name": { mean, p50, p95, p99, max } in milliseconds, nothing if there are no times
+	void writeTimeStats(FILE* file, const char* name, const std::vector<float>& times)
+	{
+		if (times.empty())
+			return;
+		std::vector<float> sorted = times;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (float time : sorted)
+			total += time;
+		fprintf(file, "\t\"%s\": { \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n", name, total / sorted.size() * 1000.0,
+			getTimePercentile(sorted, 50.0), getTimePercentile(sorted, 95.0), getTimePercentile(sorted, 99.0), sorted.back() * 1000.0);
+	}
+
+	//Writes text as a quoted JSON string. Backslashes, quotes and control characters are escaped, so Windows paths and any other text stay valid JSON
+	void writeJsonString(FILE* file, const std::string& text)
+	{
+		fputc('"', file);
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				fprintf(file, "\\%c", c);
+			else if ((unsigned char)c < 0x20)
+				fprintf(file, "\\u%04x", (unsigned)c);
+			else
+				fputc(c, file);
+		}
+		fputc('"', file);
+	}
+
+	bool parseUnsigned(const char* text, unsigned long& value)
+	{
+		char* end;
+		value = strtoul(text, &end, 10);
+		return end != text && *end == '\0';
+	}
+
+	bool parseFloat(const char* text, float& value)
+	{
+		char* end;
+		value = strtof(text, &end);
+		return end != text && *end == '\0';
+	}
+}
+
+bool parseBenchmarkSettings(int argc, char** argv, BenchmarkSettings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			std::cout << "Missing value for " << option << std::endl;
+			return false;
+		}
+		const char* value = argv[++i];
+		unsigned long number;
+		bool valid = true;
+		if (option == "--benchmark")
+			settings.trackPath = value;
+		else if (option == "--record")
+			settings.recordPath = value;
+		else if (option == "--report")
+			settings.reportPath = value;
+		else if (option == "--expect-hash")
+			settings.expectedHash = value;
+		else if (option == "--expect-sim-hash")
+			settings.expectedSimulationHash = value;
+		else if (option == "--size")
+		{
+			unsigned width, height;
+			char end;
+			valid = sscanf(value, "%ux%u%c", &width, &height, &end) == 2 && width > 0 && height > 0;
+			settings.width = width;
+			settings.height = height;
+		}
+		else if (option == "--dt")
+			valid = parseFloat(value, settings.dt) && settings.dt > 0.f;
+		else if (option == "--tick")
+			valid = parseFloat(value, settings.tickTime) && settings.tickTime > 0.f;
+		else if (option == "--warmup")
+		{
+			valid = parseUnsigned(value, number);
+			settings.warmupFrames = (int)number;
+		}
+		else if (option == "--terrain-samples")
+		{
+			//The LOD quadtree splits the terrain into patches of TERRAIN_PATCH_SIZE quads
+			valid = parseUnsigned(value, number) && number > 0 && number % TERRAIN_PATCH_SIZE == 0;
+			settings.terrainSamples = (int)number;
+		}
+		else if (option == "--tree-density")
+			valid = parseFloat(value, settings.treeDensity) && settings.treeDensity > 0.f;
+		else if (option == "--tree-seed")
+		{
+			valid = parseUnsigned(value, number);
+			settings.treeSeed = (uint32_t)number;
+		}
+		else if (option == "--occlusion")
+		{
+			valid = parseUnsigned(value, number) && number <= 1;
+			settings.occlusionCulling = number != 0;
+		}
+		else
+		{
+			std::cout << "Unknown option " << option << std::endl;
+			return false;
+		}
+		if (!valid)
+		{
+			std::cout << "Invalid value " << value << " for " << option << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool loadInputTrack(const std::string& path, std::vector<CameraInput>& track)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	track.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		int keys[6];
+		CameraInput input;
+		if (!(stream >> keys[0] >> keys[1] >> keys[2] >> keys[3] >> keys[4] >> keys[5] >> input.mouseDx >> input.mouseDy))
+		{
+			//Blank lines are allowed, anything else is a broken track
+			if (line.find_first_not_of(" \t\r") != std::string::npos)
+				return false;
+			continue;
+		}
+		input.forward = keys[0] != 0;
+		input.back = keys[1] != 0;
+		input.left = keys[2] != 0;
+		input.right = keys[3] != 0;
+		input.sprint = keys[4] != 0;
+		input.jump = keys[5] != 0;
+		track.push_back(input);
+	}
+	return true;
+}
+
+bool saveInputTrack(const std::string& path, const std::vector<CameraInput>& track)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+	//Mouse deltas are written with enough digits to read back the same floats
+	for (const CameraInput& input : track)
+	{
+		fprintf(file, "%d %d %d %d %d %d %.9g %.9g\n", input.forward, input.back, input.left, input.right, input.sprint, input.jump,
+			input.mouseDx, input.mouseDy);
+	}
+	return fclose(file) == 0;
+}
+
+void genBenchmarkTarget(BenchmarkTarget& target, unsigned width, unsigned height)
+{
+	target.width = width;
+	target.height = height;
+	glGenTextures(1, &target.color);
+	glBindTexture(GL_TEXTURE_2D, target.color);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &target.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &target.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void hashBenchmarkTarget(const BenchmarkTarget& target, uint64_t& hash)
+{
+	std::vector<uint8_t> pixels(target.width * target.height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	for (uint8_t byte : pixels)
+	{
+		hash ^= byte;
+		hash *= 0x100000001b3ull;
+	}
+}
+
+std::string formatImageHash(uint64_t hash)
+{
+	char text[17];
+	snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+	return text;
+}
+
+bool writeBenchmarkReport(const BenchmarkSettings& settings, const BenchmarkResults& results)
+{
+	FILE* file = fopen(settings.reportPath.c_str(), "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"track\": ");
+	writeJsonString(file, settings.trackPath);
+	fprintf(file, ",\n");
+	fprintf(file, "\t\"width\": %u,\n\t\"height\": %u,\n\t\"dt\": %g,\n\t\"tick\": %g,\n\t\"ticks\": %llu,\n", settings.width, settings.height, settings.dt,
+		settings.tickTime, (unsigned long long)results.ticks);
+	fprintf(file, "\t\"terrainSamples\": %d,\n\t\"treeDensity\": %g,\n\t\"treeSeed\": %u,\n\t\"trees\": %zu,\n", settings.terrainSamples, settings.treeDensity,
+		settings.treeSeed, results.treeCount);
+	fprintf(file, "\t\"warmupFrames\": %d,\n\t\"frames\": %zu,\n", settings.warmupFrames, results.frameTimes.size());
+	writeTimeStats(file, "frameTime", results.frameTimes);
+	writeTimeStats(file, "inputLatency", results.inputLatencies);
+	if (!results.frameTimes.empty())
+	{
+		double frames = (double)results.frameTimes.size();
+		fprintf(file, "\t\"occlusionCulling\": %s,\n\t\"treesInFrustum\": %.1f,\n\t\"treesVisible\": %.1f,\n", settings.occlusionCulling ? "true" : "false",
+			results.frustumTrees / frames, results.visibleTrees / frames);
+	}
+
+	//Timings of the profiler's CPU scopes and the GPU timers of the render queue's draws, the same names the trace export uses
+	fprintf(file, "\t\"passes\": [");
+#ifdef PROFILER_ENABLED
+	std::vector<ProfileStats> stats;
+	getProfilerStats(stats);
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		fprintf(file, "%s\n\t\t{ \"name\": ", i ? "," : "");
+		writeJsonString(file, stats[i].name);
+		fprintf(file, ", \"type\": \"%s\", \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"samples\": %zu }", stats[i].gpu ? "GPU" : "CPU", stats[i].p50, stats[i].p95,
+			stats[i].p99, stats[i].samples);
+	}
+	if (!stats.empty())
+		fprintf(file, "\n\t");
+#endif
+	fprintf(file, "],\n");
+	fprintf(file, "\t\"imageHash\": \"%s\",\n", formatImageHash(results.imageHash).c_str());
+	fprintf(file, "\t\"simulationHash\": \"%s\"\n}\n", formatImageHash(results.simulationHash).c_str());
+	return fclose(file) == 0;
+}
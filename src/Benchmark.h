@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include "CameraFP.h"
+
+//Options of a run, read from the command line. With a track the app renders headless into an offscreen framebuffer, steps the simulation through
+//the track and renders frames dt apart until the track ends, then writes a report. Without one it opens the window and records the camera input
+//to recordPath if that is set
+struct BenchmarkSettings
+{
+	std::string trackPath, recordPath;
+	std::string reportPath = "benchmark.json";
+	//Hashes the rendered frames and the simulated states have to match, as printed in the report. Not checked when empty
+	std::string expectedHash, expectedSimulationHash;
+	unsigned width = 1920, height = 1080;
+	//Time between rendered frames and between simulation ticks. Tracks hold the input of one tick per line, so changing dt changes the frame rate
+	//without changing what is simulated
+	float dt = 1.f / 60.f, tickTime = 1.f / 60.f;
+	//Frames replayed before the timing starts, so the first shadow cache fills and driver warm up don't skew the results
+	int warmupFrames = 10;
+	//Scene scale, also used by interactive runs: the terrain has (terrainSamples + 1)^2 height samples, and treeDensity scales the number of trees
+	//scattered with treeSeed
+	int terrainSamples = 256;
+	float treeDensity = 1.f;
+	uint32_t treeSeed = 1;
+	//Whether trees hidden behind the terrain are culled, also toggled with O in interactive runs. Off by default, the demo's height map hides no trees
+	//from the 64 cell occluder, so the rasterization would be paid every frame for nothing. Worth turning on for hilly maps
+	bool occlusionCulling = false;
+};
+
+//Reads --benchmark <track>, --record <track>, --report <path>, --expect-hash <hash>, --expect-sim-hash <hash>, --size <width>x<height>,
+//--dt <seconds>, --tick <seconds>, --warmup <frames>, --terrain-samples <samples>, --tree-density <scale>, --tree-seed <seed> and --occlusion <0 or 1>. Prints the problem and returns false on unknown or malformed options
+bool parseBenchmarkSettings(int argc, char** argv, BenchmarkSettings& settings);
+
+//Tracks are text files with one simulation tick per line: forward, back, left, right, sprint and jump as 0 or 1, followed by the mouse deltas
+bool loadInputTrack(const std::string& path, std::vector<CameraInput>& track);
+bool saveInputTrack(const std::string& path, const std::vector<CameraInput>& track);
+
+//Single sampled color and depth target the benchmark renders into in place of the window
+struct BenchmarkTarget
+{
+	GLuint framebuffer = 0, color = 0, depth = 0;
+	unsigned width = 0, height = 0;
+};
+
+void genBenchmarkTarget(BenchmarkTarget& target, unsigned width, unsigned height);
+
+//Initial value of an image hash
+constexpr uint64_t IMAGE_HASH_SEED = 0xcbf29ce484222325ull;
+
+//Folds the pixels of the target into a 64 bit FNV-1a hash. Waits for the frame to finish rendering
+void hashBenchmarkTarget(const BenchmarkTarget& target, uint64_t& hash);
+
+//Hash as 16 hex digits, the format expectedHash is compared in
+std::string formatImageHash(uint64_t hash);
+
+//Measurements of a benchmark run. Frame times and input latencies are in seconds and only cover the frames after the warm up. The input latency
+//of a frame runs from sampling the newest input it shows to the GPU finishing it
+struct BenchmarkResults
+{
+	std::vector<float> frameTimes, inputLatencies;
+	size_t treeCount = 0;
+	//Trees in the camera's frustum and trees left after occlusion culling, summed over the timed frames
+	size_t frustumTrees = 0, visibleTrees = 0;
+	uint64_t ticks = 0;
+	uint64_t imageHash = IMAGE_HASH_SEED, simulationHash = IMAGE_HASH_SEED;
+};
+
+//Writes the settings, the frame time and input latency percentiles, the average tree counts, the profiler's per pass timings and the image and simulation hashes as JSON. Returns false if the file can't be written
+bool writeBenchmarkReport(const BenchmarkSettings& settings, const BenchmarkResults& results);
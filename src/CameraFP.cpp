@@ -1,12 +1,25 @@
 #include "CameraFP.h"
 
+CameraInput readCameraInput(float mouseDx, float mouseDy)
+{
+	CameraInput input;
+	input.forward = sf::Keyboard::isKeyPressed(sf::Keyboard::W);
+	input.back = sf::Keyboard::isKeyPressed(sf::Keyboard::S);
+	input.left = sf::Keyboard::isKeyPressed(sf::Keyboard::A);
+	input.right = sf::Keyboard::isKeyPressed(sf::Keyboard::D);
+	input.sprint = sf::Keyboard::isKeyPressed(sf::Keyboard::LShift);
+	input.jump = sf::Keyboard::isKeyPressed(sf::Keyboard::Space);
+	input.mouseDx = mouseDx;
+	input.mouseDy = mouseDy;
+	return input;
+}
+
 CameraFP::CameraFP(glm::vec3 pos, float walkSpeed)
 {
 	this->pos = pos;
 	this->walkSpeed = walkSpeed;
 	attitude = glm::vec3(0);
 	front = glm::vec3(0);
-	sprintButton = sf::Keyboard::LShift;
 	sprintSpeed = 6;
 	up = glm::vec3(0, 1, 0);
 	view = glm::mat4(1.f);
@@ -45,10 +58,10 @@ void CameraFP::move(float dx, float dy, float dz)
 	pos += glm::vec3(dx, dy, dz);
 }
 
-void CameraFP::inputProc(sf::Event& event, float dt, float mouseDx, float mouseDy)
+void CameraFP::inputProc(const CameraInput& input, float dt)
 {
 	float speed = walkSpeed;
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::LShift))
+	if (input.sprint)
 		speed = sprintSpeed;
 
 	if (pos.x < xBounds.x + 0.2)
@@ -60,25 +73,25 @@ void CameraFP::inputProc(sf::Event& event, float dt, float mouseDx, float mouseD
 	else if (pos.z > zBounds.y - 0.2)
 		pos.z = zBounds.y - 0.2;
 
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::W))
+	if (input.forward)
 	{
 		pos += glm::normalize(glm::vec3(front.x, 0, front.z)) * dt * speed;
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::S))
+	if (input.back)
 	{
 		pos -= glm::normalize(glm::vec3(front.x, 0, front.z)) * dt * speed;
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::A))
+	if (input.left)
 	{
 		pos -= glm::normalize(glm::cross(front, up)) * dt * speed;
 	}
-	if (sf::Keyboard::isKeyPressed(sf::Keyboard::D))
+	if (input.right)
 	{
 		pos += glm::normalize(glm::cross(front, up)) * dt * speed;
 	}
 
-	attitude.x += mouseDy;
-	attitude.y += mouseDx;
+	attitude.x += input.mouseDy;
+	attitude.y += input.mouseDx;
 	attitude.x = attitude.x > 89.f ? 89.f : attitude.x;
 	attitude.x = attitude.x < -89.f ? -89.f : attitude.x;
 
@@ -108,3 +121,8 @@ glm::vec3 CameraFP::getPosition() const
 {
 	return pos;
 }
+
+glm::vec3 CameraFP::getFront() const
+{
+	return front;
+}
@@ -3,6 +3,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <SFML/Window/Event.hpp>
 
+//Input that moves the camera for one frame, read live from the keyboard and mouse or replayed from a recorded track. Mouse deltas are in degrees
+struct CameraInput
+{
+	bool forward = false, back = false, left = false, right = false, sprint = false, jump = false;
+	float mouseDx = 0.f, mouseDy = 0.f;
+};
+
+//Reads the movement keys from the keyboard
+CameraInput readCameraInput(float mouseDx, float mouseDy);
+
 //
 class CameraFP
 {
@@ -15,15 +25,15 @@ public:
 	void setPosition(float x, float y, float z);
 	void move(glm::vec3 displacement);
 	void move(float dx, float dy, float dz);
-	void inputProc(sf::Event& event, float dt, float mouseDx, float mouseDy);
+	void inputProc(const CameraInput& input, float dt);
 	void activateView();
 	void setView(glm::mat4 view);
 	glm::mat4 getView() const;
 	glm::vec3 getPosition() const;
+	glm::vec3 getFront() const;
 
 private:
 	float walkSpeed, sprintSpeed;
-	sf::Keyboard::Key sprintButton;
 	glm::mat4 view;
 	glm::vec3 pos, front, up, attitude;
 	glm::vec2 xBounds, zBounds;
@@ -0,0 +1,48 @@
+#include "Frustum.h"
+#include <cmath>
+
+Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+	//Gribb/Hartmann plane extraction. glm matrices are column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	for (int i = 0; i < 3; i++)
+	{
+		frustum.planes[i * 2] = rows[3] + rows[i];
+		frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+	for (glm::vec4& plane : frustum.planes)
+	{
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane = plane / length;
+	}
+	return frustum;
+}
+
+bool intersectsFrustum(const Frustum& frustum, const AABB& box)
+{
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		//Tests the corner of the box that lies furthest along the plane normal
+		float x = plane.x >= 0.f ? box.max.x : box.min.x;
+		float y = plane.y >= 0.f ? box.max.y : box.min.y;
+		float z = plane.z >= 0.f ? box.max.z : box.min.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.f)
+			return false;
+	}
+	return true;
+}
+
+bool intersectsSphere(const AABB& box, const glm::vec3& center, float radius)
+{
+	float distanceSquared = 0.f;
+	for (int i = 0; i < 3; i++)
+	{
+		float closest = std::fmin(std::fmax(center[i], box.min[i]), box.max[i]);
+		distanceSquared += (center[i] - closest) * (center[i] - closest);
+	}
+	return distanceSquared <= radius * radius;
+}
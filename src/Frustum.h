@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+//Axis aligned bounding box
+struct AABB
+{
+	glm::vec3 min, max;
+};
+
+//The six planes of a view frustum as (normal, distance) with the normals pointing inwards
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+//Extracts the frustum planes from a projection * view matrix
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+//Returns false if the box lies completely outside of one of the frustum planes. Boxes near the corners of the frustum can be reported as visible
+bool intersectsFrustum(const Frustum& frustum, const AABB& box);
+
+//Returns true if a sphere intersects the box
+bool intersectsSphere(const AABB& box, const glm::vec3& center, float radius);
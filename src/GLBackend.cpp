@@ -0,0 +1,16 @@
+#include "GLStateCache.h"
+
+GLBackend getGLBackend()
+{
+	//GLEW's entry points are loaded at runtime, so they are wrapped instead of stored directly
+	GLBackend backend;
+	backend.useProgram = [](GLuint program) { glUseProgram(program); };
+	backend.activeTexture = [](GLenum unit) { glActiveTexture(unit); };
+	backend.bindTexture = [](GLenum target, GLuint texture) { glBindTexture(target, texture); };
+	backend.bindVertexArray = [](GLuint vao) { glBindVertexArray(vao); };
+	backend.setCapability = [](GLenum capability, bool enabled) { enabled ? glEnable(capability) : glDisable(capability); };
+	backend.cullFace = [](GLenum face) { glCullFace(face); };
+	backend.depthMask = [](GLboolean flag) { glDepthMask(flag); };
+	backend.polygonMode = [](GLenum face, GLenum mode) { glPolygonMode(face, mode); };
+	return backend;
+}
@@ -0,0 +1,97 @@
+#include "GLStateCache.h"
+
+namespace
+{
+	//Counts the call and returns true if it has to be issued
+	bool changes(GLStateCache& cache, GLuint& current, GLuint value)
+	{
+		if (current == value)
+		{
+			cache.skippedCalls++;
+			return false;
+		}
+		current = value;
+		cache.issuedCalls++;
+		return true;
+	}
+}
+
+void initStateCache(GLStateCache& cache, const GLBackend& backend)
+{
+	cache.backend = backend;
+	invalidateStateCache(cache);
+}
+
+void invalidateStateCache(GLStateCache& cache)
+{
+	cache.program = UNKNOWN_STATE;
+	cache.activeUnit = UNKNOWN_STATE;
+	for (int unit = 0; unit < STATE_CACHE_TEXTURE_UNITS; unit++)
+	{
+		cache.textureTargets[unit] = UNKNOWN_STATE;
+		cache.textures[unit] = UNKNOWN_STATE;
+	}
+	cache.vao = UNKNOWN_STATE;
+	cache.cullFace = UNKNOWN_STATE;
+	cache.depthMask = UNKNOWN_STATE;
+	cache.polygonMode = UNKNOWN_STATE;
+}
+
+void setProgram(GLStateCache& cache, GLuint program)
+{
+	if (changes(cache, cache.program, program))
+		cache.backend.useProgram(program);
+}
+
+void setTexture(GLStateCache& cache, int unit, GLenum target, GLuint texture)
+{
+	if (unit >= STATE_CACHE_TEXTURE_UNITS)
+	{
+		cache.backend.activeTexture(GL_TEXTURE0 + unit);
+		cache.backend.bindTexture(target, texture);
+		cache.activeUnit = GL_TEXTURE0 + unit;
+		cache.issuedCalls++;
+		return;
+	}
+	if (cache.textureTargets[unit] == target && cache.textures[unit] == texture)
+	{
+		cache.skippedCalls++;
+		return;
+	}
+	if (changes(cache, cache.activeUnit, GL_TEXTURE0 + unit))
+		cache.backend.activeTexture(GL_TEXTURE0 + unit);
+	cache.textureTargets[unit] = target;
+	cache.textures[unit] = texture;
+	cache.backend.bindTexture(target, texture);
+	cache.issuedCalls++;
+}
+
+void setVertexArray(GLStateCache& cache, GLuint vao)
+{
+	if (changes(cache, cache.vao, vao))
+		cache.backend.bindVertexArray(vao);
+}
+
+void setCullFace(GLStateCache& cache, GLenum face)
+{
+	GLenum previous = cache.cullFace;
+	if (!changes(cache, cache.cullFace, face))
+		return;
+	//Switching between two faces leaves culling enabled
+	if (face == GL_NONE || previous == GL_NONE || previous == UNKNOWN_STATE)
+		cache.backend.setCapability(GL_CULL_FACE, face != GL_NONE);
+	if (face != GL_NONE)
+		cache.backend.cullFace(face);
+}
+
+void setDepthMask(GLStateCache& cache, bool write)
+{
+	if (changes(cache, cache.depthMask, write ? GL_TRUE : GL_FALSE))
+		cache.backend.depthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void setPolygonMode(GLStateCache& cache, GLenum mode)
+{
+	if (changes(cache, cache.polygonMode, mode))
+		cache.backend.polygonMode(GL_FRONT_AND_BACK, mode);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <GL/glew.h>
+
+//Texture units tracked by the cache
+constexpr int STATE_CACHE_TEXTURE_UNITS = 8;
+
+//Value of cached state that isn't known, so the next call setting it is always issued
+constexpr GLuint UNKNOWN_STATE = 0xFFFFFFFF;
+
+//The GL calls the state cache issues. The GL backend calls the current context, a recording backend lets the cache and the render queue run without a GPU
+struct GLBackend
+{
+	void (*useProgram)(GLuint program);
+	void (*activeTexture)(GLenum unit);
+	void (*bindTexture)(GLenum target, GLuint texture);
+	void (*bindVertexArray)(GLuint vao);
+	void (*setCapability)(GLenum capability, bool enabled);
+	void (*cullFace)(GLenum face);
+	void (*depthMask)(GLboolean flag);
+	void (*polygonMode)(GLenum face, GLenum mode);
+};
+
+//Backend that issues every call to the current GL context. Defined in GLBackend.cpp, the only part of the cache that needs GL, so programs without a GL
+//context can leave it out
+GLBackend getGLBackend();
+
+//Last state set through the cache. Calls that wouldn't change it are skipped. Code that changes the same state without going through the cache
+//has to call invalidateStateCache before the cache is used again
+struct GLStateCache
+{
+	GLBackend backend;
+	GLuint program = UNKNOWN_STATE;
+	GLenum activeUnit = UNKNOWN_STATE;
+	//Each unit remembers only the last target bound on it, binding another target to the unit is always issued
+	GLenum textureTargets[STATE_CACHE_TEXTURE_UNITS];
+	GLuint textures[STATE_CACHE_TEXTURE_UNITS];
+	GLuint vao = UNKNOWN_STATE;
+	GLenum cullFace = UNKNOWN_STATE;
+	GLuint depthMask = UNKNOWN_STATE;
+	GLenum polygonMode = UNKNOWN_STATE;
+	//State changes sent to the backend and ones skipped because they wouldn't change anything, since the counters were last cleared
+	size_t issuedCalls = 0, skippedCalls = 0;
+};
+
+//Sets the backend and forgets all state
+void initStateCache(GLStateCache& cache, const GLBackend& backend);
+
+//Forgets all state, so every following call is issued once
+void invalidateStateCache(GLStateCache& cache);
+
+void setProgram(GLStateCache& cache, GLuint program);
+
+//Binds texture to target on the unit. Units past STATE_CACHE_TEXTURE_UNITS aren't tracked and always bind
+void setTexture(GLStateCache& cache, int unit, GLenum target, GLuint texture);
+
+void setVertexArray(GLStateCache& cache, GLuint vao);
+
+//Culls the given face. GL_NONE disables face culling
+void setCullFace(GLStateCache& cache, GLenum face);
+
+void setDepthMask(GLStateCache& cache, bool write);
+
+//Sets the polygon mode of both faces
+void setPolygonMode(GLStateCache& cache, GLenum mode);
@@ -0,0 +1,116 @@
+#include "Profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include <algorithm>
+#include <vector>
+#include <GL/glew.h>
+
+namespace
+{
+	struct GpuTimer
+	{
+		const char* name;
+		GLuint query;
+		uint64_t cpuTime;
+	};
+
+	//The timers of one frame. Queries are kept and reused once the frame's results have been read or dropped
+	struct GpuFrame
+	{
+		std::vector<GpuTimer> timers;
+		size_t used = 0;
+		bool pending = false;
+	};
+
+	bool gpuInitialized = false;
+	GpuFrame gpuFrames[PROFILER_GPU_LATENCY];
+	int gpuFrame = 0;
+	float gpuFrameTime = 0.f;
+	int gpuFrameCount = 0;
+
+	//Returns false if the frame's last query hasn't finished yet. Queries finish in order, so the others have as well
+	bool readGpuFrame(GpuFrame& frame)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(frame.timers[frame.used - 1].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+
+		//Elapsed queries only measure durations, so the trace lays the timers out back to back from the time the first one was submitted, never before
+		//their own submission. The frame time only sums the durations, the gaps where the GPU waited for the CPU aren't GPU time
+		uint64_t time = frame.timers[0].cpuTime;
+		uint64_t busy = 0;
+		for (size_t i = 0; i < frame.used; i++)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(frame.timers[i].query, GL_QUERY_RESULT, &elapsed);
+			time = std::max(time, frame.timers[i].cpuTime);
+			addProfilerEvent(frame.timers[i].name, time, time + elapsed, PROFILER_GPU_THREAD);
+			time += elapsed;
+			busy += elapsed;
+		}
+		gpuFrameTime += busy / 1e9f;
+		gpuFrameCount++;
+		return true;
+	}
+
+	//Marks the timers of the frame that just ended for read back and reads back the finished frames
+	void endGpuFrame()
+	{
+		gpuFrames[gpuFrame].pending = gpuFrames[gpuFrame].used > 0;
+		gpuFrame = (gpuFrame + 1) % PROFILER_GPU_LATENCY;
+		//Reads the finished frames from oldest to newest and stops at the first one that isn't done
+		for (int i = 0; i < PROFILER_GPU_LATENCY; i++)
+		{
+			GpuFrame& frame = gpuFrames[(gpuFrame + i) % PROFILER_GPU_LATENCY];
+			if (!frame.pending)
+				continue;
+			if (!readGpuFrame(frame))
+				break;
+			frame.pending = false;
+		}
+		//A frame that still hasn't finished after PROFILER_GPU_LATENCY frames loses its results, its queries are about to be reused
+		gpuFrames[gpuFrame].pending = false;
+		gpuFrames[gpuFrame].used = 0;
+	}
+}
+
+void initGpuProfiler()
+{
+	gpuInitialized = true;
+	setProfilerFrameCallback(endGpuFrame);
+}
+
+void beginGpuTimer(const char* name)
+{
+	if (!gpuInitialized)
+		return;
+	GpuFrame& frame = gpuFrames[gpuFrame];
+	if (frame.used == frame.timers.size())
+	{
+		GpuTimer timer;
+		glGenQueries(1, &timer.query);
+		frame.timers.push_back(timer);
+	}
+	GpuTimer& timer = frame.timers[frame.used++];
+	timer.name = name;
+	timer.cpuTime = getProfilerTime();
+	glBeginQuery(GL_TIME_ELAPSED, timer.query);
+}
+
+void endGpuTimer()
+{
+	if (gpuInitialized)
+		glEndQuery(GL_TIME_ELAPSED);
+}
+
+float takeGpuFrameTime()
+{
+	float average = gpuFrameCount ? gpuFrameTime / gpuFrameCount : 0.f;
+	gpuFrameTime = 0.f;
+	gpuFrameCount = 0;
+	return average;
+}
+
+#endif
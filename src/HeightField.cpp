@@ -0,0 +1,162 @@
+#include "HeightField.h"
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HEIGHT_FIELD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHT_FIELD_SSE
+#endif
+
+namespace
+{
+	//Height and gradient (per cell) of the triangle under (x, z). Writing the lower triangle relative to corner (0, 0) and the upper one
+	//relative to corner (1, 1) lets both use the same formula, which the SIMD paths evaluate in the same order
+	inline void sampleCell(const HeightField& field, float x, float z, float& height, float& gradientX, float& gradientZ)
+	{
+		float toGrid = field.samples / field.size;
+		float maxCell = (float)(field.samples - 1);
+		float gridX = std::min(std::max(x * toGrid, 0.f), (float)field.samples);
+		float gridZ = std::min(std::max(z * toGrid, 0.f), (float)field.samples);
+		float cellX = std::min((float)(int)gridX, maxCell);
+		float cellZ = std::min((float)(int)gridZ, maxCell);
+		float fx = gridX - cellX, fz = gridZ - cellZ;
+
+		size_t stride = field.samples + 1;
+		const float* corner = field.heights + (size_t)cellZ * stride + (size_t)cellX;
+		float h00 = corner[0], h10 = corner[1], h01 = corner[stride], h11 = corner[stride + 1];
+		bool upper = fx + fz >= 1.f;
+		float base = upper ? 1.f : 0.f;
+		gradientX = upper ? h11 - h01 : h10 - h00;
+		gradientZ = upper ? h11 - h10 : h01 - h00;
+		height = (upper ? h11 : h00) + (fx - base) * gradientX + (fz - base) * gradientZ;
+	}
+
+	inline void writeSurface(float gradientX, float gradientZ, glm::vec3* normal, float* slope)
+	{
+		float lengthSquared = gradientX * gradientX + gradientZ * gradientZ;
+		if (normal)
+		{
+			float inverseLength = 1.f / std::sqrt(1.f + lengthSquared);
+			*normal = glm::vec3(-gradientX * inverseLength, inverseLength, -gradientZ * inverseLength);
+		}
+		if (slope)
+			*slope = std::sqrt(lengthSquared);
+	}
+}
+
+float sampleHeight(const HeightField& field, float x, float z)
+{
+	float height, gradientX, gradientZ;
+	sampleCell(field, x, z, height, gradientX, gradientZ);
+	return height;
+}
+
+void sampleHeights(const HeightField& field, const float* x, const float* z, size_t count, float* heights, glm::vec3* normals, float* slopes)
+{
+	float toGrid = field.samples / field.size;
+	size_t i = 0;
+
+#if defined(HEIGHT_FIELD_AVX2)
+	const __m256 gridScale = _mm256_set1_ps(toGrid);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 maxGrid = _mm256_set1_ps((float)field.samples);
+	const __m256 maxCell = _mm256_set1_ps((float)(field.samples - 1));
+	const __m256i stride = _mm256_set1_epi32(field.samples + 1);
+	const __m256i next = _mm256_set1_epi32(1);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 gridX = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), gridScale), zero), maxGrid);
+		__m256 gridZ = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(z + i), gridScale), zero), maxGrid);
+		__m256 cellX = _mm256_min_ps(_mm256_floor_ps(gridX), maxCell);
+		__m256 cellZ = _mm256_min_ps(_mm256_floor_ps(gridZ), maxCell);
+		__m256 fx = _mm256_sub_ps(gridX, cellX);
+		__m256 fz = _mm256_sub_ps(gridZ, cellZ);
+
+		__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cellZ), stride), _mm256_cvttps_epi32(cellX));
+		__m256i index01 = _mm256_add_epi32(index00, stride);
+		__m256 h00 = _mm256_i32gather_ps(field.heights, index00, 4);
+		__m256 h10 = _mm256_i32gather_ps(field.heights, _mm256_add_epi32(index00, next), 4);
+		__m256 h01 = _mm256_i32gather_ps(field.heights, index01, 4);
+		__m256 h11 = _mm256_i32gather_ps(field.heights, _mm256_add_epi32(index01, next), 4);
+
+		__m256 upper = _mm256_cmp_ps(_mm256_add_ps(fx, fz), one, _CMP_GE_OQ);
+		__m256 base = _mm256_and_ps(upper, one);
+		__m256 gradientX = _mm256_blendv_ps(_mm256_sub_ps(h10, h00), _mm256_sub_ps(h11, h01), upper);
+		__m256 gradientZ = _mm256_blendv_ps(_mm256_sub_ps(h01, h00), _mm256_sub_ps(h11, h10), upper);
+		__m256 height = _mm256_add_ps(_mm256_add_ps(_mm256_blendv_ps(h00, h11, upper), _mm256_mul_ps(_mm256_sub_ps(fx, base), gradientX)),
+			_mm256_mul_ps(_mm256_sub_ps(fz, base), gradientZ));
+		_mm256_storeu_ps(heights + i, height);
+
+		if (normals || slopes)
+		{
+			float lanesX[8], lanesZ[8];
+			_mm256_storeu_ps(lanesX, gradientX);
+			_mm256_storeu_ps(lanesZ, gradientZ);
+			for (int lane = 0; lane < 8; lane++)
+				writeSurface(lanesX[lane] * toGrid, lanesZ[lane] * toGrid, normals ? normals + i + lane : nullptr, slopes ? slopes + i + lane : nullptr);
+		}
+	}
+#elif defined(HEIGHT_FIELD_SSE)
+	//SSE2 has no gather, so the corner heights are loaded one lane at a time
+	const __m128 gridScale = _mm_set1_ps(toGrid);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 maxGrid = _mm_set1_ps((float)field.samples);
+	const __m128 maxCell = _mm_set1_ps((float)(field.samples - 1));
+	size_t stride = field.samples + 1;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 gridX = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(x + i), gridScale), zero), maxGrid);
+		__m128 gridZ = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(z + i), gridScale), zero), maxGrid);
+		//Truncation is a floor here since the grid coordinates are never negative
+		__m128 cellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gridX)), maxCell);
+		__m128 cellZ = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gridZ)), maxCell);
+		__m128 fx = _mm_sub_ps(gridX, cellX);
+		__m128 fz = _mm_sub_ps(gridZ, cellZ);
+
+		alignas(16) int32_t lanesX[4], lanesZ[4];
+		alignas(16) float corners[4][4];
+		_mm_store_si128((__m128i*)lanesX, _mm_cvttps_epi32(cellX));
+		_mm_store_si128((__m128i*)lanesZ, _mm_cvttps_epi32(cellZ));
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const float* corner = field.heights + lanesZ[lane] * stride + lanesX[lane];
+			corners[0][lane] = corner[0];
+			corners[1][lane] = corner[1];
+			corners[2][lane] = corner[stride];
+			corners[3][lane] = corner[stride + 1];
+		}
+		__m128 h00 = _mm_load_ps(corners[0]), h10 = _mm_load_ps(corners[1]), h01 = _mm_load_ps(corners[2]), h11 = _mm_load_ps(corners[3]);
+
+		__m128 upper = _mm_cmpge_ps(_mm_add_ps(fx, fz), one);
+		__m128 base = _mm_and_ps(upper, one);
+		__m128 gradientX = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h11, h01)), _mm_andnot_ps(upper, _mm_sub_ps(h10, h00)));
+		__m128 gradientZ = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h11, h10)), _mm_andnot_ps(upper, _mm_sub_ps(h01, h00)));
+		__m128 corner = _mm_or_ps(_mm_and_ps(upper, h11), _mm_andnot_ps(upper, h00));
+		__m128 height = _mm_add_ps(_mm_add_ps(corner, _mm_mul_ps(_mm_sub_ps(fx, base), gradientX)), _mm_mul_ps(_mm_sub_ps(fz, base), gradientZ));
+		_mm_storeu_ps(heights + i, height);
+
+		if (normals || slopes)
+		{
+			alignas(16) float gradientsX[4], gradientsZ[4];
+			_mm_store_ps(gradientsX, gradientX);
+			_mm_store_ps(gradientsZ, gradientZ);
+			for (int lane = 0; lane < 4; lane++)
+				writeSurface(gradientsX[lane] * toGrid, gradientsZ[lane] * toGrid, normals ? normals + i + lane : nullptr, slopes ? slopes + i + lane : nullptr);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float gradientX, gradientZ;
+		sampleCell(field, x[i], z[i], heights[i], gradientX, gradientZ);
+		if (normals || slopes)
+			writeSurface(gradientX * toGrid, gradientZ * toGrid, normals ? normals + i : nullptr, slopes ? slopes + i : nullptr);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+//View of a grid of (samples + 1)^2 heights spanning [0, size] along x and z. Every cell is split into two triangles along the diagonal from (x + 1, z) to (x, z + 1)
+struct HeightField
+{
+	const float* heights;
+	int samples;
+	float size;
+};
+
+//Height of the triangle surface at (x, z). Positions outside of the field are clamped to its edge
+float sampleHeight(const HeightField& field, float x, float z);
+
+//Heights at count positions, using AVX2 or SSE when the compiler targets them. normals (unit length) and slopes (rise over run) are only written if not null.
+//Matches sampleHeight up to floating point rounding, including the clamping at the edges
+void sampleHeights(const HeightField& field, const float* x, const float* z, size_t count, float* heights, glm::vec3* normals = nullptr, float* slopes = nullptr);
@@ -0,0 +1,204 @@
+#include "HeightPyramid.h"
+#include <cmath>
+#include <cstdint>
+#include <cfloat>
+#include <algorithm>
+
+namespace
+{
+	struct Ray
+	{
+		glm::vec3 origin, direction, inverseDirection;
+		float maxDistance;
+	};
+
+	struct Node
+	{
+		int level, x, z;
+	};
+
+	//Spreads the lower 16 bits of value over the even bits
+	inline uint32_t spreadBits(uint32_t value)
+	{
+		value &= 0xFFFF;
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+		return value;
+	}
+
+	inline uint32_t getMortonIndex(int x, int z)
+	{
+		return spreadBits(x) | (spreadBits(z) << 1);
+	}
+
+	//Slab test. Returns false if the ray misses the box within [0, maxDistance]
+	inline bool intersectBox(const Ray& ray, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+	{
+		float x0 = (minX - ray.origin.x) * ray.inverseDirection.x, x1 = (maxX - ray.origin.x) * ray.inverseDirection.x;
+		float y0 = (minY - ray.origin.y) * ray.inverseDirection.y, y1 = (maxY - ray.origin.y) * ray.inverseDirection.y;
+		float z0 = (minZ - ray.origin.z) * ray.inverseDirection.z, z1 = (maxZ - ray.origin.z) * ray.inverseDirection.z;
+		float tMin = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), 0.f));
+		float tMax = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), ray.maxDistance));
+		return tMin <= tMax;
+	}
+
+	//Moller-Trumbore ray triangle intersection
+	bool intersectTriangle(const Ray& ray, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float& t)
+	{
+		glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+		glm::vec3 p = glm::cross(ray.direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (std::fabs(determinant) < 1e-12f)
+			return false;
+		float inverseDeterminant = 1.f / determinant;
+		glm::vec3 s = ray.origin - p0;
+		float u = glm::dot(s, p) * inverseDeterminant;
+		if (u < 0.f || u > 1.f)
+			return false;
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(ray.direction, q) * inverseDeterminant;
+		if (v < 0.f || u + v > 1.f)
+			return false;
+		t = glm::dot(edge2, q) * inverseDeterminant;
+		return t >= 0.f && t <= ray.maxDistance;
+	}
+
+	//Tests both triangles of a cell, split the same way as the terrain is drawn
+	bool intersectCell(const HeightField& field, const Ray& ray, int x, int z, RayHit& hit)
+	{
+		float cellSize = field.size / field.samples;
+		size_t stride = field.samples + 1;
+		const float* corner = field.heights + (size_t)z * stride + x;
+		glm::vec3 p00(x * cellSize, corner[0], z * cellSize);
+		glm::vec3 p10((x + 1) * cellSize, corner[1], z * cellSize);
+		glm::vec3 p01(x * cellSize, corner[stride], (z + 1) * cellSize);
+		glm::vec3 p11((x + 1) * cellSize, corner[stride + 1], (z + 1) * cellSize);
+
+		float t, closest = FLT_MAX;
+		glm::vec3 normal;
+		if (intersectTriangle(ray, p00, p01, p10, t) && t < closest)
+		{
+			closest = t;
+			normal = glm::cross(p01 - p00, p10 - p00);
+		}
+		if (intersectTriangle(ray, p10, p01, p11, t) && t < closest)
+		{
+			closest = t;
+			normal = glm::cross(p01 - p10, p11 - p10);
+		}
+		if (closest == FLT_MAX)
+			return false;
+		hit.hit = true;
+		hit.distance = closest;
+		hit.position = ray.origin + ray.direction * closest;
+		hit.normal = glm::normalize(normal);
+		return true;
+	}
+}
+
+void buildHeightPyramid(const HeightField& field, HeightPyramid& pyramid)
+{
+	int leafWidth = (field.samples + 1) / 2;
+	int paddedWidth = 1;
+	while (paddedWidth < leafWidth)
+		paddedWidth *= 2;
+
+	pyramid.levels.clear();
+	HeightPyramid::Level base;
+	base.width = leafWidth;
+	base.bounds.assign((size_t)paddedWidth * paddedWidth, glm::vec2(FLT_MAX, -FLT_MAX));
+	size_t stride = field.samples + 1;
+	for (int z = 0; z < leafWidth; z++)
+	{
+		for (int x = 0; x < leafWidth; x++)
+		{
+			//The up to 3x3 samples of the leaf's cells, fewer on the last row and column of odd sized fields
+			glm::vec2 bounds(FLT_MAX, -FLT_MAX);
+			for (int sz = z * 2; sz <= std::min(z * 2 + 2, field.samples); sz++)
+			{
+				for (int sx = x * 2; sx <= std::min(x * 2 + 2, field.samples); sx++)
+				{
+					float height = field.heights[sz * stride + sx];
+					bounds = glm::vec2(std::min(bounds.x, height), std::max(bounds.y, height));
+				}
+			}
+			base.bounds[getMortonIndex(x, z)] = bounds;
+		}
+	}
+	pyramid.levels.push_back(std::move(base));
+
+	//In Morton order the children of node i are nodes 4i to 4i + 3 of the level below
+	while (pyramid.levels.back().bounds.size() > 1)
+	{
+		const HeightPyramid::Level& below = pyramid.levels.back();
+		HeightPyramid::Level level;
+		level.width = (below.width + 1) / 2;
+		level.bounds.resize(below.bounds.size() / 4);
+		for (size_t i = 0; i < level.bounds.size(); i++)
+		{
+			const glm::vec2* children = &below.bounds[i * 4];
+			level.bounds[i] = glm::vec2(std::min(std::min(children[0].x, children[1].x), std::min(children[2].x, children[3].x)),
+				std::max(std::max(children[0].y, children[1].y), std::max(children[2].y, children[3].y)));
+		}
+		pyramid.levels.push_back(std::move(level));
+	}
+}
+
+RayHit raycastHeightField(const HeightField& field, const HeightPyramid& pyramid, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+	Ray ray;
+	ray.origin = origin;
+	ray.direction = direction;
+	ray.maxDistance = maxDistance;
+	for (int i = 0; i < 3; i++)
+		ray.inverseDirection[i] = 1.f / (direction[i] != 0.f ? direction[i] : 1e-30f);
+
+	//Children are pushed far to near so they are popped in the order the ray passes through them. A ray can only cross one of the two side children
+	int nearX = direction.x < 0.f ? 1 : 0;
+	int nearZ = direction.z < 0.f ? 1 : 0;
+	const int order[4][2] = { { 1 - nearX, 1 - nearZ }, { 1 - nearX, nearZ }, { nearX, 1 - nearZ }, { nearX, nearZ } };
+
+	RayHit hit;
+	float cellSize = field.size / field.samples;
+	Node stack[4 * 32];
+	int stackSize = 0;
+	stack[stackSize++] = { (int)pyramid.levels.size() - 1, 0, 0 };
+	while (stackSize > 0)
+	{
+		Node node = stack[--stackSize];
+		const HeightPyramid::Level& level = pyramid.levels[node.level];
+		const glm::vec2& bounds = level.bounds[getMortonIndex(node.x, node.z)];
+		float nodeSize = cellSize * (2 << node.level);
+		if (!intersectBox(ray, node.x * nodeSize, bounds.x, node.z * nodeSize, std::min((node.x + 1) * nodeSize, field.size), bounds.y, std::min((node.z + 1) * nodeSize, field.size)))
+			continue;
+
+		//The cells of a leaf are tested near to far, the first hit is the closest
+		if (node.level == 0)
+		{
+			for (int i = 3; i >= 0; i--)
+			{
+				int x = node.x * 2 + order[i][0], z = node.z * 2 + order[i][1];
+				if (x < field.samples && z < field.samples && intersectCell(field, ray, x, z, hit))
+					return hit;
+			}
+			continue;
+		}
+
+		int childWidth = pyramid.levels[node.level - 1].width;
+		for (const int* child : order)
+		{
+			int x = node.x * 2 + child[0], z = node.z * 2 + child[1];
+			if (x < childWidth && z < childWidth)
+				stack[stackSize++] = { node.level - 1, x, z };
+		}
+	}
+	return hit;
+}
+
+void raycastHeightField(const HeightField& field, const HeightPyramid& pyramid, const glm::vec3* origins, const glm::vec3* directions, size_t count, float maxDistance, RayHit* hits)
+{
+	for (size_t i = 0; i < count; i++)
+		hits[i] = raycastHeightField(field, pyramid, origins[i], directions[i], maxDistance);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "HeightField.h"
+
+//Min/max mip pyramid over the cells of a height field. Level 0 holds the min and max of the 3x3 samples of every 2x2 cells, whose triangles are tested
+//directly, which keeps the largest level a quarter of the size of one node per cell. Every level above halves the resolution
+struct HeightPyramid
+{
+	//Min and max of every node in Morton (Z) order, so the four children of a node share a cache line. Levels are padded to a power of two, width is the used part
+	struct Level
+	{
+		int width;
+		std::vector<glm::vec2> bounds;
+	};
+	std::vector<Level> levels;
+};
+
+struct RayHit
+{
+	bool hit = false;
+	float distance = 0.f;
+	glm::vec3 position, normal;
+};
+
+void buildHeightPyramid(const HeightField& field, HeightPyramid& pyramid);
+
+//Finds the closest intersection of a ray with the height field triangles within maxDistance. direction has to be normalized for distance to be in world units.
+//The pyramid is descended front to back, skipping every node whose bounding box the ray misses
+RayHit raycastHeightField(const HeightField& field, const HeightPyramid& pyramid, const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+
+//Casts count rays against the same field
+void raycastHeightField(const HeightField& field, const HeightPyramid& pyramid, const glm::vec3* origins, const glm::vec3* directions, size_t count, float maxDistance, RayHit* hits);
@@ -0,0 +1,102 @@
+#include "InstanceCulling.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+bool isSphereVisible(const Frustum& frustum, float x, float y, float z, float radius)
+{
+	//Summed in the same order as the SIMD paths, so both agree on spheres touching a plane
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		if ((plane.x * x + plane.y * y) + (plane.z * z + plane.w) < -radius)
+			return false;
+	}
+	return true;
+}
+
+void addInstance(InstanceBounds& bounds, const glm::vec3& center, float radius)
+{
+	bounds.x.push_back(center.x);
+	bounds.y.push_back(center.y);
+	bounds.z.push_back(center.z);
+	bounds.radius.push_back(radius);
+}
+
+size_t cullInstances(const Frustum& frustum, const InstanceBounds& bounds, std::vector<uint32_t>& visible)
+{
+	size_t count = bounds.x.size();
+	visible.resize(count);
+	uint32_t* out = visible.data();
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+	//Survivors are compacted without branches: every lane writes its index and the count only advances for visible ones
+#if defined(CULLING_AVX)
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+	}
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(&bounds.x[i]);
+		__m256 y = _mm256_loadu_ps(&bounds.y[i]);
+		__m256 z = _mm256_loadu_ps(&bounds.z[i]);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planes[p][0]), _mm256_mul_ps(y, planes[p][1])),
+				_mm256_add_ps(_mm256_mul_ps(z, planes[p][2]), planes[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			out[visibleCount] = (uint32_t)(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#elif defined(CULLING_SSE)
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+	}
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&bounds.x[i]);
+		__m128 y = _mm_loadu_ps(&bounds.y[i]);
+		__m128 z = _mm_loadu_ps(&bounds.z[i]);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planes[p][0]), _mm_mul_ps(y, planes[p][1])),
+				_mm_add_ps(_mm_mul_ps(z, planes[p][2]), planes[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			out[visibleCount] = (uint32_t)(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		out[visibleCount] = (uint32_t)i;
+		visibleCount += isSphereVisible(frustum, bounds.x[i], bounds.y[i], bounds.z[i], bounds.radius[i]);
+	}
+	visible.resize(visibleCount);
+	return visibleCount;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+//World space bounding spheres of instances in structure of arrays layout, so they can be tested several at a time
+struct InstanceBounds
+{
+	std::vector<float> x, y, z, radius;
+};
+
+//Appends the bounding sphere of one instance
+void addInstance(InstanceBounds& bounds, const glm::vec3& center, float radius);
+
+//Tests a single sphere against all six planes. cullInstances gives the same answer for every instance
+bool isSphereVisible(const Frustum& frustum, float x, float y, float z, float radius);
+
+//Writes the indices of all instances whose bounding sphere intersects the frustum to visible, in increasing order.
+//Uses AVX when the compiler targets it, SSE otherwise and plain C++ on other architectures. Returns the number of visible instances
+size_t cullInstances(const Frustum& frustum, const InstanceBounds& bounds, std::vector<uint32_t>& visible);
@@ -0,0 +1,63 @@
+#include "InstanceTransform.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_SSE
+#endif
+
+namespace
+{
+#ifdef TRANSFORM_SSE
+	inline __m128 cross(__m128 a, __m128 b)
+	{
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	//Stores the xyz components of a vector without touching the float after them
+	inline void store3(float* out, __m128 v)
+	{
+		_mm_storel_pi((__m64*)out, v);
+		_mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+	}
+#endif
+}
+
+void writeInstanceTransforms(const glm::mat4* models, const uint32_t* indices, size_t count, InstanceTransform* out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* model = &models[indices[i]][0][0];
+		memcpy(out[i].model, model, sizeof(out[i].model));
+
+		//With a, b and c the first three columns of the model matrix, the inverse transpose has the columns b x c, c x a and a x b over the determinant
+#ifdef TRANSFORM_SSE
+		__m128 a = _mm_loadu_ps(model);
+		__m128 b = _mm_loadu_ps(model + 4);
+		__m128 c = _mm_loadu_ps(model + 8);
+		__m128 bc = cross(b, c);
+		__m128 ca = cross(c, a);
+		__m128 ab = cross(a, b);
+		__m128 products = _mm_mul_ps(a, bc);
+		float determinant = _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(products, _mm_shuffle_ps(products, products, 1)), _mm_movehl_ps(products, products)));
+		__m128 inverseDeterminant = _mm_set1_ps(1.f / determinant);
+		store3(out[i].normal, _mm_mul_ps(bc, inverseDeterminant));
+		store3(out[i].normal + 3, _mm_mul_ps(ca, inverseDeterminant));
+		store3(out[i].normal + 6, _mm_mul_ps(ab, inverseDeterminant));
+#else
+		glm::vec3 a(model[0], model[1], model[2]);
+		glm::vec3 b(model[4], model[5], model[6]);
+		glm::vec3 c(model[8], model[9], model[10]);
+		glm::vec3 columns[3] = { glm::cross(b, c), glm::cross(c, a), glm::cross(a, b) };
+		float inverseDeterminant = 1.f / glm::dot(a, columns[0]);
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+				out[i].normal[column * 3 + row] = columns[column][row] * inverseDeterminant;
+		}
+#endif
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//Per instance vertex data. model is a column major mat4, normal the column major mat3 that transforms normals (the inverse transpose of model)
+struct InstanceTransform
+{
+	float model[16];
+	float normal[9];
+};
+
+//Copies the model matrices at the given indices to out and computes their normal matrices, four components at a time with SSE when available
+void writeInstanceTransforms(const glm::mat4* models, const uint32_t* indices, size_t count, InstanceTransform* out);
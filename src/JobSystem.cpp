@@ -0,0 +1,220 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+
+struct Job
+{
+	std::function<void()> work;
+	JobHandle parent;
+	//The job itself plus its unfinished children
+	std::atomic<int> unfinished{ 1 };
+	//Unfinished prerequisites plus one until run() is called
+	std::atomic<int> blockers{ 1 };
+	std::mutex mutex;
+	std::vector<JobHandle> continuations;
+	bool finished = false;
+};
+
+namespace
+{
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local unsigned currentWorker = 0;
+}
+
+JobSystem::JobSystem(unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	running = true;
+	queuedJobs = 0;
+	nextQueue = 0;
+	for (unsigned i = 0; i < threadCount; i++)
+		queues.emplace_back(new WorkerQueue());
+
+	currentSystem = this;
+	currentWorker = 0;
+	for (unsigned i = 1; i < threadCount; i++)
+		threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	if (currentSystem == this)
+		currentSystem = nullptr;
+}
+
+JobHandle JobSystem::createJob(std::function<void()> work, const JobHandle& parent)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->work = std::move(work);
+	job->parent = parent;
+	if (parent)
+		parent->unfinished++;
+	return job;
+}
+
+void JobSystem::addDependency(const JobHandle& job, const JobHandle& prerequisite)
+{
+	std::lock_guard<std::mutex> lock(prerequisite->mutex);
+	if (prerequisite->finished)
+		return;
+	job->blockers++;
+	prerequisite->continuations.push_back(job);
+}
+
+void JobSystem::run(const JobHandle& job)
+{
+	if (--job->blockers == 0)
+		push(job);
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+	unsigned index = getWorkerIndex();
+	while (job->unfinished > 0)
+	{
+		JobHandle other = findJob(index);
+		if (other)
+			execute(other);
+		else
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::isFinished(const JobHandle& job) const
+{
+	return job->unfinished == 0;
+}
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (begin >= end)
+		return;
+	grainSize = std::max(grainSize, (size_t)1);
+	if (end - begin <= grainSize || queues.size() == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	JobHandle root = createJob(nullptr);
+	for (size_t first = begin; first < end; first += grainSize)
+	{
+		size_t last = std::min(first + grainSize, end);
+		run(createJob([&body, first, last]() { body(first, last); }, root));
+	}
+	run(root);
+	wait(root);
+}
+
+unsigned JobSystem::getThreadCount() const
+{
+	return (unsigned)queues.size();
+}
+
+void JobSystem::workerLoop(unsigned index)
+{
+	currentSystem = this;
+	currentWorker = index;
+	while (running)
+	{
+		JobHandle job = findJob(index);
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this]() { return !running || queuedJobs > 0; });
+	}
+}
+
+unsigned JobSystem::getWorkerIndex() const
+{
+	//Threads that don't belong to this system spread their jobs over all the queues
+	if (currentSystem == this)
+		return currentWorker;
+	return nextQueue.load() % queues.size();
+}
+
+void JobSystem::push(const JobHandle& job)
+{
+	unsigned index = currentSystem == this ? currentWorker : nextQueue++ % queues.size();
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->jobs.push_back(job);
+	}
+	queuedJobs++;
+	{
+		//Taking the lock makes sure a worker about to sleep sees the new job
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_one();
+}
+
+JobHandle JobSystem::findJob(unsigned index)
+{
+	//Newest job of our own queue first, since its data is most likely still in cache
+	{
+		WorkerQueue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			JobHandle job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queuedJobs--;
+			return job;
+		}
+	}
+
+	//Otherwise steal the oldest job of another worker, which tends to be the biggest piece of work
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		WorkerQueue& queue = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			JobHandle job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedJobs--;
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::execute(const JobHandle& job)
+{
+	if (job->work)
+	{
+		PROFILE_SCOPE("Job");
+		job->work();
+	}
+	finish(job);
+}
+
+void JobSystem::finish(const JobHandle& job)
+{
+	if (--job->unfinished > 0)
+		return;
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+	for (const JobHandle& continuation : continuations)
+		run(continuation);
+	if (job->parent)
+		finish(job->parent);
+}
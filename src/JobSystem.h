@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+typedef std::shared_ptr<Job> JobHandle;
+
+//Work stealing task scheduler. Every worker owns a deque it pushes to and pops from at the back, idle workers steal from the front of the others.
+//The thread that creates the JobSystem is worker 0 and runs jobs while it waits
+class JobSystem
+{
+public:
+	//Creates threadCount - 1 worker threads. 0 uses one thread per hardware thread
+	explicit JobSystem(unsigned threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//Creates a job without scheduling it. A job with a parent counts as unfinished work of the parent
+	JobHandle createJob(std::function<void()> work, const JobHandle& parent = nullptr);
+	//Makes job wait for prerequisite to finish. Must be called before job is run
+	void addDependency(const JobHandle& job, const JobHandle& prerequisite);
+	//Schedules a job. It starts as soon as all of its prerequisites have finished
+	void run(const JobHandle& job);
+	//Runs other jobs until the given job and all of its children have finished
+	void wait(const JobHandle& job);
+	bool isFinished(const JobHandle& job) const;
+
+	//Calls body(first, last) for consecutive ranges of at most grainSize items covering [begin, end) and waits for all of them
+	void parallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+	unsigned getThreadCount() const;
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	void workerLoop(unsigned index);
+	unsigned getWorkerIndex() const;
+	void push(const JobHandle& job);
+	JobHandle findJob(unsigned index);
+	void execute(const JobHandle& job);
+	void finish(const JobHandle& job);
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<bool> running;
+	std::atomic<int> queuedJobs;
+	std::atomic<unsigned> nextQueue;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+};
@@ -0,0 +1,255 @@
+#include "MeshCache.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char bakedMeshMagic[4] = { 'B', 'M', 'S', 'H' };
+
+	inline uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	template<class T>
+	uint64_t appendBlob(std::vector<char>& out, const std::vector<T>& data)
+	{
+		uint64_t offset = alignOffset(out.size());
+		out.resize(offset + data.size() * sizeof(T));
+		if (!data.empty())
+			memcpy(&out[offset], &data[0], data.size() * sizeof(T));
+		return offset;
+	}
+
+	//Written without offset + bytes, which a corrupt file could overflow. Blobs are 16 byte aligned, so their indices can be read in place
+	inline bool isBlobInFile(uint64_t offset, uint64_t bytes, size_t size)
+	{
+		return offset % 16 == 0 && offset <= size && bytes <= size - offset;
+	}
+
+	template<class T>
+	bool areIndicesInRange(const T* indices, uint32_t indexCount, uint32_t vertexCount)
+	{
+		T largest = 0;
+		for (uint32_t i = 0; i < indexCount; i++)
+			largest = std::max(largest, indices[i]);
+		return indexCount == 0 || largest < vertexCount;
+	}
+}
+
+MappedFile::MappedFile()
+{
+	mapping = nullptr;
+	length = 0;
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	fileMapping = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!fileMapping)
+	{
+		close();
+		return false;
+	}
+	mapping = (const char*)MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!mapping)
+	{
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* address = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED)
+		return false;
+	mapping = (const char*)address;
+	length = info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (mapping)
+		UnmapViewOfFile(mapping);
+	if (fileMapping)
+		CloseHandle(fileMapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	fileMapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (mapping)
+		munmap((void*)mapping, length);
+#endif
+	mapping = nullptr;
+	length = 0;
+}
+
+const char* MappedFile::data() const
+{
+	return mapping;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
+
+bool getSourceStamp(const char* path, SourceStamp& stamp)
+{
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+	stamp.size = size;
+	stamp.time = (int64_t)time.time_since_epoch().count();
+	return true;
+}
+
+void bakeMesh(const IndexedMesh& mesh, const VertexFormat& format, const SourceStamp& stamp, std::vector<char>& out)
+{
+	PackedVertices packed;
+	packVertices(format, &mesh.vertices[0], &mesh.normals[0], &mesh.uvs[0], mesh.vertices.size(), packed);
+
+	BakedMeshHeader header = {};
+	memcpy(header.magic, bakedMeshMagic, sizeof(header.magic));
+	header.version = BAKED_MESH_VERSION;
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+	header.vertexCount = (uint32_t)mesh.vertices.size();
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.attributeCount = (uint32_t)packed.attributes.size();
+	header.format = format;
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = packed.boundsMin[i];
+		header.boundsMax[i] = packed.boundsMax[i];
+		header.positionOffset[i] = packed.positionOffset[i];
+		header.positionScale[i] = packed.positionScale[i];
+	}
+
+	out.assign(sizeof(BakedMeshHeader) + packed.attributes.size() * sizeof(VertexAttribute), 0);
+	header.vertexOffset = appendBlob(out, packed.data);
+	header.vertexBytes = packed.data.size();
+
+	if (header.vertexCount <= 0xFFFF)
+	{
+		std::vector<uint16_t> shortIndices(mesh.indices.begin(), mesh.indices.end());
+		header.indexType = GL_UNSIGNED_SHORT;
+		header.indexOffset = appendBlob(out, shortIndices);
+		header.indexBytes = shortIndices.size() * sizeof(uint16_t);
+	}
+	else
+	{
+		header.indexType = GL_UNSIGNED_INT;
+		header.indexOffset = appendBlob(out, mesh.indices);
+		header.indexBytes = mesh.indices.size() * sizeof(uint32_t);
+	}
+
+	memcpy(&out[0], &header, sizeof(header));
+	memcpy(&out[sizeof(header)], &packed.attributes[0], packed.attributes.size() * sizeof(VertexAttribute));
+}
+
+bool readBakedMesh(const char* data, size_t size, const SourceStamp& stamp, const VertexFormat& format, BakedMeshView& view)
+{
+	if (!data || size < sizeof(BakedMeshHeader))
+		return false;
+	const BakedMeshHeader* header = (const BakedMeshHeader*)data;
+	if (memcmp(header->magic, bakedMeshMagic, sizeof(header->magic)) || header->version != BAKED_MESH_VERSION)
+		return false;
+	if (header->sourceSize != stamp.size || header->sourceTime != stamp.time)
+		return false;
+	if (header->format.position != format.position || header->format.normal != format.normal || header->format.uv != format.uv)
+		return false;
+
+	//Every size is checked against the file and against the counts, so a corrupt file can't make the upload or a draw read past a buffer
+	if ((header->attributeCount != 2 && header->attributeCount != 3) || sizeof(BakedMeshHeader) + header->attributeCount * sizeof(VertexAttribute) > size)
+		return false;
+	if (!isBlobInFile(header->vertexOffset, header->vertexBytes, size) || !isBlobInFile(header->indexOffset, header->indexBytes, size))
+		return false;
+	//The attributes have to be the ones this format is packed with, which also pins their types, offsets and the stride
+	PackedVertices layout;
+	setPackedLayout(format, header->attributeCount == 3, header->boundsMin, header->boundsMax, layout);
+	const VertexAttribute* attributes = (const VertexAttribute*)(data + sizeof(BakedMeshHeader));
+	if (layout.attributes.size() != header->attributeCount || memcmp(&layout.attributes[0], attributes, header->attributeCount * sizeof(VertexAttribute)))
+		return false;
+	if (header->vertexBytes != (uint64_t)header->vertexCount * layout.stride)
+		return false;
+
+	const char* indexData = data + header->indexOffset;
+	if (header->indexType == GL_UNSIGNED_SHORT)
+	{
+		if (header->indexBytes != (uint64_t)header->indexCount * sizeof(uint16_t) || !areIndicesInRange((const uint16_t*)indexData, header->indexCount, header->vertexCount))
+			return false;
+	}
+	else if (header->indexType == GL_UNSIGNED_INT)
+	{
+		if (header->indexBytes != (uint64_t)header->indexCount * sizeof(uint32_t) || !areIndicesInRange((const uint32_t*)indexData, header->indexCount, header->vertexCount))
+			return false;
+	}
+	else
+		return false;
+
+	view.header = header;
+	view.attributes = attributes;
+	view.vertexData = data + header->vertexOffset;
+	view.indexData = indexData;
+	return true;
+}
+
+bool writeFile(const std::string& path, const std::vector<char>& buffer)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+	file.write(buffer.data(), buffer.size());
+	return (bool)file;
+}
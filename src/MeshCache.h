@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "MeshOptimizer.h"
+#include "VertexFormat.h"
+
+constexpr uint32_t BAKED_MESH_VERSION = 2;
+
+//Identifies the source file a baked mesh was built from. A baked mesh is stale once either value changes
+struct SourceStamp
+{
+	uint64_t size = 0;
+	int64_t time = 0;
+};
+
+//Header at the start of a baked mesh file. It is followed by attributeCount VertexAttributes and then the 16 byte aligned vertex and index blobs
+struct BakedMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t vertexCount, indexCount;
+	uint32_t indexType;
+	uint32_t attributeCount;
+	float boundsMin[3], boundsMax[3];
+	VertexFormat format;
+	float positionOffset[3], positionScale[3];
+	uint32_t reserved;
+	uint64_t vertexOffset, vertexBytes;
+	uint64_t indexOffset, indexBytes;
+};
+
+//View into a baked mesh held in memory. All pointers point into the memory that was passed to readBakedMesh
+struct BakedMeshView
+{
+	const BakedMeshHeader* header = nullptr;
+	const VertexAttribute* attributes = nullptr;
+	const void* vertexData = nullptr;
+	const void* indexData = nullptr;
+};
+
+//Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+	const char* data() const;
+	size_t size() const;
+
+private:
+	const char* mapping;
+	size_t length;
+#ifdef _WIN32
+	void* file;
+	void* fileMapping;
+#endif
+};
+
+//Gets the size and last write time of a file. Returns false if the file doesn't exist
+bool getSourceStamp(const char* path, SourceStamp& stamp);
+
+//Encodes an indexed mesh with the given vertex format and serializes it into the baked mesh format
+void bakeMesh(const IndexedMesh& mesh, const VertexFormat& format, const SourceStamp& stamp, std::vector<char>& out);
+
+//Validates a baked mesh in memory against the source stamp and vertex format and fills view. Returns false if the data is stale, corrupt or in another format
+bool readBakedMesh(const char* data, size_t size, const SourceStamp& stamp, const VertexFormat& format, BakedMeshView& view);
+
+//Writes a buffer to a file, replacing it
+bool writeFile(const std::string& path, const std::vector<char>& buffer);
@@ -0,0 +1,252 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	//Tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+	const int maxCacheSize = 32;
+	const float cacheDecayPower = 1.5f;
+	const float lastTriScore = 0.75f;
+	const float valenceBoostScale = 2.f;
+	const float valenceBoostPower = 0.5f;
+
+	float vertexScore(int cachePosition, uint32_t remainingValence)
+	{
+		if (remainingValence == 0)
+			return -1.f;
+
+		float score = 0.f;
+		if (cachePosition >= 0)
+		{
+			//The last triangle's vertices get a fixed score so the next triangle doesn't simply reuse the same edge
+			if (cachePosition < 3)
+				score = lastTriScore;
+			else
+				score = std::pow(1.f - (cachePosition - 3) * (1.f / (maxCacheSize - 3)), cacheDecayPower);
+		}
+		//Boosts vertices with few triangles left so lone triangles don't get stranded
+		return score + valenceBoostScale * std::pow((float)remainingValence, -valenceBoostPower);
+	}
+
+	inline uint32_t hashVertex(const float* data, size_t count)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t bits;
+			memcpy(&bits, &data[i], sizeof(bits));
+			bits *= 0xcc9e2d51u;
+			bits = (bits << 15) | (bits >> 17);
+			hash = (hash ^ bits) * 16777619u;
+		}
+		return hash ^ (hash >> 16);
+	}
+}
+
+void buildIndexedMesh(const std::vector<Vertex>& vertices, const std::vector<Normal>& normals, const std::vector<UV>& uvs, IndexedMesh& mesh)
+{
+	size_t count = vertices.size();
+	mesh.vertices.clear();
+	mesh.normals.clear();
+	mesh.uvs.clear();
+	mesh.indices.resize(count);
+
+	//Open addressing table holding unique vertex indices, kept at most half full
+	size_t tableSize = 1;
+	while (tableSize < count * 2)
+		tableSize <<= 1;
+	const uint32_t empty = ~0u;
+	std::vector<uint32_t> table(tableSize, empty);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float key[8] = { vertices[i].x, vertices[i].y, vertices[i].z, normals[i].x, normals[i].y, normals[i].z, uvs[i].u, uvs[i].v };
+		size_t slot = hashVertex(key, 8) & (tableSize - 1);
+		while (true)
+		{
+			uint32_t unique = table[slot];
+			if (unique == empty)
+			{
+				unique = (uint32_t)mesh.vertices.size();
+				table[slot] = unique;
+				mesh.vertices.push_back(vertices[i]);
+				mesh.normals.push_back(normals[i]);
+				mesh.uvs.push_back(uvs[i]);
+				mesh.indices[i] = unique;
+				break;
+			}
+			if (!memcmp(&mesh.vertices[unique], &vertices[i], sizeof(Vertex)) &&
+				!memcmp(&mesh.normals[unique], &normals[i], sizeof(Normal)) &&
+				!memcmp(&mesh.uvs[unique], &uvs[i], sizeof(UV)))
+			{
+				mesh.indices[i] = unique;
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	//Builds a compact vertex -> triangle adjacency list. Emitted triangles are swapped out of the live part of each list
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		valence[indices[i]]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + valence[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vScore[v] = vertexScore(-1, valence[v]);
+
+	std::vector<float> tScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	int64_t best = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+		if (tScore[t] > tScore[best])
+			best = t;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	uint32_t cache[maxCacheSize + 3];
+	int cacheCount = 0;
+	size_t scanPosition = 0;
+
+	while (best >= 0)
+	{
+		const uint32_t* tri = &indices[best * 3];
+		emitted[best] = 1;
+		output.insert(output.end(), tri, tri + 3);
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t* list = &adjacency[offsets[tri[c]]];
+			uint32_t& live = valence[tri[c]];
+			for (uint32_t k = 0; k < live; k++)
+			{
+				if (list[k] == best)
+				{
+					list[k] = list[live - 1];
+					live--;
+					break;
+				}
+			}
+		}
+
+		//The emitted triangle's vertices move to the front of the LRU cache
+		uint32_t newCache[maxCacheSize + 3];
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (std::find(newCache, newCache + newCount, tri[c]) == newCache + newCount)
+				newCache[newCount++] = tri[c];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newCache[newCount++] = cache[i];
+		}
+		cacheCount = std::min(newCount, maxCacheSize);
+		for (int i = 0; i < newCount; i++)
+		{
+			cachePosition[newCache[i]] = i < maxCacheSize ? i : -1;
+			if (i < maxCacheSize)
+				cache[i] = newCache[i];
+		}
+
+		//Only the triangles touching the old or new cache contents can change score
+		for (int i = 0; i < newCount; i++)
+			vScore[newCache[i]] = vertexScore(cachePosition[newCache[i]], valence[newCache[i]]);
+		best = -1;
+		float bestScore = -1.f;
+		for (int i = 0; i < newCount; i++)
+		{
+			uint32_t v = newCache[i];
+			const uint32_t* list = &adjacency[offsets[v]];
+			for (uint32_t k = 0; k < valence[v]; k++)
+			{
+				uint32_t t = list[k];
+				tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					best = t;
+				}
+			}
+		}
+
+		//Nothing in the cache has work left, so continue with the next triangle that hasn't been emitted
+		if (best < 0)
+		{
+			while (scanPosition < triangleCount && emitted[scanPosition])
+				scanPosition++;
+			if (scanPosition < triangleCount)
+				best = scanPosition;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(IndexedMesh& mesh)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+	uint32_t next = 0;
+	for (uint32_t& index : mesh.indices)
+	{
+		if (remap[index] == unused)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	std::vector<Vertex> vertices(next);
+	std::vector<Normal> normals(next);
+	std::vector<UV> uvs(next);
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		if (remap[v] == unused)
+			continue;
+		vertices[remap[v]] = mesh.vertices[v];
+		normals[remap[v]] = mesh.normals[v];
+		uvs[remap[v]] = mesh.uvs[v];
+	}
+	mesh.vertices.swap(vertices);
+	mesh.normals.swap(normals);
+	mesh.uvs.swap(uvs);
+}
+
+float computeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+	if (indexCount < 3)
+		return 0.f;
+
+	//A vertex is in the FIFO if it was one of the last cacheSize misses
+	std::vector<int64_t> insertedAt(vertexCount, INT64_MIN / 2);
+	int64_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (misses - insertedAt[indices[i]] > (int64_t)cacheSize)
+		{
+			insertedAt[indices[i]] = misses;
+			misses++;
+		}
+	}
+	return misses / (float)(indexCount / 3);
+}
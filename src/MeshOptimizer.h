@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include "OBJLoader.h"
+
+//Vertex data split into unique vertices and a triangle list that indexes them
+struct IndexedMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<Normal> normals;
+	std::vector<UV> uvs;
+	std::vector<uint32_t> indices;
+};
+
+//Builds an indexed mesh out of non indexed triangle data by merging corners with bitwise identical position, normal and uv
+void buildIndexedMesh(const std::vector<Vertex>& vertices, const std::vector<Normal>& normals, const std::vector<UV>& uvs, IndexedMesh& mesh);
+
+//Reorders the triangles of an index buffer for post transform cache locality (Forsyth's linear speed vertex cache optimisation)
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+//Reorders the vertices of a mesh in the order the index buffer first references them, so vertex fetches walk memory linearly
+void optimizeVertexFetch(IndexedMesh& mesh);
+
+//Simulates a FIFO post transform cache and returns the average number of vertex shader invocations per triangle (ACMR)
+float computeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
@@ -0,0 +1,293 @@
+#include "OBJLoader.h"
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	enum class LineType { Vertex, Normal, UV, Face, Other };
+
+	//Exact element counts of an .obj file, gathered before parsing so no array has to grow
+	struct OBJCounts
+	{
+		size_t vertices = 0, normals = 0, uvs = 0, corners = 0;
+	};
+
+	//Skips spaces and tabs but never a line break
+	inline const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		return p;
+	}
+
+	//Returns a pointer to the first character of the next line
+	inline const char* skipLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	inline bool isLineEnd(const char* p, const char* end)
+	{
+		return p >= end || *p == '\n' || *p == '\r' || *p == '#';
+	}
+
+	inline bool isBlank(const char* p, const char* end)
+	{
+		return p >= end || *p == ' ' || *p == '\t';
+	}
+
+	//Reads the keyword at the start of a line and moves p past it
+	inline LineType readLineType(const char*& p, const char* end)
+	{
+		p = skipBlanks(p, end);
+		if (p >= end)
+			return LineType::Other;
+		if (p[0] == 'f' && isBlank(p + 1, end))
+		{
+			p += 1;
+			return LineType::Face;
+		}
+		if (p[0] != 'v')
+			return LineType::Other;
+		if (isBlank(p + 1, end))
+		{
+			p += 1;
+			return LineType::Vertex;
+		}
+		if (p + 1 < end && isBlank(p + 2, end))
+		{
+			p += 2;
+			if (p[-1] == 'n')
+				return LineType::Normal;
+			if (p[-1] == 't')
+				return LineType::UV;
+		}
+		return LineType::Other;
+	}
+
+	//Counts the whitespace separated corners of a face line
+	inline size_t countFaceCorners(const char* p, const char* end)
+	{
+		size_t count = 0;
+		while (true)
+		{
+			p = skipBlanks(p, end);
+			if (isLineEnd(p, end))
+				return count;
+			count++;
+			while (!isBlank(p, end) && !isLineEnd(p, end))
+				p++;
+		}
+	}
+
+	OBJCounts countOBJ(const char* p, const char* end)
+	{
+		OBJCounts counts;
+		while (p < end)
+		{
+			switch (readLineType(p, end))
+			{
+			case LineType::Vertex:
+				counts.vertices++;
+				break;
+			case LineType::Normal:
+				counts.normals++;
+				break;
+			case LineType::UV:
+				counts.uvs++;
+				break;
+			case LineType::Face:
+			{
+				size_t corners = countFaceCorners(p, end);
+				if (corners >= 3)
+					counts.corners += (corners - 2) * 3;
+				break;
+			}
+			default:
+				break;
+			}
+			p = skipLine(p, end);
+		}
+		return counts;
+	}
+
+	inline bool parseFloat(const char*& p, const char* end, float& value)
+	{
+		p = skipBlanks(p, end);
+		if (p < end && *p == '+')
+			p++;
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+			return false;
+		p = result.ptr;
+		return true;
+	}
+
+	//Parses a 1 based (or negative, relative) obj index and converts it to a 0 based index into an array of count elements
+	inline bool parseIndex(const char*& p, const char* end, size_t count, int& index)
+	{
+		int value = 0;
+		std::from_chars_result result = std::from_chars(p, end, value);
+		if (result.ec != std::errc() || value == 0)
+			return false;
+		p = result.ptr;
+		index = value > 0 ? value - 1 : (int)count + value;
+		return index >= 0 && (size_t)index < count;
+	}
+
+	//Parses a face corner in any of the v, v/vt, v//vn or v/vt/vn forms
+	inline bool parseCorner(const char*& p, const char* end, const OBJMesh& mesh, OBJCorner& corner)
+	{
+		corner = { -1, -1, -1 };
+		if (!parseIndex(p, end, mesh.vertices.size(), corner.v))
+			return false;
+		if (p >= end || *p != '/')
+			return true;
+		p++;
+		if (p < end && *p != '/' && !parseIndex(p, end, mesh.uvs.size(), corner.vt))
+			return false;
+		if (p >= end || *p != '/')
+			return true;
+		p++;
+		return parseIndex(p, end, mesh.normals.size(), corner.vn);
+	}
+
+	bool malformed(const char* data, const char* line)
+	{
+		std::cout << "Malformed obj data on line " << std::count(data, line, '\n') + 1 << std::endl;
+		return false;
+	}
+}
+
+bool readFile(const char* source, std::vector<char>& buffer)
+{
+	std::ifstream file(source, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	buffer.resize((size_t)size);
+	return size == 0 || (bool)file.read(buffer.data(), size);
+}
+
+bool parseOBJ(const char* data, size_t size, OBJMesh& mesh)
+{
+	const char* p = data;
+	const char* end = data + size;
+
+	OBJCounts counts = countOBJ(p, end);
+	mesh.vertices.clear();
+	mesh.normals.clear();
+	mesh.uvs.clear();
+	mesh.corners.clear();
+	mesh.vertices.reserve(counts.vertices);
+	mesh.normals.reserve(counts.normals);
+	mesh.uvs.reserve(counts.uvs);
+	mesh.corners.reserve(counts.corners);
+
+	std::vector<OBJCorner> face;
+	while (p < end)
+	{
+		const char* line = p;
+		switch (readLineType(p, end))
+		{
+		case LineType::Vertex:
+		{
+			Vertex vertex;
+			if (!parseFloat(p, end, vertex.x) || !parseFloat(p, end, vertex.y) || !parseFloat(p, end, vertex.z))
+				return malformed(data, line);
+			mesh.vertices.push_back(vertex);
+			break;
+		}
+		case LineType::Normal:
+		{
+			Normal normal;
+			if (!parseFloat(p, end, normal.x) || !parseFloat(p, end, normal.y) || !parseFloat(p, end, normal.z))
+				return malformed(data, line);
+			mesh.normals.push_back(normal);
+			break;
+		}
+		case LineType::UV:
+		{
+			UV uv;
+			if (!parseFloat(p, end, uv.u) || !parseFloat(p, end, uv.v))
+				return malformed(data, line);
+			mesh.uvs.push_back(uv);
+			break;
+		}
+		case LineType::Face:
+		{
+			face.clear();
+			while (true)
+			{
+				p = skipBlanks(p, end);
+				if (isLineEnd(p, end))
+					break;
+				OBJCorner corner;
+				if (!parseCorner(p, end, mesh, corner))
+					return malformed(data, line);
+				face.push_back(corner);
+			}
+			if (face.size() < 3)
+				return malformed(data, line);
+
+			//Quads and n-gons are split into a triangle fan around the first corner
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				mesh.corners.push_back(face[0]);
+				mesh.corners.push_back(face[i]);
+				mesh.corners.push_back(face[i + 1]);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		p = skipLine(p, end);
+	}
+
+	return true;
+}
+
+void expandOBJ(const OBJMesh& mesh, std::vector<Vertex>& vertices, std::vector<Normal>& normals, std::vector<UV>& uvs)
+{
+	size_t count = mesh.corners.size();
+	vertices.resize(count);
+	normals.resize(count);
+	uvs.resize(count);
+
+	for (size_t i = 0; i + 2 < count; i += 3)
+	{
+		const OBJCorner* tri = &mesh.corners[i];
+		for (int c = 0; c < 3; c++)
+		{
+			vertices[i + c] = mesh.vertices[tri[c].v];
+			uvs[i + c] = tri[c].vt >= 0 ? mesh.uvs[tri[c].vt] : UV{ 0, 0 };
+		}
+
+		if (tri[0].vn >= 0 && tri[1].vn >= 0 && tri[2].vn >= 0)
+		{
+			for (int c = 0; c < 3; c++)
+				normals[i + c] = mesh.normals[tri[c].vn];
+			continue;
+		}
+
+		//Falls back to the flat face normal when the file has no normals for this triangle
+		const Vertex& p0 = vertices[i];
+		const Vertex& p1 = vertices[i + 1];
+		const Vertex& p2 = vertices[i + 2];
+		float ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+		float bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+		Normal faceNormal = { ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx };
+		float length = std::sqrt(faceNormal.x * faceNormal.x + faceNormal.y * faceNormal.y + faceNormal.z * faceNormal.z);
+		if (length > 0.f)
+			faceNormal = { faceNormal.x / length, faceNormal.y / length, faceNormal.z / length };
+		for (int c = 0; c < 3; c++)
+			normals[i + c] = tri[c].vn >= 0 ? mesh.normals[tri[c].vn] : faceNormal;
+	}
+}
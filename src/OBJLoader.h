@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+//Vector 3 used to store either a 3D vertex or a normal vector
+struct Vertex
+{
+	float x, y, z;
+};
+typedef Vertex Normal;
+
+//Vector 2 for containing uv coords
+struct UV
+{
+	float u, v;
+};
+
+//Zero based indices of a single face corner. An index of -1 means the corner does not reference that attribute
+struct OBJCorner
+{
+	int v, vt, vn;
+};
+
+//CPU side contents of an .obj file. Faces are triangulated, so every 3 corners make up one triangle
+struct OBJMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<Normal> normals;
+	std::vector<UV> uvs;
+	std::vector<OBJCorner> corners;
+};
+
+//Reads a whole file into buffer with a single read. Returns false if the file can't be opened
+bool readFile(const char* source, std::vector<char>& buffer);
+
+//Parses an .obj file that has already been read into memory. Numbers are parsed straight from the buffer and every array is sized from an exact count first
+bool parseOBJ(const char* data, size_t size, OBJMesh& mesh);
+
+//Expands the corners of a parsed mesh into non indexed vertex, normal and uv arrays. Missing normals are replaced with the face normal and missing uvs with 0
+void expandOBJ(const OBJMesh& mesh, std::vector<Vertex>& vertices, std::vector<Normal>& normals, std::vector<UV>& uvs);
@@ -0,0 +1,410 @@
+#include "OcclusionCulling.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+namespace
+{
+	//Rows rasterized by one job and instances tested by one job
+	const size_t RASTER_BAND_ROWS = 16;
+	const size_t TEST_CHUNK_SIZE = 1024;
+
+	//Projects a clipped triangle and sets it up for rasterization. Triangles that are degenerate or cover no pixel center are dropped
+	void setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, int width, int height, std::vector<OccluderTriangle>& triangles)
+	{
+		glm::vec3 screen[3];
+		const glm::vec4* clip[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; i++)
+		{
+			float invW = 1.f / clip[i]->w;
+			screen[i] = glm::vec3((clip[i]->x * invW * 0.5f + 0.5f) * width, (clip[i]->y * invW * 0.5f + 0.5f) * height, clip[i]->z * invW * 0.5f + 0.5f);
+		}
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (std::abs(area) < 1e-6f)
+			return;
+		//Both windings are rasterized, counter clockwise order keeps the edge functions positive inside
+		if (area < 0.f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		float minX = std::min(std::min(screen[0].x, screen[1].x), screen[2].x), maxX = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+		float minY = std::min(std::min(screen[0].y, screen[1].y), screen[2].y), maxY = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+		//Pixels whose centers the bounds contain, clamped in float first so positions far outside the screen don't overflow
+		OccluderTriangle triangle;
+		triangle.minX = (int)std::ceil(std::max(minX - 0.5f, 0.f));
+		triangle.minY = (int)std::ceil(std::max(minY - 0.5f, 0.f));
+		triangle.maxX = (int)std::floor(std::min(maxX - 0.5f, (float)(width - 1)));
+		triangle.maxY = (int)std::floor(std::min(maxY - 0.5f, (float)(height - 1)));
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+			return;
+
+		//Depth over the screen is a plane, depth + depthX * x + depthY * y
+		glm::vec3 edge1 = screen[1] - screen[0], edge2 = screen[2] - screen[0];
+		triangle.depthX = (edge1.z * edge2.y - edge2.z * edge1.y) / area;
+		triangle.depthY = (edge2.z * edge1.x - edge1.z * edge2.x) / area;
+		triangle.depth = screen[0].z - triangle.depthX * screen[0].x - triangle.depthY * screen[0].y;
+		for (int i = 0; i < 3; i++)
+			triangle.positions[i] = glm::vec2(screen[i]);
+		triangles.push_back(triangle);
+	}
+
+	//Keeps the part of a triangle in front of the near plane (z >= -w), which is a triangle or a quad split into two
+	void clipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, int width, int height, std::vector<OccluderTriangle>& triangles)
+	{
+		const glm::vec4* vertices[3] = { &a, &b, &c };
+		glm::vec4 clipped[4];
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& current = *vertices[i];
+			const glm::vec4& next = *vertices[(i + 1) % 3];
+			float currentDistance = current.z + current.w, nextDistance = next.z + next.w;
+			if (currentDistance >= 0.f)
+				clipped[count++] = current;
+			if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+				clipped[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+		}
+		for (int i = 2; i < count; i++)
+			setupTriangle(clipped[0], clipped[i - 1], clipped[i], width, height, triangles);
+	}
+
+	//Rasterizes the rows [firstRow, lastRow) of every triangle, keeping the nearest depth of every pixel
+	void rasterizeBand(OcclusionBuffer::Level& level, const std::vector<OccluderTriangle>& triangles, int firstRow, int lastRow)
+	{
+		for (const OccluderTriangle& triangle : triangles)
+		{
+			int minY = std::max(triangle.minY, firstRow), maxY = std::min(triangle.maxY, lastRow - 1);
+			if (minY > maxY)
+				continue;
+
+			//Edge functions edgeA * x + edgeB * y + edgeC, positive on the inner side of each edge
+			float edgeA[3], edgeB[3], edgeC[3];
+			for (int i = 0; i < 3; i++)
+			{
+				const glm::vec2& from = triangle.positions[i];
+				const glm::vec2& to = triangle.positions[(i + 1) % 3];
+				edgeA[i] = from.y - to.y;
+				edgeB[i] = to.x - from.x;
+				edgeC[i] = -(edgeA[i] * from.x + edgeB[i] * from.y);
+			}
+
+			int firstX = triangle.minX & ~3;
+			for (int y = minY; y <= maxY; y++)
+			{
+				float centerY = y + 0.5f;
+				float* row = &level.depth[(size_t)y * level.width];
+				int x = firstX;
+#if defined(OCCLUSION_SSE)
+				__m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+				__m128 rowEdges[3], stepEdges[3];
+				for (int i = 0; i < 3; i++)
+				{
+					rowEdges[i] = _mm_add_ps(_mm_set1_ps(edgeB[i] * centerY + edgeC[i]), _mm_mul_ps(_mm_set1_ps(edgeA[i]), _mm_add_ps(_mm_set1_ps((float)x), offsets)));
+					stepEdges[i] = _mm_set1_ps(edgeA[i] * 4.f);
+				}
+				__m128 depth = _mm_add_ps(_mm_set1_ps(triangle.depth + triangle.depthY * centerY), _mm_mul_ps(_mm_set1_ps(triangle.depthX), _mm_add_ps(_mm_set1_ps((float)x), offsets)));
+				__m128 stepDepth = _mm_set1_ps(triangle.depthX * 4.f);
+				__m128 zero = _mm_setzero_ps();
+				//Widths are multiples of 4, so the last group of a row never runs past it
+				for (; x <= triangle.maxX; x += 4)
+				{
+					__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(rowEdges[0], zero), _mm_cmpge_ps(rowEdges[1], zero)), _mm_cmpge_ps(rowEdges[2], zero));
+					if (_mm_movemask_ps(inside))
+					{
+						__m128 old = _mm_loadu_ps(row + x);
+						__m128 nearest = _mm_min_ps(old, depth);
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+					}
+					for (int i = 0; i < 3; i++)
+						rowEdges[i] = _mm_add_ps(rowEdges[i], stepEdges[i]);
+					depth = _mm_add_ps(depth, stepDepth);
+				}
+#endif
+				for (; x <= triangle.maxX; x++)
+				{
+					float centerX = x + 0.5f;
+					bool inside = true;
+					for (int i = 0; i < 3; i++)
+						inside &= edgeA[i] * centerX + edgeB[i] * centerY + edgeC[i] >= 0.f;
+					if (inside)
+						row[x] = std::min(row[x], triangle.depth + triangle.depthX * centerX + triangle.depthY * centerY);
+				}
+			}
+		}
+	}
+
+	//Screen rectangle in pixels and nearest depth of an instance's bounding cube. Cubes reaching through the near plane aren't valid and always visible
+	struct ScreenBounds
+	{
+		float minX, minY, maxX, maxY, nearest;
+		bool valid;
+	};
+
+	ScreenBounds projectBounds(const OcclusionBuffer& buffer, const glm::vec3& center, float radius)
+	{
+		const OcclusionBuffer::Level& base = buffer.levels[0];
+		glm::vec4 centerClip = buffer.viewProjection * glm::vec4(center, 1.f);
+		glm::vec4 axes[3];
+		for (int i = 0; i < 3; i++)
+			axes[i] = buffer.viewProjection[i] * radius;
+
+		ScreenBounds bounds = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, FLT_MAX, true };
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec4 clip = centerClip;
+			for (int i = 0; i < 3; i++)
+				clip += (corner >> i) & 1 ? axes[i] : -axes[i];
+			bounds.valid &= clip.z >= -clip.w && clip.w > 0.f;
+			float invW = 1.f / clip.w;
+			float x = (clip.x * invW * 0.5f + 0.5f) * base.width, y = (clip.y * invW * 0.5f + 0.5f) * base.height;
+			bounds.minX = std::min(bounds.minX, x);
+			bounds.maxX = std::max(bounds.maxX, x);
+			bounds.minY = std::min(bounds.minY, y);
+			bounds.maxY = std::max(bounds.maxY, y);
+			bounds.nearest = std::min(bounds.nearest, clip.z * invW * 0.5f + 0.5f);
+		}
+		return bounds;
+	}
+
+#if defined(OCCLUSION_SSE)
+	//projectBounds for the four instances at indices, one per lane
+	void projectBounds4(const OcclusionBuffer& buffer, const InstanceBounds& instances, const uint32_t* indices, ScreenBounds bounds[4])
+	{
+		const OcclusionBuffer::Level& base = buffer.levels[0];
+		const glm::mat4& matrix = buffer.viewProjection;
+		__m128 x = _mm_set_ps(instances.x[indices[3]], instances.x[indices[2]], instances.x[indices[1]], instances.x[indices[0]]);
+		__m128 y = _mm_set_ps(instances.y[indices[3]], instances.y[indices[2]], instances.y[indices[1]], instances.y[indices[0]]);
+		__m128 z = _mm_set_ps(instances.z[indices[3]], instances.z[indices[2]], instances.z[indices[1]], instances.z[indices[0]]);
+		__m128 radius = _mm_set_ps(instances.radius[indices[3]], instances.radius[indices[2]], instances.radius[indices[1]], instances.radius[indices[0]]);
+		//Clip space center and axes of the cube, one register per component
+		__m128 center[4], axes[3][4];
+		for (int c = 0; c < 4; c++)
+		{
+			center[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(matrix[0][c]), x), _mm_mul_ps(_mm_set1_ps(matrix[1][c]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(matrix[2][c]), z), _mm_set1_ps(matrix[3][c])));
+			for (int i = 0; i < 3; i++)
+				axes[i][c] = _mm_mul_ps(_mm_set1_ps(matrix[i][c]), radius);
+		}
+
+		__m128 half = _mm_set1_ps(0.5f), width = _mm_set1_ps((float)base.width), height = _mm_set1_ps((float)base.height), zero = _mm_setzero_ps();
+		__m128 minX = _mm_set1_ps(FLT_MAX), minY = minX, nearest = minX, maxX = _mm_set1_ps(-FLT_MAX), maxY = maxX;
+		__m128 valid = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int corner = 0; corner < 8; corner++)
+		{
+			__m128 clip[4];
+			for (int c = 0; c < 4; c++)
+			{
+				clip[c] = center[c];
+				for (int i = 0; i < 3; i++)
+					clip[c] = (corner >> i) & 1 ? _mm_add_ps(clip[c], axes[i][c]) : _mm_sub_ps(clip[c], axes[i][c]);
+			}
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(clip[2], _mm_sub_ps(zero, clip[3])), _mm_cmpgt_ps(clip[3], zero)));
+			__m128 invW = _mm_div_ps(_mm_set1_ps(1.f), clip[3]);
+			__m128 screenX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[0], invW), half), half), width);
+			__m128 screenY = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[1], invW), half), half), height);
+			minX = _mm_min_ps(minX, screenX);
+			maxX = _mm_max_ps(maxX, screenX);
+			minY = _mm_min_ps(minY, screenY);
+			maxY = _mm_max_ps(maxY, screenY);
+			nearest = _mm_min_ps(nearest, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[2], invW), half), half));
+		}
+
+		float lanes[5][4];
+		_mm_storeu_ps(lanes[0], minX);
+		_mm_storeu_ps(lanes[1], minY);
+		_mm_storeu_ps(lanes[2], maxX);
+		_mm_storeu_ps(lanes[3], maxY);
+		_mm_storeu_ps(lanes[4], nearest);
+		int validMask = _mm_movemask_ps(valid);
+		for (int lane = 0; lane < 4; lane++)
+			bounds[lane] = { lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane], lanes[4][lane], ((validMask >> lane) & 1) != 0 };
+	}
+#endif
+
+	//True if the bounds lie behind the farthest occluder depth of every texel their rectangle touches
+	bool isOccluded(const OcclusionBuffer& buffer, const ScreenBounds& bounds)
+	{
+		const OcclusionBuffer::Level& base = buffer.levels[0];
+		if (!bounds.valid || bounds.maxX < 0.f || bounds.maxY < 0.f || bounds.minX >= base.width || bounds.minY >= base.height)
+			return false;
+
+		//Texels the rectangle touches plus one on every side
+		int x0 = std::max((int)std::floor(bounds.minX) - 1, 0), x1 = std::min((int)std::floor(std::min(bounds.maxX, (float)base.width)) + 1, base.width - 1);
+		int y0 = std::max((int)std::floor(bounds.minY) - 1, 0), y1 = std::min((int)std::floor(std::min(bounds.maxY, (float)base.height)) + 1, base.height - 1);
+		//The first level the rectangle spans at most 2x2 texels of
+		size_t level = 0;
+		while (level + 1 < buffer.levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+			level++;
+		const OcclusionBuffer::Level& hiZ = buffer.levels[level];
+		for (int y = y0 >> level; y <= y1 >> level; y++)
+		{
+			for (int x = x0 >> level; x <= x1 >> level; x++)
+			{
+				if (hiZ.depth[(size_t)y * hiZ.width + x] >= bounds.nearest)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+void buildTerrainOccluder(const HeightField& field, int cells, OccluderMesh& mesh)
+{
+	cells = std::max(std::min(cells, field.samples), 1);
+	int stride = field.samples + 1;
+	auto getSample = [&](int vertex) { return vertex * field.samples / cells; };
+
+	mesh.vertices.resize((size_t)(cells + 1) * (cells + 1));
+	for (int z = 0; z <= cells; z++)
+	{
+		int firstZ = getSample(std::max(z - 1, 0)), lastZ = getSample(std::min(z + 1, cells));
+		for (int x = 0; x <= cells; x++)
+		{
+			//The surface over a quad is at least as high as the lowest of its samples, and every point of a quad interpolates its corners
+			int firstX = getSample(std::max(x - 1, 0)), lastX = getSample(std::min(x + 1, cells));
+			float lowest = FLT_MAX;
+			for (int sampleZ = firstZ; sampleZ <= lastZ; sampleZ++)
+			{
+				for (int sampleX = firstX; sampleX <= lastX; sampleX++)
+					lowest = std::min(lowest, field.heights[(size_t)sampleZ * stride + sampleX]);
+			}
+			float toWorld = field.size / field.samples;
+			mesh.vertices[(size_t)z * (cells + 1) + x] = glm::vec3(getSample(x) * toWorld, lowest, getSample(z) * toWorld);
+		}
+	}
+
+	mesh.indices.clear();
+	mesh.indices.reserve((size_t)cells * cells * 6);
+	for (int z = 0; z < cells; z++)
+	{
+		for (int x = 0; x < cells; x++)
+		{
+			uint32_t corner = (uint32_t)(z * (cells + 1) + x);
+			uint32_t right = corner + 1, below = corner + cells + 1, diagonal = below + 1;
+			mesh.indices.insert(mesh.indices.end(), { corner, below, right, right, below, diagonal });
+		}
+	}
+}
+
+void initOcclusionBuffer(OcclusionBuffer& buffer, int width, int height)
+{
+	buffer.levels.clear();
+	while (true)
+	{
+		OcclusionBuffer::Level level;
+		level.width = width;
+		level.height = height;
+		level.depth.assign((size_t)width * height, 1.f);
+		buffer.levels.push_back(std::move(level));
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+void rasterizeOccluders(OcclusionBuffer& buffer, const glm::mat4& viewProjection, const OccluderMesh& mesh, JobSystem& jobs)
+{
+	OcclusionBuffer::Level& base = buffer.levels[0];
+	buffer.viewProjection = viewProjection;
+	{
+		PROFILE_SCOPE("Occluder setup");
+		buffer.clipPositions.resize(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+			buffer.clipPositions[i] = viewProjection * glm::vec4(mesh.vertices[i], 1.f);
+
+		buffer.triangles.clear();
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const glm::vec4& a = buffer.clipPositions[mesh.indices[i]];
+			const glm::vec4& b = buffer.clipPositions[mesh.indices[i + 1]];
+			const glm::vec4& c = buffer.clipPositions[mesh.indices[i + 2]];
+			//Triangles entirely outside one of the other frustum planes can't cover a pixel
+			if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) || (a.y > a.w && b.y > b.w && c.y > c.w) ||
+				(a.y < -a.w && b.y < -b.w && c.y < -c.w) || (a.z > a.w && b.z > b.w && c.z > c.w))
+				continue;
+			clipTriangle(a, b, c, base.width, base.height, buffer.triangles);
+		}
+	}
+
+	{
+		PROFILE_SCOPE("Occluder raster");
+		std::fill(base.depth.begin(), base.depth.end(), 1.f);
+		jobs.parallelFor(0, base.height, RASTER_BAND_ROWS, [&](size_t first, size_t last)
+		{
+			rasterizeBand(base, buffer.triangles, (int)first, (int)last);
+		});
+	}
+
+	//Every texel of a level keeps the farthest of the up to 2x2 texels below it, edges of odd sizes are repeated
+	PROFILE_SCOPE("Hierarchical Z");
+	for (size_t i = 1; i < buffer.levels.size(); i++)
+	{
+		const OcclusionBuffer::Level& below = buffer.levels[i - 1];
+		OcclusionBuffer::Level& level = buffer.levels[i];
+		for (int y = 0; y < level.height; y++)
+		{
+			const float* row0 = &below.depth[(size_t)(y * 2) * below.width];
+			const float* row1 = &below.depth[(size_t)std::min(y * 2 + 1, below.height - 1) * below.width];
+			for (int x = 0; x < level.width; x++)
+			{
+				int x0 = x * 2, x1 = std::min(x * 2 + 1, below.width - 1);
+				level.depth[(size_t)y * level.width + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+size_t cullOccludedInstances(const OcclusionBuffer& buffer, const InstanceBounds& bounds, JobSystem& jobs, std::vector<uint32_t>& visible)
+{
+	//Every chunk compacts its own range in place, then the ranges are moved together
+	size_t chunkCount = (visible.size() + TEST_CHUNK_SIZE - 1) / TEST_CHUNK_SIZE;
+	std::vector<size_t> chunkVisible(chunkCount);
+	jobs.parallelFor(0, chunkCount, 1, [&](size_t first, size_t last)
+	{
+		for (size_t chunk = first; chunk < last; chunk++)
+		{
+			size_t begin = chunk * TEST_CHUNK_SIZE, end = std::min(begin + TEST_CHUNK_SIZE, visible.size());
+			size_t kept = begin;
+			size_t i = begin;
+#if defined(OCCLUSION_SSE)
+			for (; i + 4 <= end; i += 4)
+			{
+				uint32_t indices[4] = { visible[i], visible[i + 1], visible[i + 2], visible[i + 3] };
+				ScreenBounds screenBounds[4];
+				projectBounds4(buffer, bounds, indices, screenBounds);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					visible[kept] = indices[lane];
+					kept += !isOccluded(buffer, screenBounds[lane]);
+				}
+			}
+#endif
+			for (; i < end; i++)
+			{
+				uint32_t index = visible[i];
+				visible[kept] = index;
+				kept += !isOccluded(buffer, projectBounds(buffer, glm::vec3(bounds.x[index], bounds.y[index], bounds.z[index]), bounds.radius[index]));
+			}
+			chunkVisible[chunk] = kept - begin;
+		}
+	});
+
+	size_t visibleCount = 0;
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		memmove(&visible[visibleCount], &visible[chunk * TEST_CHUNK_SIZE], chunkVisible[chunk] * sizeof(uint32_t));
+		visibleCount += chunkVisible[chunk];
+	}
+	visible.resize(visibleCount);
+	return visibleCount;
+}
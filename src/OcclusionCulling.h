@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "HeightField.h"
+#include "InstanceCulling.h"
+#include "JobSystem.h"
+
+//Coarse triangle grid that never rises above the height field it was built from, so anything it hides is hidden by the real surface as well
+struct OccluderMesh
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+};
+
+//Triangle set up for rasterization: screen space positions, the depth plane and the covered rows and columns
+struct OccluderTriangle
+{
+	glm::vec2 positions[3];
+	float depth, depthX, depthY;
+	int minX, minY, maxX, maxY;
+};
+
+//Low resolution depth buffer of the occluders seen by a camera and its hierarchical Z pyramid. Depths run from 0 at the near plane to 1 at the far plane
+struct OcclusionBuffer
+{
+	struct Level
+	{
+		int width, height;
+		std::vector<float> depth;
+	};
+	//Level 0 is the rasterized depth buffer, every level above holds the farthest depth of 2x2 texels of the one below
+	std::vector<Level> levels;
+	glm::mat4 viewProjection;
+	//Vertices and triangles of the last rasterization, kept so their memory is reused
+	std::vector<glm::vec4> clipPositions;
+	std::vector<OccluderTriangle> triangles;
+};
+
+//Builds a grid of cells x cells quads over the field. Every vertex takes the lowest height of the samples in the quads around it
+void buildTerrainOccluder(const HeightField& field, int cells, OccluderMesh& mesh);
+
+//Allocates the levels of a width x height buffer. width has to be a multiple of 4
+void initOcclusionBuffer(OcclusionBuffer& buffer, int width, int height);
+
+//Clears the buffer, rasterizes the mesh as seen through viewProjection and builds the pyramid. Triangles are clipped against the near plane and
+//rasterized in bands of rows on the job system's threads, 4 pixels at a time with SSE when the compiler targets it
+void rasterizeOccluders(OcclusionBuffer& buffer, const glm::mat4& viewProjection, const OccluderMesh& mesh, JobSystem& jobs);
+
+//Removes the instances whose bounding sphere lies behind the occluders from visible, which usually holds the output of cullInstances. The order
+//of the rest is kept. Screen rectangles are grown by a texel, so occluder edges rasterized at pixel centers never hide anything visible.
+//Returns the number of instances left
+size_t cullOccludedInstances(const OcclusionBuffer& buffer, const InstanceBounds& bounds, JobSystem& jobs, std::vector<uint32_t>& visible);
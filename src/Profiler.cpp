@@ -0,0 +1,213 @@
+#include "Profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	//Events kept for export and summaries. When there are more, the older half is dropped
+	constexpr size_t MAX_HISTORY = 1 << 20;
+
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t start, end;
+		uint32_t thread;
+	};
+
+	//Single producer ring. The owning thread writes an event and then publishes it by advancing written, the collecting thread reads everything up to written
+	struct ThreadRing
+	{
+		uint32_t thread = 0;
+		//Cleared when the owning thread exits, the next thread without a ring takes it over along with its trace thread number
+		bool owned = false;
+		std::atomic<uint64_t> written{ 0 };
+		uint64_t read = 0;
+		ProfileEvent events[PROFILER_RING_SIZE];
+	};
+
+	std::mutex ringMutex;
+	std::vector<std::unique_ptr<ThreadRing>> rings;
+
+	//Gives the ring of a thread back when the thread exits, so threads that come and go, like the workers of short lived job systems, don't add a ring each.
+	//Events the thread left in the ring are still collected
+	struct RingOwner
+	{
+		ThreadRing* ring = nullptr;
+
+		~RingOwner()
+		{
+			if (!ring)
+				return;
+			std::lock_guard<std::mutex> lock(ringMutex);
+			ring->owned = false;
+		}
+	};
+	thread_local RingOwner threadRing;
+
+	std::vector<ProfileEvent> history;
+	void (*frameCallback)() = nullptr;
+
+	ThreadRing& getThreadRing()
+	{
+		if (!threadRing.ring)
+		{
+			std::lock_guard<std::mutex> lock(ringMutex);
+			for (std::unique_ptr<ThreadRing>& ring : rings)
+			{
+				if (!ring->owned)
+				{
+					threadRing.ring = ring.get();
+					break;
+				}
+			}
+			if (!threadRing.ring)
+			{
+				rings.push_back(std::make_unique<ThreadRing>());
+				threadRing.ring = rings.back().get();
+				threadRing.ring->thread = (uint32_t)rings.size();
+			}
+			threadRing.ring->owned = true;
+		}
+		return *threadRing.ring;
+	}
+
+	void addHistory(const ProfileEvent& event)
+	{
+		if (history.size() >= MAX_HISTORY)
+			history.erase(history.begin(), history.begin() + MAX_HISTORY / 2);
+		history.push_back(event);
+	}
+
+	void collectRing(ThreadRing& ring)
+	{
+		uint64_t written = ring.written.load(std::memory_order_acquire);
+		uint64_t first = std::max(ring.read, written > PROFILER_RING_SIZE ? written - PROFILER_RING_SIZE : 0);
+		std::vector<ProfileEvent> events;
+		events.reserve(written - first);
+		for (uint64_t i = first; i < written; i++)
+			events.push_back(ring.events[i % PROFILER_RING_SIZE]);
+
+		//The owner may have wrapped around onto the oldest entries while they were copied, those are dropped
+		uint64_t overwritten = ring.written.load(std::memory_order_acquire);
+		uint64_t valid = overwritten > PROFILER_RING_SIZE ? overwritten - PROFILER_RING_SIZE : 0;
+		for (uint64_t i = std::max(first, valid); i < written; i++)
+			addHistory(events[i - first]);
+		ring.read = written;
+	}
+
+	//Nearest rank percentile of sorted durations
+	double getPercentile(const std::vector<uint64_t>& sorted, double percentile)
+	{
+		size_t rank = (size_t)std::ceil(percentile / 100.0 * sorted.size());
+		return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1] / 1e6;
+	}
+}
+
+uint64_t getProfilerTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordCpuEvent(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadRing& ring = getThreadRing();
+	uint64_t index = ring.written.load(std::memory_order_relaxed);
+	ring.events[index % PROFILER_RING_SIZE] = { name, start, end, ring.thread };
+	ring.written.store(index + 1, std::memory_order_release);
+}
+
+void addProfilerEvent(const char* name, uint64_t start, uint64_t end, uint32_t thread)
+{
+	addHistory({ name, start, end, thread });
+}
+
+void setProfilerFrameCallback(void (*callback)())
+{
+	frameCallback = callback;
+}
+
+void endProfilerFrame()
+{
+	{
+		std::lock_guard<std::mutex> lock(ringMutex);
+		for (std::unique_ptr<ThreadRing>& ring : rings)
+			collectRing(*ring);
+	}
+	if (frameCallback)
+		frameCallback();
+}
+
+bool exportProfilerTrace(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	uint64_t origin = UINT64_MAX;
+	uint32_t threadCount = 0;
+	for (const ProfileEvent& event : history)
+	{
+		origin = std::min(origin, event.start);
+		threadCount = std::max(threadCount, event.thread + 1);
+	}
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (uint32_t thread = 0; thread < threadCount; thread++)
+	{
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}},\n", thread, thread == PROFILER_GPU_THREAD ? "GPU" : "Thread", thread);
+	}
+	for (size_t i = 0; i < history.size(); i++)
+	{
+		//Trace times are in microseconds
+		const ProfileEvent& event = history[i];
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n", event.name, event.thread,
+			(event.start - origin) / 1e3, (event.end - event.start) / 1e3, i + 1 < history.size() ? "," : "");
+	}
+	fprintf(file, "]}\n");
+	return fclose(file) == 0;
+}
+
+void getProfilerStats(std::vector<ProfileStats>& stats)
+{
+	//CPU and GPU events are kept apart, the same name is used for a draw's submission and its GPU time
+	std::map<std::pair<std::string, bool>, std::vector<uint64_t>> durations;
+	for (const ProfileEvent& event : history)
+		durations[{ event.name, event.thread == PROFILER_GPU_THREAD }].push_back(event.end - event.start);
+
+	stats.clear();
+	for (auto& entry : durations)
+	{
+		std::vector<uint64_t>& sorted = entry.second;
+		std::sort(sorted.begin(), sorted.end());
+		stats.push_back({ entry.first.first, entry.first.second, getPercentile(sorted, 50.0), getPercentile(sorted, 95.0), getPercentile(sorted, 99.0), sorted.size() });
+	}
+}
+
+void printProfilerSummary(std::ostream& out)
+{
+	std::vector<ProfileStats> stats;
+	getProfilerStats(stats);
+	char line[256];
+	for (const ProfileStats& entry : stats)
+	{
+		snprintf(line, sizeof(line), "%-24s %s  p50 %8.3fms  p95 %8.3fms  p99 %8.3fms  (%zu samples)", entry.name.c_str(), entry.gpu ? "GPU" : "CPU",
+			entry.p50, entry.p95, entry.p99, entry.samples);
+		out << line << std::endl;
+	}
+}
+
+void clearProfilerHistory()
+{
+	history.clear();
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+//Instrumentation compiles to nothing when NO_PROFILER is defined
+#ifndef NO_PROFILER
+#define PROFILER_ENABLED
+#endif
+
+#ifdef PROFILER_ENABLED
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Events a thread can record between two collections. When a thread records more, its oldest events are dropped
+constexpr size_t PROFILER_RING_SIZE = 8192;
+
+//Frames the GPU timers of a frame have to finish in before their queries are reused and the results dropped
+constexpr int PROFILER_GPU_LATENCY = 4;
+
+//Nanoseconds from a steady clock
+uint64_t getProfilerTime();
+
+//Writes an event to the ring buffer of the calling thread without locking. name has to outlive the profiler, string literals are expected
+void recordCpuEvent(const char* name, uint64_t start, uint64_t end);
+
+//Times the enclosing scope on the CPU
+struct ProfileScope
+{
+	const char* name;
+	uint64_t start;
+
+	explicit ProfileScope(const char* name) : name(name), start(getProfilerTime()) {}
+	~ProfileScope() { recordCpuEvent(name, start, getProfilerTime()); }
+};
+
+//Trace thread of the GPU timers, CPU threads are numbered from 1
+constexpr uint32_t PROFILER_GPU_THREAD = 0;
+
+//Adds a finished event straight to the collected events. Only for the thread that ends frames
+void addProfilerEvent(const char* name, uint64_t start, uint64_t end, uint32_t thread);
+
+//Sets a function endProfilerFrame calls after collecting the CPU events
+void setProfilerFrameCallback(void (*callback)());
+
+//Ends the frame on the thread that owns the GL context. Collects the events of every thread and reads back the GPU timers of earlier frames
+//whose results are available, never waiting for the ones that aren't
+void endProfilerFrame();
+
+//GPU timers, defined in GpuProfiler.cpp, the only part of the profiler that needs GL, so programs without a GL context can leave it out.
+//Creates the GPU timers. Until this has been called on the thread that owns the GL context GPU timers do nothing, so code using them runs without a GPU
+void initGpuProfiler();
+
+//Starts and ends a GL_TIME_ELAPSED query. Elapsed queries can't nest, so GPU timers have to follow each other
+void beginGpuTimer(const char* name);
+void endGpuTimer();
+
+//Average summed duration in seconds of the GPU timers of the frames read back since the last call, 0 if there were none
+float takeGpuFrameTime();
+
+//Writes the collected events as Chrome trace JSON, viewable in chrome://tracing or Perfetto. Returns false if the file can't be written
+bool exportProfilerTrace(const std::string& path);
+
+//Duration percentiles in milliseconds of one CPU scope or GPU timer
+struct ProfileStats
+{
+	std::string name;
+	bool gpu;
+	double p50, p95, p99;
+	size_t samples;
+};
+
+//Computes the stats of every CPU scope and GPU timer over the collected events, ordered by name with the CPU stats of a name first
+void getProfilerStats(std::vector<ProfileStats>& stats);
+
+//Prints the p50, p95 and p99 duration of every CPU scope and GPU timer over the collected events
+void printProfilerSummary(std::ostream& out);
+
+//Drops the collected events, so later stats and traces only cover what runs after this
+void clearProfilerHistory();
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_BEGIN(name) beginGpuTimer(name)
+#define PROFILE_GPU_END() endGpuTimer()
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_BEGIN(name)
+#define PROFILE_GPU_END()
+
+#endif
@@ -0,0 +1,96 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t vao)
+{
+	return (uint64_t)(pass & 0xF) << 60 | (uint64_t)(program & 0xFFFF) << 44 | (uint64_t)(material & 0xFFFFFF) << 20 | (vao & 0xFFFFF);
+}
+
+void clearRenderQueue(RenderQueue& queue)
+{
+	queue.items.clear();
+	for (std::function<void()>& setup : queue.passSetups)
+		setup = nullptr;
+}
+
+void setPassSetup(RenderQueue& queue, uint32_t pass, std::function<void()> setup)
+{
+	queue.passSetups[pass & 0xF] = std::move(setup);
+}
+
+void addDraw(RenderQueue& queue, uint64_t key, const char* name, const DrawState& state, std::function<void()> draw)
+{
+	queue.items.push_back({ key, name, state, std::move(draw) });
+}
+
+void sortRenderQueue(RenderQueue& queue)
+{
+	size_t count = queue.items.size();
+	queue.order.resize(count);
+	queue.scratch.resize(count);
+	for (size_t i = 0; i < count; i++)
+		queue.order[i] = (uint32_t)i;
+
+	if (count == 0)
+		return;
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t histogram[256] = {};
+		for (const DrawItem& item : queue.items)
+			histogram[(item.key >> shift) & 0xFF]++;
+		if (histogram[(queue.items[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (size_t& bucket : histogram)
+		{
+			size_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+		for (uint32_t index : queue.order)
+			queue.scratch[histogram[(queue.items[index].key >> shift) & 0xFF]++] = index;
+		queue.order.swap(queue.scratch);
+	}
+}
+
+void executeRenderQueue(RenderQueue& queue, GLStateCache& cache)
+{
+	sortRenderQueue(queue);
+	int nextPass = 0;
+	auto runSetupsUpTo = [&queue, &cache, &nextPass](int pass)
+	{
+		for (; nextPass <= pass; nextPass++)
+		{
+			//Clears leave the depth buffer alone while depth writes are off
+			if (queue.passSetups[nextPass])
+			{
+				setDepthMask(cache, true);
+				queue.passSetups[nextPass]();
+			}
+		}
+	};
+
+	for (uint32_t index : queue.order)
+	{
+		const DrawItem& item = queue.items[index];
+		runSetupsUpTo((int)(item.key >> 60));
+		const DrawState& state = item.state;
+		setProgram(cache, state.program);
+		for (int unit = 0; unit < STATE_CACHE_TEXTURE_UNITS; unit++)
+		{
+			if (state.textures[unit])
+				setTexture(cache, unit, state.textureTargets[unit], state.textures[unit]);
+		}
+		setVertexArray(cache, state.vao);
+		setCullFace(cache, state.cullFace);
+		setDepthMask(cache, state.depthWrite);
+		setPolygonMode(cache, state.polygonMode);
+		PROFILE_SCOPE(item.name);
+		PROFILE_GPU_BEGIN(item.name);
+		item.draw();
+		PROFILE_GPU_END();
+	}
+	runSetupsUpTo(MAX_RENDER_PASSES - 1);
+}
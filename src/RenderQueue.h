@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "GLStateCache.h"
+
+//Passes run in increasing order, the pass is the top 4 bits of a sort key
+constexpr int MAX_RENDER_PASSES = 16;
+
+//GL state a draw needs, applied through the state cache before the draw runs. Units whose texture is 0 keep whatever they had bound
+struct DrawState
+{
+	GLuint program = 0;
+	GLuint vao = 0;
+	GLenum textureTargets[STATE_CACHE_TEXTURE_UNITS] = {};
+	GLuint textures[STATE_CACHE_TEXTURE_UNITS] = {};
+	//GL_NONE draws both faces
+	GLenum cullFace = GL_NONE;
+	bool depthWrite = true;
+	GLenum polygonMode = GL_FILL;
+};
+
+//A draw and the key it is sorted by. draw sets the uniforms and issues the draw calls, it must not change the state in DrawState.
+//The name labels the draw's CPU and GPU timers in the profiler
+struct DrawItem
+{
+	uint64_t key;
+	const char* name;
+	DrawState state;
+	std::function<void()> draw;
+};
+
+//Draws collected over a frame, sorted by key so draws sharing a program, material or VAO run back to back
+struct RenderQueue
+{
+	std::vector<DrawItem> items;
+	//Runs before the first draw of its pass, or in its place if the pass has no draws, with depth writes on. Binds the framebuffer, sets the viewport and clears
+	std::function<void()> passSetups[MAX_RENDER_PASSES];
+	std::vector<uint32_t> order, scratch;
+};
+
+//Packs a sort key from high to low bits: pass (4), program (16), material (24) and vao (20). Ids are cut to their bits. There is no depth field,
+//every draw is a whole batch of instances or patches, so draws sharing a state run in the order they were added
+uint64_t makeSortKey(uint32_t pass, uint32_t program, uint32_t material, uint32_t vao);
+
+//Removes all draws and pass setups
+void clearRenderQueue(RenderQueue& queue);
+
+void setPassSetup(RenderQueue& queue, uint32_t pass, std::function<void()> setup);
+
+void addDraw(RenderQueue& queue, uint64_t key, const char* name, const DrawState& state, std::function<void()> draw);
+
+//Orders the draws by key with an LSD radix sort over the key bytes. Bytes that are the same in every key are skipped, and draws with equal keys stay in the order they were added
+void sortRenderQueue(RenderQueue& queue);
+
+//Sorts the queue, then runs the pass setups and the draws in order, setting the state of every draw through the cache. Every draw is timed on the CPU and the GPU
+void executeRenderQueue(RenderQueue& queue, GLStateCache& cache);
@@ -0,0 +1,154 @@
+#include "Scatter.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+	//PCG32 random number generator. Every tile gets its own stream so tiles can be sampled in any order
+	struct Random
+	{
+		uint64_t state;
+
+		uint32_t next()
+		{
+			uint64_t old = state;
+			state = old * 6364136223846793005ull + 1442695040888963407ull;
+			uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+			uint32_t rotation = (uint32_t)(old >> 59);
+			return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+		}
+
+		//Uniform float in [0, 1)
+		float nextFloat()
+		{
+			return (next() >> 8) * (1.f / 16777216.f);
+		}
+	};
+
+	Random seedTile(uint32_t seed, int tileX, int tileZ)
+	{
+		//SplitMix64 finalizer over the seed and the tile coordinates
+		uint64_t z = ((uint64_t)seed << 32) ^ ((uint64_t)(uint32_t)tileX << 16) ^ (uint32_t)tileZ;
+		z += 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		Random random = { z ^ (z >> 31) };
+		random.next();
+		return random;
+	}
+
+	//One cell of the acceptance grid. Cells are small enough to hold at most one instance, x < 0 marks an empty cell
+	struct GridCell
+	{
+		float x = -1.f, y, z, rotation, scale;
+	};
+
+	struct Grid
+	{
+		int size;
+		float cellSize;
+		std::vector<GridCell> cells;
+	};
+
+	//Returns false if an accepted instance lies within minDistance of (x, z)
+	bool isFarEnough(const Grid& grid, int cellX, int cellZ, float x, float z, float minDistanceSquared)
+	{
+		//With cells of minDistance / sqrt(2) anything closer than minDistance is at most two cells away
+		for (int nz = std::max(cellZ - 2, 0); nz <= std::min(cellZ + 2, grid.size - 1); nz++)
+		{
+			for (int nx = std::max(cellX - 2, 0); nx <= std::min(cellX + 2, grid.size - 1); nx++)
+			{
+				const GridCell& cell = grid.cells[nz * grid.size + nx];
+				if (cell.x >= 0.f && (cell.x - x) * (cell.x - x) + (cell.z - z) * (cell.z - z) < minDistanceSquared)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void scatterTile(const ScatterSettings& settings, const std::function<float(float, float)>& height, int tileX, int tileZ, int tileCells, Grid& grid)
+	{
+		float tileSize = tileCells * grid.cellSize;
+		float startX = tileX * tileSize, startZ = tileZ * tileSize;
+		float width = std::min(tileSize, settings.size - startX);
+		float depth = std::min(tileSize, settings.size - startZ);
+		if (width <= 0.f || depth <= 0.f)
+			return;
+
+		Random random = seedTile(settings.seed, tileX, tileZ);
+		float minDistanceSquared = settings.minDistance * settings.minDistance;
+		float minNormalY = std::cos(std::min(settings.maxSlope, 3.1416f));
+		float step = grid.cellSize * 0.5f;
+		size_t candidates = (size_t)std::ceil(width * depth / minDistanceSquared * settings.candidatesPerArea);
+		for (size_t i = 0; i < candidates; i++)
+		{
+			//Every candidate uses the same amount of random numbers, whatever happens to it
+			float x = startX + random.nextFloat() * width;
+			float z = startZ + random.nextFloat() * depth;
+			float density = random.nextFloat() * 255.f;
+			float rotation = random.nextFloat() * 6.2831853f;
+			float scale = settings.minScale + random.nextFloat() * (settings.maxScale - settings.minScale);
+
+			int cellX = std::min((int)(x / grid.cellSize), grid.size - 1);
+			int cellZ = std::min((int)(z / grid.cellSize), grid.size - 1);
+			GridCell& cell = grid.cells[cellZ * grid.size + cellX];
+			if (cell.x >= 0.f || !isFarEnough(grid, cellX, cellZ, x, z, minDistanceSquared))
+				continue;
+			if (settings.densityMask)
+			{
+				int maskX = std::min((int)(x / settings.size * settings.maskWidth), settings.maskWidth - 1);
+				int maskZ = std::min((int)(z / settings.size * settings.maskHeight), settings.maskHeight - 1);
+				if (density >= settings.densityMask[maskZ * settings.maskWidth + maskX])
+					continue;
+			}
+
+			float y = height(x, z);
+			if (y < settings.minHeight || y > settings.maxHeight)
+				continue;
+			//Slope from central differences of the height, kept inside the area
+			float x0 = std::max(x - step, 0.f), x1 = std::min(x + step, std::nextafter(settings.size, 0.f));
+			float z0 = std::max(z - step, 0.f), z1 = std::min(z + step, std::nextafter(settings.size, 0.f));
+			float dx = (height(x1, z) - height(x0, z)) / (x1 - x0);
+			float dz = (height(x, z1) - height(x, z0)) / (z1 - z0);
+			if (1.f / std::sqrt(1.f + dx * dx + dz * dz) < minNormalY)
+				continue;
+
+			cell = { x, y, z, rotation, scale };
+		}
+	}
+}
+
+void scatterInstances(const ScatterSettings& settings, const std::function<float(float, float)>& height, JobSystem& jobs, ScatterInstances& instances)
+{
+	Grid grid;
+	grid.cellSize = settings.minDistance / std::sqrt(2.f);
+	grid.size = std::max((int)std::ceil(settings.size / grid.cellSize), 1);
+	grid.cells.assign((size_t)grid.size * grid.size, GridCell());
+
+	//Tiles are at least three cells wide, so tiles of the same pass are a full tile apart and can never see each other's instances
+	int tileCells = std::max(3, (grid.size + 31) / 32);
+	int tileCount = (grid.size + tileCells - 1) / tileCells;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		int passX = pass & 1, passZ = pass >> 1;
+		int passColumns = (tileCount - passX + 1) / 2, passRows = (tileCount - passZ + 1) / 2;
+		jobs.parallelFor(0, (size_t)passColumns * passRows, 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				scatterTile(settings, height, passX + (int)(i % passColumns) * 2, passZ + (int)(i / passColumns) * 2, tileCells, grid);
+		});
+	}
+
+	//Collecting the grid in cell order gives the same output order for any thread count
+	instances = ScatterInstances();
+	for (const GridCell& cell : grid.cells)
+	{
+		if (cell.x < 0.f)
+			continue;
+		instances.x.push_back(cell.x);
+		instances.y.push_back(cell.y);
+		instances.z.push_back(cell.z);
+		instances.rotation.push_back(cell.rotation);
+		instances.scale.push_back(cell.scale);
+	}
+}
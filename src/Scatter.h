@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "JobSystem.h"
+
+//Controls where and how densely instances are scattered over a square area of [0, size)^2
+struct ScatterSettings
+{
+	uint32_t seed = 1;
+	float size = 1.f;
+	//No two instances are closer than this
+	float minDistance = 1.f;
+	//Darts thrown per area of minDistance^2. Higher values fill the area closer to the maximum Poisson-disk density
+	float candidatesPerArea = 4.f;
+	//Instances are rejected where the surface is steeper than maxSlope (in radians) or its height is outside of [minHeight, maxHeight]
+	float maxSlope = 3.1416f;
+	float minHeight = -1e30f, maxHeight = 1e30f;
+	float minScale = 1.f, maxScale = 1.f;
+	//Optional 8 bit mask covering the whole area. A value of 255 keeps every candidate, 0 rejects all of them
+	const uint8_t* densityMask = nullptr;
+	int maskWidth = 0, maskHeight = 0;
+};
+
+//Scattered instances in structure of arrays layout. rotation is around the y axis in radians
+struct ScatterInstances
+{
+	std::vector<float> x, y, z, rotation, scale;
+};
+
+//Scatters instances with Poisson-disk (blue noise) sampling over a background acceptance grid. height(x, z) gives the surface height and must be safe to call from several threads.
+//Tiles are sampled in parallel in four passes so tiles that run at the same time never touch, which makes the output depend only on the settings, not on the thread count
+void scatterInstances(const ScatterSettings& settings, const std::function<float(float, float)>& height, JobSystem& jobs, ScatterInstances& instances);
@@ -0,0 +1,291 @@
+#include "ShaderProgram.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <SFML/System.hpp>
+
+static_assert(sizeof(FrameData) == (2 + MAX_SHADOW_CASCADES) * 64 + 3 * 16, "FrameData has to match the std140 layout of the FrameData block");
+
+namespace
+{
+	bool readTextFile(const std::string& path, std::string& text)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+			return false;
+		std::stringstream ss;
+		ss << file.rdbuf();
+		text = ss.str();
+		return true;
+	}
+
+	//64 bit FNV-1a. Every part is followed by a zero byte so moving text from one part to the next changes the hash
+	void hashString(uint64_t& hash, const char* text)
+	{
+		for (const char* c = text; *c; c++)
+			hash = (hash ^ (uint8_t)*c) * 0x100000001B3ull;
+		hash *= 0x100000001B3ull;
+	}
+
+	const char* getDriverString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value ? (const char*)value : "";
+	}
+
+	//Compiles a shader with the defines inserted after the #version line. Returns 0 and prints the log if compiling failed
+	GLuint compileShader(const std::string& path, const std::string& text, GLenum type, const std::string& defines)
+	{
+		std::string lines = text;
+		size_t versionEnd = lines.find('\n');
+		lines.insert(versionEnd == std::string::npos ? lines.size() : versionEnd + 1, defines);
+		const char* raw_shader = lines.c_str();
+
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &raw_shader, NULL);
+		glCompileShader(shader);
+
+		char infoLog[512];
+		int success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cout << "Failed to compile " << path << ": " << infoLog << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	bool checkLinkStatus(GLuint program, const std::string& name)
+	{
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success)
+			return true;
+		GLint logLength;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> infoLog(std::max(logLength, 1));
+		glGetProgramInfoLog(program, (GLsizei)infoLog.size(), NULL, &infoLog[0]);
+		std::cout << "Failed to link " << name << ": " << &infoLog[0] << std::endl;
+		return false;
+	}
+
+	//Reads every active uniform outside of a block and every uniform block. Uniforms inside blocks report location -1 and are set through the block instead
+	void reflectProgram(ShaderProgram& program)
+	{
+		program.uniforms.clear();
+		GLint count, maxLength;
+		glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<char> name(std::max(maxLength, 1));
+		for (GLint i = 0; i < count; i++)
+		{
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(program.id, i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+			GLint location = glGetUniformLocation(program.id, &name[0]);
+			if (location < 0)
+				continue;
+			std::string uniform = &name[0];
+			size_t bracket = uniform.find('[');
+			program.uniforms[uniform.substr(0, bracket)] = location;
+		}
+
+		program.blocks.clear();
+		glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+		name.resize(std::max(maxLength, 1));
+		for (GLint i = 0; i < count; i++)
+		{
+			glGetActiveUniformBlockName(program.id, i, (GLsizei)name.size(), NULL, &name[0]);
+			program.blocks[&name[0]] = i;
+		}
+
+		auto frameBlock = program.blocks.find("FrameData");
+		if (frameBlock != program.blocks.end())
+			glUniformBlockBinding(program.id, frameBlock->second, FRAME_DATA_BINDING);
+	}
+
+	bool supportsProgramBinary()
+	{
+		if (!GLEW_ARB_get_program_binary)
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	//Creates a program from a cached binary. Returns 0 if there is no cache, it was made for other sources or another driver, or the driver rejects it
+	GLuint loadProgramBinary(const std::string& path, uint64_t key)
+	{
+		MappedFile file;
+		if (!file.open(path.c_str()) || file.size() < sizeof(ProgramBinaryHeader))
+			return 0;
+		ProgramBinaryHeader header;
+		memcpy(&header, file.data(), sizeof(header));
+		if (memcmp(header.magic, "BPRG", 4) != 0 || header.version != PROGRAM_BINARY_VERSION || header.key != key || file.size() - sizeof(header) < header.length)
+			return 0;
+
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.format, file.data() + sizeof(header), header.length);
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void saveProgramBinary(const std::string& path, uint64_t key, GLuint program)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> buffer(sizeof(ProgramBinaryHeader) + length);
+		ProgramBinaryHeader header;
+		memcpy(header.magic, "BPRG", 4);
+		header.version = PROGRAM_BINARY_VERSION;
+		header.key = key;
+		GLenum format;
+		glGetProgramBinary(program, length, NULL, &format, &buffer[sizeof(header)]);
+		header.format = format;
+		header.length = (uint32_t)length;
+		memcpy(&buffer[0], &header, sizeof(header));
+		if (!writeFile(path, buffer))
+			std::cout << "Failed to write program cache: " << path << std::endl;
+	}
+
+	//Builds the program described by the sources and defines of program into program.id, using the binary cache when possible
+	bool buildShaderProgram(ShaderProgram& program)
+	{
+		sf::Clock clock;
+		std::string name = program.vertexSource + " + " + program.fragmentSource;
+		std::string vertexText, fragmentText;
+		if (!readTextFile(program.vertexSource, vertexText) || !readTextFile(program.fragmentSource, fragmentText))
+		{
+			std::cout << "Failed to read " << name << std::endl;
+			return false;
+		}
+
+		bool binaries = supportsProgramBinary();
+		uint64_t key = 0xCBF29CE484222325ull;
+		for (const std::string* part : { &vertexText, &fragmentText, &program.vertexDefines, &program.fragmentDefines })
+			hashString(key, part->c_str());
+		for (GLenum driver : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+			hashString(key, getDriverString(driver));
+		std::string cachePath = program.vertexSource + ".bprog";
+
+		program.id = binaries ? loadProgramBinary(cachePath, key) : 0;
+		if (program.id)
+		{
+			reflectProgram(program);
+			std::cout << "Loaded " << name << " from " << cachePath << " in " << clock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+			return true;
+		}
+
+		GLuint vertexShader = compileShader(program.vertexSource, vertexText, GL_VERTEX_SHADER, program.vertexDefines);
+		GLuint fragmentShader = compileShader(program.fragmentSource, fragmentText, GL_FRAGMENT_SHADER, program.fragmentDefines);
+		if (!vertexShader || !fragmentShader)
+		{
+			glDeleteShader(vertexShader);
+			glDeleteShader(fragmentShader);
+			return false;
+		}
+
+		program.id = glCreateProgram();
+		if (binaries)
+			glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glAttachShader(program.id, vertexShader);
+		glAttachShader(program.id, fragmentShader);
+		glLinkProgram(program.id);
+		glDetachShader(program.id, vertexShader);
+		glDetachShader(program.id, fragmentShader);
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		if (!checkLinkStatus(program.id, name))
+		{
+			glDeleteProgram(program.id);
+			program.id = 0;
+			return false;
+		}
+
+		reflectProgram(program);
+		if (binaries)
+			saveProgramBinary(cachePath, key, program.id);
+		std::cout << "Compiled " << name << " in " << clock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+		return true;
+	}
+}
+
+bool loadShaderProgram(ShaderProgram& program, const std::string& vertexSource, const std::string& fragmentSource, const std::string& vertexDefines, const std::string& fragmentDefines)
+{
+	program.vertexSource = vertexSource;
+	program.fragmentSource = fragmentSource;
+	program.vertexDefines = vertexDefines;
+	program.fragmentDefines = fragmentDefines;
+	getSourceStamp(vertexSource.c_str(), program.vertexStamp);
+	getSourceStamp(fragmentSource.c_str(), program.fragmentStamp);
+	return buildShaderProgram(program);
+}
+
+bool reloadShaderProgram(ShaderProgram& program)
+{
+	SourceStamp vertexStamp, fragmentStamp;
+	if (!getSourceStamp(program.vertexSource.c_str(), vertexStamp) || !getSourceStamp(program.fragmentSource.c_str(), fragmentStamp))
+		return false;
+	if (vertexStamp.size == program.vertexStamp.size && vertexStamp.time == program.vertexStamp.time &&
+		fragmentStamp.size == program.fragmentStamp.size && fragmentStamp.time == program.fragmentStamp.time)
+		return false;
+	program.vertexStamp = vertexStamp;
+	program.fragmentStamp = fragmentStamp;
+
+	ShaderProgram reloaded = program;
+	if (!buildShaderProgram(reloaded))
+		return false;
+	glDeleteProgram(program.id);
+	program = std::move(reloaded);
+	return true;
+}
+
+GLint getUniformLocation(const ShaderProgram& program, const std::string& name)
+{
+	auto uniform = program.uniforms.find(name);
+	return uniform == program.uniforms.end() ? -1 : uniform->second;
+}
+
+GLuint genFrameUniformBuffer()
+{
+	GLuint ubo;
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	return ubo;
+}
+
+void updateFrameUniformBuffer(GLuint ubo, const FrameData& frame)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frame);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool isSoftwareRenderer()
+{
+	std::string renderer = getDriverString(GL_RENDERER);
+	for (const char* name : { "llvmpipe", "softpipe", "SwiftShader", "Software Rasterizer", "GDI Generic" })
+	{
+		if (renderer.find(name) != std::string::npos)
+			return true;
+	}
+	return false;
+}
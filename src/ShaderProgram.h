@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "MeshCache.h"
+#include "ShadowCascades.h"
+
+//Uniform buffer binding point of the FrameData block
+constexpr GLuint FRAME_DATA_BINDING = 0;
+
+constexpr uint32_t PROGRAM_BINARY_VERSION = 1;
+
+//Per frame data shared by every program through the std140 FrameData uniform block. Members are vec4/mat4 sized so the layout matches std140 without padding.
+//The shaders declare the cascade arrays with MAX_SHADOW_CASCADES elements
+struct FrameData
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 lightSpaceTransforms[MAX_SHADOW_CASCADES];
+	//View space depth at which each cascade ends. Cascades past the last one in use end at FLT_MAX
+	glm::vec4 cascadeSplits;
+	glm::vec4 lightDirection;
+	glm::vec4 cameraPos;
+};
+
+//A linked program with the locations of its active uniforms and the indices of its uniform blocks, read once at link time
+struct ShaderProgram
+{
+	GLuint id = 0;
+	std::unordered_map<std::string, GLint> uniforms;
+	std::unordered_map<std::string, GLuint> blocks;
+	//What the program was built from, kept for the binary cache and hot reloading
+	std::string vertexSource, fragmentSource, vertexDefines, fragmentDefines;
+	SourceStamp vertexStamp, fragmentStamp;
+};
+
+//Header of a cached program binary. It is followed by length bytes of binary in the given driver format
+struct ProgramBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+//Builds a program from a vertex and a fragment shader file. The defines are inserted right after the #version line.
+//The linked binary is cached next to the vertex shader (.bprog), keyed by a hash of both sources, the defines and the driver's vendor, renderer and version.
+//A matching binary is loaded instead of compiling, anything else falls back to compiling and rewrites the cache. Returns false and prints the log on failure.
+//The FrameData block, if the program uses it, is bound to FRAME_DATA_BINDING
+bool loadShaderProgram(ShaderProgram& program, const std::string& vertexSource, const std::string& fragmentSource, const std::string& vertexDefines = "", const std::string& fragmentDefines = "");
+
+//Rebuilds the program if one of its source files changed since it was last built. Returns true if the program was replaced, which resets all of its
+//uniforms. If the new sources fail to build the old program is kept and the same sources aren't tried again
+bool reloadShaderProgram(ShaderProgram& program);
+
+//Location of a uniform from the table, -1 if the program has no active uniform with that name. Arrays are found by their name without [0]
+GLint getUniformLocation(const ShaderProgram& program, const std::string& name);
+
+//True if the context renders on the CPU, where shaders are better off without branches that only save texture fetches
+bool isSoftwareRenderer();
+
+//Creates the FrameData uniform buffer and binds it to FRAME_DATA_BINDING
+GLuint genFrameUniformBuffer();
+
+//Uploads the frame data with a single buffer update
+void updateFrameUniformBuffer(GLuint ubo, const FrameData& frame);
@@ -2,12 +2,22 @@
 
 layout (location = 0) in vec3 pos;
 
-uniform mat4 proj = mat4(1.f);
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
+
+uniform mat4 model;
 
 out vec2 uv;
 
 void main()
 {
-	gl_Position = proj * vec4(pos, 1.f).xyzw;
+	gl_Position = projection * view * model * vec4(pos, 1.f).xyzw;
 	uv = vec2(pos.x, pos.y);
 }
\ No newline at end of file
@@ -1,11 +1,44 @@
 #version 330 core
 
-layout (location = 0) in vec3 pos;
+layout (location = 0) in vec2 gridPos;
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
 
-uniform mat4 lightSpaceTransform;
 uniform mat4 model;
+uniform sampler2D heightMap;
+uniform int samples;
+uniform vec2 patchOrigin;
+uniform float patchSpacing;
+uniform vec2 morphRange;
+uniform int cascade;
+
+//Returns the position of the vertex in terrain space. Odd vertices of a patch slide onto a vertex of the next coarser level
+//as the patch gets close to the end of its LOD range, so switching levels doesn't pop
+vec3 getTerrainPosition()
+{
+	vec2 odd = mod(gridPos, 2.f);
+	ivec2 fine = ivec2(patchOrigin + gridPos * patchSpacing);
+	//Cell centers move along the diagonal the coarser triangles are split by
+	ivec2 coarse = fine + ivec2(vec2(-odd.x, odd.x > 0.f ? odd.y : -odd.y) * patchSpacing);
+	float fineHeight = texelFetch(heightMap, fine, 0).r;
+	float coarseHeight = texelFetch(heightMap, coarse, 0).r;
+
+	vec3 local = vec3(fine.x / float(samples), fineHeight, fine.y / float(samples));
+	float distance = length(vec3(model * vec4(local, 1.f)) - cameraPos.xyz);
+	float morph = clamp((distance - morphRange.x) * morphRange.y, 0.f, 1.f);
+	vec2 xz = mix(vec2(fine), vec2(coarse), morph) / float(samples);
+	return vec3(xz.x, mix(fineHeight, coarseHeight, morph), xz.y);
+}
 
 void main()
 {
-	gl_Position = lightSpaceTransform * model * vec4(pos, 1.f);
+	gl_Position = lightSpaceTransforms[cascade] * model * vec4(getTerrainPosition(), 1.f);
 }
\ No newline at end of file
@@ -1,11 +1,23 @@
 #version 330 core
 
 layout (location = 0) in vec3 pos;
+layout (location = 3) in mat4 instanceModel;
 
-uniform mat4 lightSpaceTransform;
-uniform mat4 models[50];
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
+
+uniform vec3 positionOffset = vec3(0.f);
+uniform vec3 positionScale = vec3(1.f);
+uniform int cascade;
 
 void main()
 {
-	gl_Position = lightSpaceTransform * models[gl_InstanceID] * vec4(pos, 1.f);
+	gl_Position = lightSpaceTransforms[cascade] * instanceModel * vec4(positionOffset + positionScale * pos, 1.f);
 }
\ No newline at end of file
@@ -3,28 +3,51 @@
 in vec3 fragPos;
 in vec2 uv;
 in vec3 fnormal;
-in vec4 fragPosLightSpace;
 
 uniform sampler2D tex;
-uniform sampler2D depthMap;
-uniform vec3 lightDirection;
+uniform sampler2DArray depthMap;
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
 
 out vec4 color;
 
+//Picks the first cascade whose slice of the view frustum reaches the fragment. Splits of unused cascades are huge, so they are never picked
+int getCascade()
+{
+	float depth = -(view * vec4(fragPos, 1.f)).z;
+	int cascade = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (depth > cascadeSplits[i])
+			cascade = i + 1;
+	}
+	return cascade;
+}
+
 float getShadow()
 {
+	int cascade = getCascade();
+	vec4 fragPosLightSpace = lightSpaceTransforms[cascade] * vec4(fragPos, 1.f);
 	vec3 lightSpaceFrag = fragPosLightSpace.xyz / fragPosLightSpace.w;
 	lightSpaceFrag = lightSpaceFrag * 0.5 + 0.5;
 
-    vec2 texelSize = 1.f / textureSize(depthMap, 0);
+    vec2 texelSize = 1.f / textureSize(depthMap, 0).xy;
     float shadow = 0.f;
-    float bias = max(0.005 * (1.f - dot(normalize(fnormal), -normalize(vec3(-11, -5, -11)))), 0.005f);
+    float bias = max(0.005 * (1.f - dot(normalize(fnormal), -normalize(lightDirection.xyz))), 0.005f);
 
     for (int x = -1; x < 1; x++)
     {
         for (int y = -1; y < 1; y++)
         {
-            float pcfDepth = texture(depthMap, lightSpaceFrag.xy + vec2(x, y) * texelSize).r;
+            float pcfDepth = texture(depthMap, vec3(lightSpaceFrag.xy + vec2(x, y) * texelSize, cascade)).r;
             shadow += lightSpaceFrag.z - bias > pcfDepth ? 0.f : 1.f;
         }
     }
@@ -37,7 +60,7 @@ void main()
 	vec3 ambient = vec3(ambientStrength);
 
 	vec3 normal = normalize(fnormal);
-	vec3 lightDir = -normalize(vec3(-11, -5, -11));
+	vec3 lightDir = -normalize(lightDirection.xyz);
 	float diff = max(dot(normal, lightDir), 0.f);
 	vec3 diffuse = vec3(diff);
 
@@ -1,25 +1,50 @@
 #version 330 core
 
-layout (location = 0) in vec3 pos;
+layout (location = 0) in vec3 v_pos;
+#ifdef OCTAHEDRAL_NORMALS
+layout (location = 1) in vec2 v_normal;
+#else
 layout (location = 1) in vec3 v_normal;
+#endif
 layout (location = 2) in vec2 v_uv;
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in mat3 instanceNormal;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
-uniform mat4 lightSpaceTransform;
-uniform mat4 models[50];
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
+
+uniform vec3 positionOffset = vec3(0.f);
+uniform vec3 positionScale = vec3(1.f);
 
 out vec3 fragPos;
 out vec2 uv;
 out vec3 fnormal;
-out vec4 fragPosLightSpace;
+
+//Decodes the normal from the format the mesh was packed with
+vec3 decodeNormal()
+{
+#ifdef OCTAHEDRAL_NORMALS
+	vec3 n = vec3(v_normal, 1.f - abs(v_normal.x) - abs(v_normal.y));
+	if (n.z < 0.f)
+		n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+	return normalize(n);
+#else
+	return v_normal;
+#endif
+}
 
 void main()
 {
-	gl_Position = projection * view * models[gl_InstanceID] * vec4(pos, 1.f);
+	vec3 pos = positionOffset + positionScale * v_pos;
+	gl_Position = projection * view * instanceModel * vec4(pos, 1.f);
 	uv = v_uv;
-	fnormal = mat3(transpose(inverse(models[gl_InstanceID]))) * v_normal;
-	fragPos = vec3(models[gl_InstanceID] * vec4(pos, 1.f));
-	fragPosLightSpace = lightSpaceTransform * vec4(fragPos, 1.f);
+	fnormal = instanceNormal * decodeNormal();
+	fragPos = vec3(instanceModel * vec4(pos, 1.f));
 }
\ No newline at end of file
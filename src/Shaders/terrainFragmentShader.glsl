@@ -3,55 +3,99 @@
 in vec3 fragPos;
 in vec2 uv;
 in vec3 fnormal;
-in vec4 fragPosLightSpace;
 
 out vec4 color;
 
-uniform sampler2D textureMap;
-uniform sampler2D texture_r;
-uniform sampler2D texture_g;
-uniform sampler2D texture_b;
-uniform sampler2D depthMap;
+uniform sampler2DArray materials;
+uniform sampler2DArray splatMap;
+uniform int layerCount;
+uniform sampler2DArray depthMap;
 uniform int terrainSize;
 
+//With SKIP_LIGHT_LAYERS, layers weighted less than one step of the splat map don't change the color, so they aren't sampled
+const float minLayerWeight = 1.f / 255.f;
+
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
+
+//Picks the first cascade whose slice of the view frustum reaches the fragment. Splits of unused cascades are huge, so they are never picked
+int getCascade()
+{
+	float depth = -(view * vec4(fragPos, 1.f)).z;
+	int cascade = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (depth > cascadeSplits[i])
+			cascade = i + 1;
+	}
+	return cascade;
+}
+
 float getShadow()
 {
+	int cascade = getCascade();
+	vec4 fragPosLightSpace = lightSpaceTransforms[cascade] * vec4(fragPos, 1.f);
 	vec3 lightSpaceFrag = fragPosLightSpace.xyz / fragPosLightSpace.w;
 	lightSpaceFrag = lightSpaceFrag * 0.5 + 0.5;
 
-    vec2 texelSize = 1.f / textureSize(depthMap, 0);
+    vec2 texelSize = 1.f / textureSize(depthMap, 0).xy;
     float shadow = 0.f;
-    float bias = max(0.005 * (1.f - dot(normalize(fnormal), -normalize(vec3(-11, -5, -11)))), 0.005f);
+    float bias = max(0.005 * (1.f - dot(normalize(fnormal), -normalize(lightDirection.xyz))), 0.005f);
 
     for (int x = -1; x < 1; x++)
     {
         for (int y = -1; y < 1; y++)
         {
-            float pcfDepth = texture(depthMap, lightSpaceFrag.xy + vec2(x, y) * texelSize).r;
+            float pcfDepth = texture(depthMap, vec3(lightSpaceFrag.xy + vec2(x, y) * texelSize, cascade)).r;
             shadow += lightSpaceFrag.z - bias > pcfDepth ? 0.f : 1.f;
         }
     }
     return shadow / 4.f;
 }
 
+//Blends the detail textures of all layers by their splat weights. Every layer of the splat map holds the weights of four materials
+vec3 getGroundColor()
+{
+    //Implicit derivatives are undefined inside the branches that skip layers, so they are taken up front
+    vec2 detailUV = uv * terrainSize;
+    vec2 uvDx = dFdx(detailUV);
+    vec2 uvDy = dFdy(detailUV);
+    vec3 groundColor = vec3(0.f);
+    for (int slice = 0; slice * 4 < layerCount; slice++)
+    {
+        vec4 weights = texture(splatMap, vec3(uv, slice));
+        for (int channel = 0; channel < 4; channel++)
+        {
+            int layer = slice * 4 + channel;
+#ifdef SKIP_LIGHT_LAYERS
+            if (layer < layerCount && weights[channel] > minLayerWeight)
+#else
+            if (layer < layerCount)
+#endif
+                groundColor += weights[channel] * textureGrad(materials, vec3(detailUV, layer), uvDx, uvDy).rgb;
+        }
+    }
+    return groundColor;
+}
+
 void main()
 {
     float ambientStrength = 0.4;
     vec3 ambient = ambientStrength * vec3(1);
 
     vec3 normal = normalize(fnormal);
-    vec3 lightDir = -normalize(vec3(-11, -5, -11));
+    vec3 lightDir = -normalize(lightDirection.xyz);
     float diff = max(dot(normal, lightDir), 0.0);
     vec3 diffuse = diff * vec3(1);
 
-    vec3 mapRGB = texture(textureMap, uv).rgb;
-    vec3 rTex = texture(texture_r, uv * terrainSize).rgb;
-    vec3 gTex = texture(texture_g, uv * terrainSize).rgb;
-    vec3 bTex = texture(texture_b, uv * terrainSize).rgb;
-    float rPct = mapRGB.r;
-    float gPct = mapRGB.g;
-    float bPct = mapRGB.b;
-    vec3 fragColor = rTex * rPct + gTex * gPct + bTex * bPct;
+    vec3 fragColor = getGroundColor();
 
     vec4 result = vec4(ambient + diffuse * getShadow(), 1.f) * vec4(fragColor, 1.f);
 	color = result;
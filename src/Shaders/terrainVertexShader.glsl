@@ -1,23 +1,63 @@
 #version 330 core
 
-layout (location = 0) in vec3 vpos;
-layout (location = 1) in vec3 vnormal;
+layout (location = 0) in vec2 gridPos;
 
 out vec3 fnormal;
 out vec3 fragPos;
 out vec2 uv;
-out vec4 fragPosLightSpace;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140) uniform FrameData
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceTransforms[4];
+	vec4 cascadeSplits;
+	vec4 lightDirection;
+	vec4 cameraPos;
+};
+
 uniform mat4 model;
-uniform mat4 lightSpaceTransform;
+uniform sampler2D heightMap;
+uniform sampler2D normalMap;
+uniform int samples;
+uniform vec2 patchOrigin;
+uniform float patchSpacing;
+uniform vec2 morphRange;
+
+//Decodes an octahedral normal from the normal map
+vec3 decodeNormal(vec2 encoded)
+{
+	vec3 n = vec3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+	if (n.z < 0.f)
+		n.xy = (1.f - abs(n.yx)) * vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+	return normalize(n);
+}
+
+//Returns the position of the vertex in terrain space. Odd vertices of a patch slide onto a vertex of the next coarser level
+//as the patch gets close to the end of its LOD range, so switching levels doesn't pop
+vec3 getTerrainPosition(out vec3 normal)
+{
+	vec2 odd = mod(gridPos, 2.f);
+	ivec2 fine = ivec2(patchOrigin + gridPos * patchSpacing);
+	//Cell centers move along the diagonal the coarser triangles are split by
+	ivec2 coarse = fine + ivec2(vec2(-odd.x, odd.x > 0.f ? odd.y : -odd.y) * patchSpacing);
+	float fineHeight = texelFetch(heightMap, fine, 0).r;
+	float coarseHeight = texelFetch(heightMap, coarse, 0).r;
+
+	vec3 local = vec3(fine.x / float(samples), fineHeight, fine.y / float(samples));
+	float distance = length(vec3(model * vec4(local, 1.f)) - cameraPos.xyz);
+	float morph = clamp((distance - morphRange.x) * morphRange.y, 0.f, 1.f);
+	normal = normalize(mix(decodeNormal(texelFetch(normalMap, fine, 0).rg), decodeNormal(texelFetch(normalMap, coarse, 0).rg), morph));
+	vec2 xz = mix(vec2(fine), vec2(coarse), morph) / float(samples);
+	return vec3(xz.x, mix(fineHeight, coarseHeight, morph), xz.y);
+}
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(vpos, 1.f);
-	fnormal = mat3(transpose(inverse(model))) * vnormal;
-	fragPos = vec3(model * vec4(vpos, 1.f));
-	uv = vpos.xz;
-	fragPosLightSpace = lightSpaceTransform * vec4(fragPos, 1.f);
+	vec3 normal;
+	vec3 pos = getTerrainPosition(normal);
+	gl_Position = projection * view * model * vec4(pos, 1.f);
+	fnormal = mat3(transpose(inverse(model))) * normal;
+	fragPos = vec3(model * vec4(pos, 1.f));
+	uv = pos.xz;
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "ShadowCache.h"
+#include <algorithm>
+
+namespace
+{
+	void genShadowMap(GLsizei resolution, int layers, GLuint& texture, GLuint* framebuffers)
+	{
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		float border[] = { 1.f, 1.f, 1.f, 1.f };
+		glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		for (int layer = 0; layer < layers; layer++)
+		{
+			glGenFramebuffers(1, &framebuffers[layer]);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[layer]);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+}
+
+void genShadowCache(ShadowCache& cache, GLsizei resolution, int cascadeCount)
+{
+	cache.resolution = resolution;
+	cache.cascadeCount = std::min(std::max(cascadeCount, 1), MAX_SHADOW_CASCADES);
+	genShadowMap(resolution, cache.cascadeCount, cache.staticMap, cache.staticFramebuffers);
+	invalidateShadowCache(cache);
+}
+
+bool isShadowCacheValid(const ShadowCache& cache, int cascade, const glm::mat4& lightTransform, uint32_t staticVersion)
+{
+	const CachedCascade& cached = cache.cascades[cascade];
+	return cached.valid && cached.lightTransform == lightTransform && cached.staticVersion == staticVersion;
+}
+
+void invalidateShadowCache(ShadowCache& cache)
+{
+	for (CachedCascade& cascade : cache.cascades)
+		cascade.valid = false;
+}
+
+void beginStaticShadows(ShadowCache& cache, int cascade, const glm::mat4& lightTransform, uint32_t staticVersion)
+{
+	CachedCascade& cached = cache.cascades[cascade];
+	glBindFramebuffer(GL_FRAMEBUFFER, cache.staticFramebuffers[cascade]);
+	glViewport(0, 0, cache.resolution, cache.resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	cached.lightTransform = lightTransform;
+	cached.staticVersion = staticVersion;
+	cached.valid = true;
+}
+
+void beginDynamicShadows(ShadowCache& cache, int cascade)
+{
+	if (!cache.dynamicMap)
+		genShadowMap(cache.resolution, cache.cascadeCount, cache.dynamicMap, cache.dynamicFramebuffers);
+	//Both maps have the same format, so the copy stays on the GPU
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, cache.staticFramebuffers[cascade]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cache.dynamicFramebuffers[cascade]);
+	glBlitFramebuffer(0, 0, cache.resolution, cache.resolution, 0, 0, cache.resolution, cache.resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, cache.dynamicFramebuffers[cascade]);
+	glViewport(0, 0, cache.resolution, cache.resolution);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "ShadowCascades.h"
+
+//Light and static geometry the static layer of a cascade was rendered with. valid is cleared to force a rebuild
+struct CachedCascade
+{
+	glm::mat4 lightTransform = glm::mat4(1.f);
+	uint32_t staticVersion = 0;
+	bool valid = false;
+};
+
+//Cascaded shadow maps whose static casters are only rendered again when the cascade or the static geometry changes. Moving casters are drawn every frame
+//over a copy of the static maps, so they never touch the cached depth. Both maps are depth array textures with one layer per cascade. The dynamic map
+//stays 0 until the first moving casters are drawn
+struct ShadowCache
+{
+	GLsizei resolution = 0;
+	int cascadeCount = 0;
+	GLuint staticMap = 0, dynamicMap = 0;
+	GLuint staticFramebuffers[MAX_SHADOW_CASCADES] = {}, dynamicFramebuffers[MAX_SHADOW_CASCADES] = {};
+	CachedCascade cascades[MAX_SHADOW_CASCADES];
+};
+
+//Creates the static depth map and a framebuffer for every layer. Lookups outside of the maps read as unshadowed
+void genShadowCache(ShadowCache& cache, GLsizei resolution, int cascadeCount);
+
+//Returns true if the static layer of the cascade holds the casters for this light transform and version of the static geometry
+bool isShadowCacheValid(const ShadowCache& cache, int cascade, const glm::mat4& lightTransform, uint32_t staticVersion);
+
+//Marks every cascade out of date
+void invalidateShadowCache(ShadowCache& cache);
+
+//Binds and clears the static layer of the cascade so its static casters can be rendered into it, and marks it valid for the given light transform and static geometry
+void beginStaticShadows(ShadowCache& cache, int cascade, const glm::mat4& lightTransform, uint32_t staticVersion);
+
+//Copies the static layer of the cascade into the dynamic map and binds it so the moving casters can be rendered over it. The dynamic map is the one to sample afterwards.
+//Creates the dynamic map on the first call
+void beginDynamicShadows(ShadowCache& cache, int cascade);
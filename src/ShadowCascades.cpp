@@ -0,0 +1,87 @@
+#include "ShadowCascades.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+void computeCascadeSplits(float near, float far, int count, float lambda, float* splits)
+{
+	//Logarithmic splits keep the texel to pixel ratio the same in every cascade, but make the first ones tiny when near is small, so they are blended with uniform splits
+	for (int i = 1; i <= count; i++)
+	{
+		float f = i / (float)count;
+		float logSplit = near * std::pow(far / near, f);
+		float uniformSplit = near + (far - near) * f;
+		splits[i - 1] = lambda * logSplit + (1.f - lambda) * uniformSplit;
+	}
+	splits[count - 1] = far;
+}
+
+void fitShadowCascades(const CascadeSettings& settings, const glm::mat4& cameraView, float fovY, float aspect, float near, const glm::vec3& lightDir,
+	const AABB& sceneBounds, ShadowCascade* cascades)
+{
+	float splits[MAX_SHADOW_CASCADES];
+	int count = std::min(std::max(settings.count, 1), MAX_SHADOW_CASCADES);
+	computeCascadeSplits(near, settings.maxDistance, count, settings.splitLambda, splits);
+
+	//Every cascade shares the orientation of the light, only its window into light space moves
+	glm::vec3 direction = glm::normalize(lightDir);
+	glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.f), direction, up);
+
+	//Bounds of the scene in light space. The light looks down -z, so the depth range is set by the corners with the largest and smallest z
+	glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? sceneBounds.max.x : sceneBounds.min.x, (i & 2) ? sceneBounds.max.y : sceneBounds.min.y, (i & 4) ? sceneBounds.max.z : sceneBounds.min.z);
+		glm::vec3 lightCorner = glm::vec3(lightView * glm::vec4(corner, 1.f));
+		sceneMin = glm::min(sceneMin, lightCorner);
+		sceneMax = glm::max(sceneMax, lightCorner);
+	}
+	float sceneHalfSize = std::max(sceneMax.x - sceneMin.x, sceneMax.y - sceneMin.y) / 2.f;
+
+	glm::mat4 inverseView = glm::inverse(cameraView);
+	float tanY = std::tan(fovY / 2.f);
+	float tanX = tanY * aspect;
+	int snapTexels = std::max(1, (int)std::lround(settings.snapFraction * settings.resolution));
+	snapTexels = std::min(snapTexels, settings.resolution / 2);
+	float sliceNear = near;
+	for (int i = 0; i < count; i++)
+	{
+		//Bounding sphere of the slice from its eight corners. The center of the corners lies on the view axis, so the sphere only moves with the camera
+		glm::vec3 corners[8];
+		glm::vec3 center(0.f);
+		for (int c = 0; c < 8; c++)
+		{
+			float depth = (c & 4) ? splits[i] : sliceNear;
+			glm::vec4 viewCorner(((c & 1) ? 1.f : -1.f) * tanX * depth, ((c & 2) ? 1.f : -1.f) * tanY * depth, -depth, 1.f);
+			corners[c] = glm::vec3(inverseView * viewCorner);
+			center += corners[c];
+		}
+		center /= 8.f;
+		float radius = 0.f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+		//Rounding the radius up keeps floating point noise from resizing the cascade as the camera turns
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		//The window is enlarged so a sphere centered anywhere within half a snapping step of the window's center still fits
+		float halfSize = radius * settings.resolution / (settings.resolution - snapTexels);
+		float step = 2.f * halfSize / settings.resolution * snapTexels;
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.f));
+		float x = std::round(lightCenter.x / step) * step;
+		float y = std::round(lightCenter.y / step) * step;
+		//A cascade that would be larger than the scene covers just the scene, which doesn't move either
+		if (halfSize >= sceneHalfSize)
+		{
+			halfSize = sceneHalfSize;
+			x = (sceneMin.x + sceneMax.x) / 2.f;
+			y = (sceneMin.y + sceneMax.y) / 2.f;
+		}
+
+		glm::mat4 lightProjection = glm::ortho(x - halfSize, x + halfSize, y - halfSize, y + halfSize, -sceneMax.z, -sceneMin.z);
+		cascades[i].lightTransform = lightProjection * lightView;
+		cascades[i].splitDepth = splits[i];
+		sliceNear = splits[i];
+	}
+}
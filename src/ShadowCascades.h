@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+//Most cascades the frame data and the shaders have room for
+constexpr int MAX_SHADOW_CASCADES = 4;
+
+//How the view frustum is split into shadow cascades. More cascades and a higher resolution give sharper shadows at the cost of more depth passes and fill
+struct CascadeSettings
+{
+	int count = 4;
+	int resolution = 2048;
+	//Blend between uniform (0) and logarithmic (1) split distances
+	float splitLambda = 0.8f;
+	//Shadows end at this distance from the camera
+	float maxDistance = 150.f;
+	//Cascade origins move in steps of this fraction of their size, so a cached cascade stays valid until the camera has moved that far.
+	//Cascades are enlarged by half a step so their slice is always covered. 0 still snaps them to whole texels
+	float snapFraction = 0.125f;
+};
+
+//Light projection * view of one cascade and the view space depth at which its slice of the view frustum ends
+struct ShadowCascade
+{
+	glm::mat4 lightTransform;
+	float splitDepth;
+};
+
+//Writes the far depth of each cascade to splits, count values from near to far. The last split is far
+void computeCascadeSplits(float near, float far, int count, float lambda, float* splits);
+
+//Fits an orthographic light projection around each slice of the view frustum. A cascade covers the bounding sphere of its slice, so its size doesn't change
+//when the camera turns, and its origin is snapped to whole texels, so the shadows don't shimmer when the camera moves. The depth range covers all of
+//sceneBounds, so casters outside of the view frustum still cast shadows into it. lightDir points from the light into the scene
+void fitShadowCascades(const CascadeSettings& settings, const glm::mat4& cameraView, float fovY, float aspect, float near, const glm::vec3& lightDir,
+	const AABB& sceneBounds, ShadowCascade* cascades);
@@ -0,0 +1,183 @@
+#include "Simulation.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	//Ticks a real time simulation runs back to back to catch up. After longer stalls, like a breakpoint or a dragged window, the rest are dropped
+	const uint64_t MAX_CATCH_UP_TICKS = 5;
+
+	SimulationSnapshot makeInitialSnapshot(const CameraState& initial, uint64_t time)
+	{
+		SimulationSnapshot snapshot;
+		snapshot.previous = snapshot.current = initial;
+		snapshot.time = time;
+		return snapshot;
+	}
+
+	void hashFloats(const float* values, size_t count, uint64_t& hash)
+	{
+		const uint8_t* bytes = (const uint8_t*)values;
+		for (size_t i = 0; i < count * sizeof(float); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+}
+
+SnapshotBuffer::SnapshotBuffer(const SimulationSnapshot& initial)
+{
+	for (SimulationSnapshot& slot : slots)
+		slot = initial;
+	front = 0;
+	middle = 1;
+	back = 2;
+}
+
+SimulationSnapshot& SnapshotBuffer::getBackSlot()
+{
+	return slots[back];
+}
+
+void SnapshotBuffer::publish()
+{
+	//Release makes the writes to the back slot visible to the reader that swaps it in
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+const SimulationSnapshot& SnapshotBuffer::read()
+{
+	if (middle.load(std::memory_order_relaxed) & FRESH)
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+	return slots[front];
+}
+
+uint64_t getSimulationTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CameraState interpolateCamera(const SimulationSnapshot& snapshot, uint64_t time, uint64_t tickLength)
+{
+	float alpha = time <= snapshot.time ? 0.f : std::min((time - snapshot.time) / (float)tickLength, 1.f);
+	CameraState camera;
+	camera.position = glm::mix(snapshot.previous.position, snapshot.current.position, alpha);
+	//Fronts only turn a little per tick, so a normalized lerp is close enough to a slerp
+	glm::vec3 front = glm::mix(snapshot.previous.front, snapshot.current.front, alpha);
+	camera.front = glm::length(front) > 1e-6f ? glm::normalize(front) : snapshot.current.front;
+	return camera;
+}
+
+Simulation::Simulation(float tickTime, bool realTime, const CameraState& initial, InputSource sampleInput, StepFunction step) :
+	snapshots(makeInitialSnapshot(initial, realTime ? getSimulationTime() : 0))
+{
+	this->tickTime = tickTime;
+	this->sampleInput = std::move(sampleInput);
+	this->step = std::move(step);
+	tickLength = (uint64_t)std::llround(tickTime * 1e9);
+	state = initial;
+	stateHash = SimulationSnapshot().stateHash;
+	tick = 0;
+	targetTick = 0;
+	running = true;
+	if (realTime)
+		thread = std::thread(&Simulation::realTimeLoop, this);
+	else
+		thread = std::thread(&Simulation::steppedLoop, this);
+}
+
+Simulation::~Simulation()
+{
+	stop();
+}
+
+void Simulation::advanceTo(uint64_t target)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	targetTick = std::max(targetTick, target);
+	targetCondition.notify_one();
+	tickCondition.wait(lock, [this, target]() { return tick >= target || !running; });
+}
+
+const SimulationSnapshot& Simulation::getSnapshot()
+{
+	return snapshots.read();
+}
+
+void Simulation::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	targetCondition.notify_all();
+	tickCondition.notify_all();
+	if (thread.joinable())
+		thread.join();
+}
+
+float Simulation::getTickTime() const
+{
+	return tickTime;
+}
+
+uint64_t Simulation::getTickLength() const
+{
+	return tickLength;
+}
+
+void Simulation::realTimeLoop()
+{
+	uint64_t next = getSimulationTime() + tickLength;
+	while (running)
+	{
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(next))));
+		uint64_t now = getSimulationTime();
+		if (now < next)
+			continue;
+		uint64_t late = (now - next) / tickLength;
+		if (late > MAX_CATCH_UP_TICKS)
+			next += (late - MAX_CATCH_UP_TICKS) * tickLength;
+		for (; next <= now && running; next += tickLength)
+			runTick(next);
+	}
+}
+
+void Simulation::steppedLoop()
+{
+	//Ticks run under the lock, the thread that asked for them is waiting anyway
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		targetCondition.wait(lock, [this]() { return tick < targetTick || !running; });
+		if (!running)
+			return;
+		while (tick < targetTick)
+			runTick((tick + 1) * tickLength);
+		tickCondition.notify_all();
+	}
+}
+
+void Simulation::runTick(uint64_t time)
+{
+	PROFILE_SCOPE("Simulation tick");
+	uint64_t inputTime = getSimulationTime();
+	CameraInput input = sampleInput(tick);
+	CameraState previous = state;
+	state = step(input, tickTime);
+	tick++;
+	hashFloats(&state.position.x, 3, stateHash);
+	hashFloats(&state.front.x, 3, stateHash);
+
+	SimulationSnapshot& snapshot = snapshots.getBackSlot();
+	snapshot.previous = previous;
+	snapshot.current = state;
+	snapshot.tick = tick;
+	snapshot.time = time;
+	snapshot.inputTime = inputTime;
+	snapshot.stateHash = stateHash;
+	snapshots.publish();
+}
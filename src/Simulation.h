@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <glm/glm.hpp>
+#include "CameraFP.h"
+
+//Camera after a simulation tick, everything the renderer needs to place the view
+struct CameraState
+{
+	glm::vec3 position = glm::vec3(0.f), front = glm::vec3(1.f, 0.f, 0.f);
+};
+
+//Published after every tick. It holds the last two states, so the renderer can interpolate between them without keeping a history of its own
+struct SimulationSnapshot
+{
+	CameraState previous, current;
+	uint64_t tick = 0;
+	//Time current belongs to on the simulation's clock in nanoseconds, previous belongs to one tick earlier
+	uint64_t time = 0;
+	//Steady clock time the input that produced current was sampled at, in nanoseconds. Input to photon latency is measured from here
+	uint64_t inputTime = 0;
+	//FNV-1a hash of the states of every tick so far. Runs fed the same input get the same hash whatever their frame rate
+	uint64_t stateHash = 0xcbf29ce484222325ull;
+};
+
+//Lock-free triple buffer for one writer and one reader thread. The writer fills its back slot and swaps it with the middle one, the reader swaps
+//its front slot with the middle one when that holds something newer. Neither side ever waits and the reader always sees a whole snapshot
+class SnapshotBuffer
+{
+public:
+	explicit SnapshotBuffer(const SimulationSnapshot& initial);
+
+	//Writer side: fill the back slot, then publish it
+	SimulationSnapshot& getBackSlot();
+	void publish();
+	//Reader side: the latest published snapshot. The reference stays valid until the next call
+	const SimulationSnapshot& read();
+
+private:
+	//Set in middle while it holds a snapshot the reader hasn't taken yet
+	static constexpr uint8_t FRESH = 4;
+
+	SimulationSnapshot slots[3];
+	std::atomic<uint8_t> middle;
+	uint8_t back, front;
+};
+
+//Nanoseconds from the steady clock, the clock of real time simulations and of input times
+uint64_t getSimulationTime();
+
+//Camera between the two states of a snapshot at the given time on the simulation's clock. Times past current are clamped to it
+CameraState interpolateCamera(const SimulationSnapshot& snapshot, uint64_t time, uint64_t tickLength);
+
+//Runs the camera's update at a fixed rate on its own thread, so movement and physics don't depend on the frame rate. Real time simulations tick on
+//the steady clock, stepped ones only tick when advanceTo asks, on a clock where tick n is at n tick lengths, which takes timing out of them altogether
+class Simulation
+{
+public:
+	//Returns the input of the given tick. Called on the simulation thread
+	typedef std::function<CameraInput(uint64_t tick)> InputSource;
+	//Advances the simulated state by dt seconds and returns the camera. Called on the simulation thread
+	typedef std::function<CameraState(const CameraInput& input, float dt)> StepFunction;
+
+	Simulation(float tickTime, bool realTime, const CameraState& initial, InputSource sampleInput, StepFunction step);
+	~Simulation();
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	//Stepped simulations only. Runs every tick up to the given one and waits until it has been published
+	void advanceTo(uint64_t tick);
+	//Latest snapshot. Only for the one thread that renders, the reference stays valid until its next call
+	const SimulationSnapshot& getSnapshot();
+	//Stops and joins the simulation thread. Whatever the callbacks write can be read after this
+	void stop();
+
+	float getTickTime() const;
+	uint64_t getTickLength() const;
+
+private:
+	void realTimeLoop();
+	void steppedLoop();
+	void runTick(uint64_t time);
+
+	float tickTime;
+	uint64_t tickLength;
+	InputSource sampleInput;
+	StepFunction step;
+	SnapshotBuffer snapshots;
+	//Owned by the simulation thread
+	CameraState state;
+	uint64_t stateHash;
+	//Ticks run so far and ticks asked for, guarded by mutex in stepped simulations
+	uint64_t tick, targetTick;
+	std::atomic<bool> running;
+	std::mutex mutex;
+	std::condition_variable targetCondition, tickCondition;
+	std::thread thread;
+};
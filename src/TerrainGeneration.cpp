@@ -0,0 +1,52 @@
+#include "TerrainGeneration.h"
+#include "VertexFormat.h"
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace
+{
+	const size_t ROWS_PER_JOB = 16;
+}
+
+float getTerrainHeight(const HeightMapImage& image, float xpos, float zpos)
+{
+	const uint8_t* pixel = &image.pixels[((size_t)(unsigned)(zpos * (image.height - 1)) * image.width + (unsigned)(xpos * (image.width - 1))) * 4];
+	float value = (pixel[0] + pixel[1] + pixel[2]) / 256.f;
+	return value * 3.f;
+}
+
+void generateTerrainHeights(const HeightMapImage& image, int samples, JobSystem& jobs, std::vector<float>& heights)
+{
+	int rowLength = samples + 1;
+	heights.resize(rowLength * rowLength);
+	jobs.parallelFor(0, rowLength, ROWS_PER_JOB, [&](size_t firstRow, size_t lastRow)
+	{
+		for (size_t z = firstRow; z < lastRow; z++)
+		{
+			for (int x = 0; x <= samples; x++)
+				heights[z * rowLength + x] = getTerrainHeight(image, x / (float)samples, z / (float)samples);
+		}
+	});
+}
+
+void generateTerrainNormals(const float* heights, int samples, JobSystem& jobs, std::vector<int16_t>& normals)
+{
+	int rowLength = samples + 1;
+	normals.resize(rowLength * rowLength * 2);
+	float d = 1.f / samples;
+	jobs.parallelFor(0, rowLength, ROWS_PER_JOB, [&](size_t firstRow, size_t lastRow)
+	{
+		for (int z = (int)firstRow; z < (int)lastRow; z++)
+		{
+			int zPrev = std::max(z - 1, 0), zNext = std::min(z + 1, samples);
+			for (int x = 0; x <= samples; x++)
+			{
+				int xPrev = std::max(x - 1, 0), xNext = std::min(x + 1, samples);
+				float dx = (heights[z * rowLength + xNext] - heights[z * rowLength + xPrev]) / ((xNext - xPrev) * d);
+				float dz = (heights[zNext * rowLength + x] - heights[zPrev * rowLength + x]) / ((zNext - zPrev) * d);
+				glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.f, -dz));
+				encodeOctahedral({ normal.x, normal.y, normal.z }, &normals[(z * rowLength + x) * 2]);
+			}
+		}
+	});
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "JobSystem.h"
+
+//View of the RGBA8 image the terrain heights are read from
+struct HeightMapImage
+{
+	const uint8_t* pixels;
+	int width, height;
+};
+
+//Returns the height of the height map at x and z in [0, 1], read from the nearest pixel towards the origin. Heights are the sum of the color channels, scaled to [0, 3)
+float getTerrainHeight(const HeightMapImage& image, float xpos, float zpos);
+
+//Samples (samples + 1)^2 heights from the height map. Rows are split into bands that are processed in parallel, and every band writes to its own part of
+//the output so the result doesn't depend on the thread count
+void generateTerrainHeights(const HeightMapImage& image, int samples, JobSystem& jobs, std::vector<float>& heights);
+
+//Smooth octahedral normals of a height grid from central differences, falling back to one sided differences at the edges. Two values per sample,
+//computed in parallel bands like the heights
+void generateTerrainNormals(const float* heights, int samples, JobSystem& jobs, std::vector<int16_t>& normals);
@@ -0,0 +1,234 @@
+#include "TerrainLOD.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace
+{
+	//Fraction of a level's range after which its vertices start to morph into the next level
+	constexpr float MORPH_START_RATIO = 0.66f;
+
+	int buildNode(const float* heights, int samples, int x, int z, int size, int level, std::vector<TerrainNode>& nodes)
+	{
+		int index = (int)nodes.size();
+		nodes.push_back({ x, z, size, level, FLT_MAX, -FLT_MAX, { -1, -1, -1, -1 } });
+		float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+		if (level == 0)
+		{
+			for (int sz = z; sz <= z + size; sz++)
+			{
+				for (int sx = x; sx <= x + size; sx++)
+				{
+					minHeight = std::min(minHeight, heights[sz * (samples + 1) + sx]);
+					maxHeight = std::max(maxHeight, heights[sz * (samples + 1) + sx]);
+				}
+			}
+		}
+		else
+		{
+			int half = size / 2;
+			for (int i = 0; i < 4; i++)
+			{
+				int child = buildNode(heights, samples, x + (i & 1) * half, z + (i >> 1) * half, half, level - 1, nodes);
+				nodes[index].children[i] = child;
+				minHeight = std::min(minHeight, nodes[child].minHeight);
+				maxHeight = std::max(maxHeight, nodes[child].maxHeight);
+			}
+		}
+		nodes[index].minHeight = minHeight;
+		nodes[index].maxHeight = maxHeight;
+		return index;
+	}
+
+	//Largest difference between the height samples and the triangles of a grid with the given spacing. The triangles are split along the same diagonal as the patch strips
+	float getGridError(const float* heights, int samples, int spacing)
+	{
+		int stride = samples + 1;
+		float error = 0.f;
+		for (int z = 0; z <= samples; z++)
+		{
+			int z0 = std::min(z / spacing, samples / spacing - 1) * spacing;
+			float fz = (z - z0) / (float)spacing;
+			for (int x = 0; x <= samples; x++)
+			{
+				int x0 = std::min(x / spacing, samples / spacing - 1) * spacing;
+				float fx = (x - x0) / (float)spacing;
+				float h00 = heights[z0 * stride + x0];
+				float h10 = heights[z0 * stride + x0 + spacing];
+				float h01 = heights[(z0 + spacing) * stride + x0];
+				float h11 = heights[(z0 + spacing) * stride + x0 + spacing];
+				float coarse = fx + fz < 1.f ? h00 + fx * (h10 - h00) + fz * (h01 - h00) : h11 + (1.f - fx) * (h01 - h11) + (1.f - fz) * (h10 - h11);
+				error = std::max(error, std::fabs(heights[z * stride + x] - coarse));
+			}
+		}
+		return error;
+	}
+
+	AABB getNodeBox(const TerrainLOD& lod, const TerrainNode& node)
+	{
+		float scale = lod.size / lod.samples;
+		return { glm::vec3(node.x * scale, node.minHeight, node.z * scale), glm::vec3((node.x + node.size) * scale, node.maxHeight, (node.z + node.size) * scale) };
+	}
+
+	void addPatch(const TerrainNode& node, uint32_t quadrantMask, TerrainDrawList& drawList)
+	{
+		drawList.patches.push_back({ node.x, node.z, node.size, node.level, quadrantMask });
+		for (int i = 0; i < 4; i++)
+		{
+			if (quadrantMask & (1 << i))
+				drawList.triangleCount += (TERRAIN_PATCH_SIZE / 2) * (TERRAIN_PATCH_SIZE / 2) * 2;
+		}
+	}
+
+	//Returns false if the node is out of the range of its level, in which case its parent has to cover its area
+	bool selectNode(const TerrainLOD& lod, int index, const glm::vec3& cameraPosition, const Frustum& frustum, TerrainDrawList& drawList)
+	{
+		const TerrainNode& node = lod.nodes[index];
+		AABB box = getNodeBox(lod, node);
+		if (!intersectsSphere(box, cameraPosition, lod.ranges[node.level]))
+			return false;
+		if (!intersectsFrustum(frustum, box))
+			return true;
+		if (node.level == 0 || !intersectsSphere(box, cameraPosition, lod.ranges[node.level - 1]))
+		{
+			addPatch(node, 0xF, drawList);
+			return true;
+		}
+
+		//Quadrants whose children are too far away for the finer level are drawn at this level instead
+		uint32_t quadrantMask = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (!selectNode(lod, node.children[i], cameraPosition, frustum, drawList))
+				quadrantMask |= 1 << i;
+		}
+		if (quadrantMask)
+			addPatch(node, quadrantMask, drawList);
+		return true;
+	}
+
+	void selectFullResolutionNode(const TerrainLOD& lod, int index, const Frustum& frustum, TerrainDrawList& drawList)
+	{
+		const TerrainNode& node = lod.nodes[index];
+		if (!intersectsFrustum(frustum, getNodeBox(lod, node)))
+			return;
+		if (node.level == 0)
+		{
+			addPatch(node, 0xF, drawList);
+			return;
+		}
+		for (int child : node.children)
+			selectFullResolutionNode(lod, child, frustum, drawList);
+	}
+}
+
+void buildTerrainLOD(const float* heights, int samples, float size, TerrainLOD& lod)
+{
+	lod.samples = samples;
+	lod.size = size;
+	lod.nodes.clear();
+	lod.roots.clear();
+
+	//Roots are as large as possible while still tiling the terrain exactly
+	int rootSize = TERRAIN_PATCH_SIZE;
+	int levelCount = 1;
+	while (samples % (rootSize * 2) == 0)
+	{
+		rootSize *= 2;
+		levelCount++;
+	}
+	for (int z = 0; z < samples; z += rootSize)
+	{
+		for (int x = 0; x < samples; x += rootSize)
+			lod.roots.push_back(buildNode(heights, samples, x, z, rootSize, levelCount - 1, lod.nodes));
+	}
+
+	lod.levelErrors.assign(levelCount, 0.f);
+	for (int level = 1; level < levelCount; level++)
+		lod.levelErrors[level] = getGridError(heights, samples, 1 << level);
+	lod.ranges.assign(levelCount, FLT_MAX);
+	lod.morphStarts.assign(levelCount, FLT_MAX);
+	lod.morphScales.assign(levelCount, 0.f);
+}
+
+void computeLODRanges(TerrainLOD& lod, float fovY, float viewportHeight, float pixelError)
+{
+	//Distance at which a height error of 1 covers pixelError pixels
+	float distancePerError = viewportHeight / (2.f * std::tan(fovY / 2.f) * pixelError);
+	float heightRange = 0.f;
+	for (int root : lod.roots)
+		heightRange = std::max(heightRange, lod.nodes[root].maxHeight - lod.nodes[root].minHeight);
+
+	int levelCount = (int)lod.ranges.size();
+	float previousRange = 0.f, previousDiagonal = 0.f;
+	for (int level = 0; level < levelCount; level++)
+	{
+		//Bounds on the distance from a node of this level to the camera once it has been selected
+		float nodeSize = lod.size / lod.samples * (TERRAIN_PATCH_SIZE << level);
+		float diagonal = std::sqrt(2.f * nodeSize * nodeSize + heightRange * heightRange);
+		if (level == levelCount - 1)
+		{
+			lod.ranges[level] = FLT_MAX;
+			lod.morphStarts[level] = FLT_MAX;
+			lod.morphScales[level] = 0.f;
+			break;
+		}
+
+		//A level has to finish morphing before the area drawn by the next level starts, and neighbouring patches may only be one level apart,
+		//so every range has to be at least two node diagonals past the previous one
+		float range = lod.levelErrors[level + 1] * distancePerError;
+		range = std::max(range, std::max(previousRange * 2.f, previousRange + 2.f * previousDiagonal));
+		range = std::max(range, 2.f * diagonal);
+		float morphStart = std::max(range * MORPH_START_RATIO, previousRange + previousDiagonal);
+		lod.ranges[level] = range;
+		lod.morphStarts[level] = morphStart;
+		lod.morphScales[level] = 1.f / (range - morphStart);
+		previousRange = range;
+		previousDiagonal = diagonal;
+	}
+}
+
+void selectTerrainLOD(const TerrainLOD& lod, const glm::vec3& cameraPosition, const Frustum& frustum, TerrainDrawList& drawList)
+{
+	drawList.patches.clear();
+	drawList.triangleCount = 0;
+	for (int root : lod.roots)
+	{
+		if (!selectNode(lod, root, cameraPosition, frustum, drawList) && intersectsFrustum(frustum, getNodeBox(lod, lod.nodes[root])))
+			addPatch(lod.nodes[root], 0xF, drawList);
+	}
+	drawList.morph = true;
+}
+
+void selectTerrainFullResolution(const TerrainLOD& lod, const Frustum& frustum, TerrainDrawList& drawList)
+{
+	drawList.patches.clear();
+	drawList.triangleCount = 0;
+	for (int root : lod.roots)
+		selectFullResolutionNode(lod, root, frustum, drawList);
+	drawList.morph = false;
+}
+
+void genPatchIndices(uint32_t restartIndex, std::vector<uint32_t>& indices, size_t quadrantOffsets[5])
+{
+	int rowLength = TERRAIN_PATCH_SIZE + 1;
+	int half = TERRAIN_PATCH_SIZE / 2;
+	indices.clear();
+	for (int quadrant = 0; quadrant < 4; quadrant++)
+	{
+		quadrantOffsets[quadrant] = indices.size();
+		int startX = (quadrant & 1) * half;
+		int startZ = (quadrant >> 1) * half;
+		for (int z = startZ; z < startZ + half; z++)
+		{
+			//Starting each strip on row z splits every quad along the same diagonal as the collision test
+			for (int x = startX; x <= startX + half; x++)
+			{
+				indices.push_back(z * rowLength + x);
+				indices.push_back((z + 1) * rowLength + x);
+			}
+			indices.push_back(restartIndex);
+		}
+	}
+	quadrantOffsets[4] = indices.size();
+}
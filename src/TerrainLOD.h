@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+//Number of quads along one side of the patch mesh every selected node is drawn with
+constexpr int TERRAIN_PATCH_SIZE = 16;
+
+//Quadtree node covering size x size height samples starting at sample (x, z). Level 0 nodes are drawn at full resolution, every level up halves it
+struct TerrainNode
+{
+	int x, z, size, level;
+	float minHeight, maxHeight;
+	int children[4];
+};
+
+//A node selected for drawing. quadrantMask has bit (qz * 2 + qx) set for every quadrant of the node that is drawn at this level
+struct TerrainPatch
+{
+	int x, z, size, level;
+	uint32_t quadrantMask;
+};
+
+//The patches selected for one view
+struct TerrainDrawList
+{
+	std::vector<TerrainPatch> patches;
+	size_t triangleCount = 0;
+	//False for selections that don't depend on a camera, whose vertices must not morph towards the camera's levels
+	bool morph = true;
+};
+
+//CDLOD quadtree over a height grid of (samples + 1)^2 values. The terrain spans [0, size] along x and z in world space and heights are used as they are
+struct TerrainLOD
+{
+	int samples = 0;
+	float size = 0.f;
+	std::vector<TerrainNode> nodes;
+	std::vector<int> roots;
+	//Largest height difference between the full resolution grid and the grid of each level
+	std::vector<float> levelErrors;
+	//Distance from the camera up to which each level is used. The last level is used at any distance
+	std::vector<float> ranges;
+	//Distance at which vertices of each level start morphing into the next level and 1 / the distance over which they do so
+	std::vector<float> morphStarts, morphScales;
+};
+
+//Builds the quadtree, its bounding boxes and the geometric error of every level. samples must be a multiple of TERRAIN_PATCH_SIZE
+void buildTerrainLOD(const float* heights, int samples, float size, TerrainLOD& lod);
+
+//Picks the range of every level so that its geometric error never covers more than pixelError pixels on a screen of the given height
+void computeLODRanges(TerrainLOD& lod, float fovY, float viewportHeight, float pixelError);
+
+//Selects the patches to draw for a camera at cameraPosition. Nodes outside of the frustum are skipped, but levels are always picked by the distance
+//to cameraPosition so the selection for a light frustum matches the geometry seen by the camera
+void selectTerrainLOD(const TerrainLOD& lod, const glm::vec3& cameraPosition, const Frustum& frustum, TerrainDrawList& drawList);
+
+//Selects every level 0 node inside the frustum. The selection doesn't depend on any camera, which views that are cached over many frames need
+void selectTerrainFullResolution(const TerrainLOD& lod, const Frustum& frustum, TerrainDrawList& drawList);
+
+//Builds strip indices for the (TERRAIN_PATCH_SIZE + 1)^2 vertex patch mesh, one quadrant after the other so any run of quadrants is a single range.
+//quadrantOffsets receives the first index of each quadrant plus the total count
+void genPatchIndices(uint32_t restartIndex, std::vector<uint32_t>& indices, size_t quadrantOffsets[5]);
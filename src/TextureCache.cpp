@@ -0,0 +1,462 @@
+#include "TextureCache.h"
+#include <GL/glew.h>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	const char bakedTextureMagic[4] = { 'B', 'T', 'E', 'X' };
+
+	inline uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	inline float srgbToLinear(uint8_t value)
+	{
+		static const std::vector<float> table = []()
+		{
+			std::vector<float> values(256);
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.f;
+				values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return values;
+		}();
+		return table[value];
+	}
+
+	inline uint8_t linearToSrgb(float value)
+	{
+		value = std::min(std::max(value, 0.f), 1.f);
+		float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+		return (uint8_t)(c * 255.f + 0.5f);
+	}
+
+	inline uint8_t toUnorm8(float value)
+	{
+		return (uint8_t)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+	}
+
+	//Halves an RGBA float image with a box filter. Colors are weighted by alpha. The last texel of an odd row or column also covers the source texel
+	//that has no pair, so every source texel lands in exactly one target texel
+	void downsample(const std::vector<float>& source, uint32_t width, uint32_t height, std::vector<float>& target, uint32_t& targetWidth, uint32_t& targetHeight)
+	{
+		targetWidth = std::max(width / 2, 1u);
+		targetHeight = std::max(height / 2, 1u);
+		target.assign((size_t)targetWidth * targetHeight * 4, 0.f);
+		for (uint32_t y = 0; y < targetHeight; y++)
+		{
+			uint32_t y0 = std::min(y * 2, height - 1), y1 = y + 1 == targetHeight ? height - 1 : y * 2 + 1;
+			for (uint32_t x = 0; x < targetWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, width - 1), x1 = x + 1 == targetWidth ? width - 1 : x * 2 + 1;
+				float color[3] = { 0.f, 0.f, 0.f }, plainColor[3] = { 0.f, 0.f, 0.f }, alpha = 0.f;
+				for (uint32_t sourceY = y0; sourceY <= y1; sourceY++)
+				{
+					for (uint32_t sourceX = x0; sourceX <= x1; sourceX++)
+					{
+						const float* texel = &source[((size_t)sourceY * width + sourceX) * 4];
+						for (int c = 0; c < 3; c++)
+						{
+							color[c] += texel[c] * texel[3];
+							plainColor[c] += texel[c];
+						}
+						alpha += texel[3];
+					}
+				}
+				float weight = 1.f / ((y1 - y0 + 1) * (x1 - x0 + 1));
+				float* out = &target[((size_t)y * targetWidth + x) * 4];
+				for (int c = 0; c < 3; c++)
+					out[c] = alpha > 0.f ? color[c] / alpha : plainColor[c] * weight;
+				out[3] = alpha * weight;
+			}
+		}
+	}
+
+	inline uint16_t packColor565(const float color[3])
+	{
+		int r = (int)(std::min(std::max(color[0], 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		int g = (int)(std::min(std::max(color[1], 0.f), 255.f) * 63.f / 255.f + 0.5f);
+		int b = (int)(std::min(std::max(color[2], 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	inline void unpackColor565(uint16_t packed, float color[3])
+	{
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	//Picks the closest of the four colors of a BC1 block for every texel. Returns the squared error
+	float fitColorIndices(const float texels[16][3], uint16_t color0, uint16_t color1, uint32_t& indices)
+	{
+		float palette[4][3];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+			palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+		}
+
+		float error = 0.f;
+		indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			float bestDistance = FLT_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				float dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+				float distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (i * 2);
+			error += bestDistance;
+		}
+		return error;
+	}
+
+	//Orders the endpoints so the block decodes in four color mode and fits the indices. Returns FLT_MAX if both endpoints are the same color
+	float fitColorBlock(const float texels[16][3], const float end0[3], const float end1[3], uint16_t& color0, uint16_t& color1, uint32_t& indices)
+	{
+		color0 = packColor565(end0);
+		color1 = packColor565(end1);
+		if (color0 == color1)
+			return FLT_MAX;
+		if (color0 < color1)
+			std::swap(color0, color1);
+		return fitColorIndices(texels, color0, color1, indices);
+	}
+
+	//Endpoints along the principal axis of the block's colors, then a least squares refit of the endpoints to the chosen indices
+	void compressColorBlock(const float texels[16][3], uint8_t out[8])
+	{
+		float mean[3] = { 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++)
+				mean[c] += texels[i][c] / 16.f;
+		float covariance[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++)
+		{
+			float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+			covariance[0] += d[0] * d[0];
+			covariance[1] += d[0] * d[1];
+			covariance[2] += d[0] * d[2];
+			covariance[3] += d[1] * d[1];
+			covariance[4] += d[1] * d[2];
+			covariance[5] += d[2] * d[2];
+		}
+		float axis[3] = { 1.f, 1.f, 1.f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = { covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+			float length = std::max(std::max(std::fabs(next[0]), std::fabs(next[1])), std::fabs(next[2]));
+			if (length < 1e-6f)
+				break;
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float projection = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+		float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float end0[3], end1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = mean[c] + axis[c] * maxProjection / axisLength;
+			end1[c] = mean[c] + axis[c] * minProjection / axisLength;
+		}
+
+		uint16_t color0, color1;
+		uint32_t indices = 0;
+		float error = fitColorBlock(texels, end0, end1, color0, color1, indices);
+		if (error == FLT_MAX)
+		{
+			//A single color, every texel uses the first endpoint
+			color0 = color1 = packColor565(mean);
+			indices = 0;
+		}
+		else
+		{
+			for (int iteration = 0; iteration < 2; iteration++)
+			{
+				const float weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+				float aa = 0.f, ab = 0.f, bb = 0.f, ax[3] = { 0.f, 0.f, 0.f }, bx[3] = { 0.f, 0.f, 0.f };
+				for (int i = 0; i < 16; i++)
+				{
+					float a = weights[(indices >> (i * 2)) & 3], b = 1.f - a;
+					aa += a * a;
+					ab += a * b;
+					bb += b * b;
+					for (int c = 0; c < 3; c++)
+					{
+						ax[c] += a * texels[i][c];
+						bx[c] += b * texels[i][c];
+					}
+				}
+				float determinant = aa * bb - ab * ab;
+				if (std::fabs(determinant) < 1e-6f)
+					break;
+				for (int c = 0; c < 3; c++)
+				{
+					end0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+					end1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+				}
+				uint16_t refined0, refined1;
+				uint32_t refinedIndices;
+				float refinedError = fitColorBlock(texels, end0, end1, refined0, refined1, refinedIndices);
+				if (refinedError >= error)
+					break;
+				error = refinedError;
+				color0 = refined0;
+				color1 = refined1;
+				indices = refinedIndices;
+			}
+		}
+
+		out[0] = (uint8_t)color0;
+		out[1] = (uint8_t)(color0 >> 8);
+		out[2] = (uint8_t)color1;
+		out[3] = (uint8_t)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (uint8_t)(indices >> (i * 8));
+	}
+
+	void loadBlockColors(const uint8_t texels[64], float colors[16][3])
+	{
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++)
+				colors[i][c] = texels[i * 4 + c];
+	}
+
+	//Copies a 4x4 block out of an image, repeating the last row and column where the block goes past its edge
+	void loadBlock(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[64])
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+				memcpy(&block[(y * 4 + x) * 4], &pixels[((size_t)sourceY * width + sourceX) * 4], 4);
+			}
+		}
+	}
+
+	uint32_t getInternalFormat(TextureCompression compression, bool srgb)
+	{
+		switch (compression)
+		{
+		case TextureCompression::BC1:
+			return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TextureCompression::BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		default:
+			return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+	}
+
+	//Bytes a level takes in the file, RGBA8 texels or 4x4 blocks
+	uint64_t getLevelBytes(TextureCompression compression, uint32_t width, uint32_t height)
+	{
+		if (compression == TextureCompression::None)
+			return (uint64_t)width * height * 4;
+		return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * (compression == TextureCompression::BC1 ? 8 : 16);
+	}
+
+	uint32_t getLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levelCount = 1;
+		for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+			levelCount++;
+		return levelCount;
+	}
+}
+
+void compressBC1(const uint8_t texels[64], uint8_t out[8])
+{
+	float colors[16][3];
+	loadBlockColors(texels, colors);
+	compressColorBlock(colors, out);
+}
+
+void compressBC3(const uint8_t texels[64], uint8_t out[16])
+{
+	uint8_t minAlpha = 255, maxAlpha = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minAlpha = std::min(minAlpha, texels[i * 4 + 3]);
+		maxAlpha = std::max(maxAlpha, texels[i * 4 + 3]);
+	}
+
+	//With alpha0 > alpha1 the block interpolates six values between the endpoints. A constant block uses the first endpoint only
+	uint64_t indices = 0;
+	if (minAlpha != maxAlpha)
+	{
+		float palette[8] = { (float)maxAlpha, (float)minAlpha };
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha) / 7.f;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			float bestDistance = FLT_MAX;
+			for (int p = 0; p < 8; p++)
+			{
+				float distance = std::fabs(texels[i * 4 + 3] - palette[p]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (uint64_t)best << (i * 3);
+		}
+	}
+	out[0] = maxAlpha;
+	out[1] = minAlpha;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (uint8_t)(indices >> (i * 8));
+	compressBC1(texels, out + 8);
+}
+
+void bakeTexture(const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompression compression, bool srgb, const SourceStamp& stamp, std::vector<char>& out)
+{
+	BakedTextureHeader header = {};
+	memcpy(header.magic, bakedTextureMagic, sizeof(header.magic));
+	header.version = BAKED_TEXTURE_VERSION;
+	header.sourceSize = stamp.size;
+	header.sourceTime = stamp.time;
+	header.width = width;
+	header.height = height;
+	header.requested = compression;
+	header.srgb = srgb;
+	size_t texelCount = (size_t)width * height;
+	if (compression == TextureCompression::Auto)
+	{
+		compression = TextureCompression::BC1;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			if (pixels[i * 4 + 3] != 255)
+			{
+				compression = TextureCompression::BC3;
+				break;
+			}
+		}
+	}
+	header.compression = compression;
+	header.internalFormat = getInternalFormat(compression, srgb);
+	header.levelCount = getLevelCount(width, height);
+
+	std::vector<float> level(texelCount * 4), nextLevel;
+	for (size_t i = 0; i < texelCount * 4; i++)
+		level[i] = (srgb && i % 4 != 3) ? srgbToLinear(pixels[i]) : pixels[i] / 255.f;
+
+	std::vector<BakedTextureLevel> levels(header.levelCount);
+	out.assign(sizeof(BakedTextureHeader) + levels.size() * sizeof(BakedTextureLevel), 0);
+	uint32_t levelWidth = width, levelHeight = height;
+	std::vector<uint8_t> encoded;
+	for (uint32_t l = 0; l < header.levelCount; l++)
+	{
+		if (l > 0)
+		{
+			uint32_t nextWidth, nextHeight;
+			downsample(level, levelWidth, levelHeight, nextLevel, nextWidth, nextHeight);
+			level.swap(nextLevel);
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		encoded.resize((size_t)levelWidth * levelHeight * 4);
+		for (size_t i = 0; i < encoded.size(); i++)
+			encoded[i] = (srgb && i % 4 != 3) ? linearToSrgb(level[i]) : toUnorm8(level[i]);
+
+		BakedTextureLevel& levelInfo = levels[l];
+		levelInfo.width = levelWidth;
+		levelInfo.height = levelHeight;
+		levelInfo.offset = alignOffset(out.size());
+		levelInfo.bytes = getLevelBytes(compression, levelWidth, levelHeight);
+		if (compression == TextureCompression::None)
+		{
+			out.resize(levelInfo.offset + levelInfo.bytes);
+			memcpy(&out[levelInfo.offset], &encoded[0], encoded.size());
+			continue;
+		}
+
+		uint32_t blocksX = (levelWidth + 3) / 4, blocksY = (levelHeight + 3) / 4;
+		size_t blockBytes = compression == TextureCompression::BC1 ? 8 : 16;
+		out.resize(levelInfo.offset + levelInfo.bytes);
+		uint8_t* blocks = (uint8_t*)&out[levelInfo.offset];
+		uint8_t block[64];
+		for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				loadBlock(encoded, levelWidth, levelHeight, blockX, blockY, block);
+				uint8_t* target = blocks + ((size_t)blockY * blocksX + blockX) * blockBytes;
+				if (compression == TextureCompression::BC1)
+					compressBC1(block, target);
+				else
+					compressBC3(block, target);
+			}
+		}
+	}
+
+	memcpy(&out[0], &header, sizeof(header));
+	memcpy(&out[sizeof(header)], &levels[0], levels.size() * sizeof(BakedTextureLevel));
+}
+
+bool readBakedTexture(const char* data, size_t size, const SourceStamp& stamp, TextureCompression compression, bool srgb, BakedTextureView& view)
+{
+	if (!data || size < sizeof(BakedTextureHeader))
+		return false;
+	const BakedTextureHeader* header = (const BakedTextureHeader*)data;
+	if (memcmp(header->magic, bakedTextureMagic, sizeof(header->magic)) || header->version != BAKED_TEXTURE_VERSION)
+		return false;
+	if (header->sourceSize != stamp.size || header->sourceTime != stamp.time)
+		return false;
+	if (header->requested != compression || header->srgb != (uint32_t)srgb)
+		return false;
+
+	//Every level has to be the size the header's dimensions and compression give it, so an upload never reads past the file
+	TextureCompression stored = header->compression;
+	if (stored != TextureCompression::None && stored != TextureCompression::BC1 && stored != TextureCompression::BC3)
+		return false;
+	if ((header->requested != TextureCompression::Auto && stored != header->requested) || header->internalFormat != getInternalFormat(stored, srgb))
+		return false;
+	if (header->width == 0 || header->height == 0 || header->levelCount != getLevelCount(header->width, header->height))
+		return false;
+	if (sizeof(BakedTextureHeader) + (uint64_t)header->levelCount * sizeof(BakedTextureLevel) > size)
+		return false;
+	const BakedTextureLevel* levels = (const BakedTextureLevel*)(data + sizeof(BakedTextureHeader));
+	for (uint32_t l = 0; l < header->levelCount; l++)
+	{
+		const BakedTextureLevel& level = levels[l];
+		if (level.width != std::max(header->width >> l, 1u) || level.height != std::max(header->height >> l, 1u))
+			return false;
+		if (level.bytes != getLevelBytes(stored, level.width, level.height) || level.offset > size || level.bytes > size - level.offset)
+			return false;
+	}
+
+	view.header = header;
+	view.levels = levels;
+	view.data = data;
+	return true;
+}
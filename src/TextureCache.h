@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MeshCache.h"
+
+constexpr uint32_t BAKED_TEXTURE_VERSION = 2;
+
+//How the levels of a baked texture are stored. Auto picks BC1 for opaque images and BC3 for images with alpha
+enum class TextureCompression : uint32_t { None, BC1, BC3, Auto };
+
+//Header at the start of a baked texture file. It is followed by levelCount BakedTextureLevels, level 0 first, and then the 16 byte aligned level data.
+//internalFormat is the GLenum the levels are uploaded with, compressed if compression isn't None
+struct BakedTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t width, height;
+	uint32_t levelCount;
+	TextureCompression requested, compression;
+	uint32_t srgb;
+	uint32_t internalFormat;
+	uint32_t reserved;
+};
+
+struct BakedTextureLevel
+{
+	uint32_t width, height;
+	uint64_t offset, bytes;
+};
+
+//View into a baked texture held in memory. All pointers point into the memory that was passed to readBakedTexture
+struct BakedTextureView
+{
+	const BakedTextureHeader* header = nullptr;
+	const BakedTextureLevel* levels = nullptr;
+	const char* data = nullptr;
+};
+
+//Builds the full mip chain of an RGBA8 image down to 1x1 and serializes it into the baked texture format. sRGB images are filtered in linear space and
+//colors are weighted by alpha, so transparent texels don't bleed into their neighbours
+void bakeTexture(const uint8_t* pixels, uint32_t width, uint32_t height, TextureCompression compression, bool srgb, const SourceStamp& stamp, std::vector<char>& out);
+
+//Validates a baked texture in memory against the source stamp and the requested settings and fills view. Returns false if the data is stale, corrupt or baked differently
+bool readBakedTexture(const char* data, size_t size, const SourceStamp& stamp, TextureCompression compression, bool srgb, BakedTextureView& view);
+
+//Compresses a 4x4 block of RGBA8 texels (row by row) into 8 bytes of BC1. Alpha is ignored
+void compressBC1(const uint8_t texels[64], uint8_t out[8]);
+
+//Compresses a 4x4 block of RGBA8 texels into 16 bytes of BC3
+void compressBC3(const uint8_t texels[64], uint8_t out[16]);
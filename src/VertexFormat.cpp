@@ -0,0 +1,303 @@
+#include "VertexFormat.h"
+#include <GL/glew.h>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	inline int16_t toSnorm16(float value)
+	{
+		return (int16_t)std::lround(std::min(std::max(value, -1.f), 1.f) * 32767.f);
+	}
+
+	inline uint16_t toUnorm16(float value)
+	{
+		return (uint16_t)std::lround(std::min(std::max(value, 0.f), 1.f) * 65535.f);
+	}
+
+	inline float signNotZero(float value)
+	{
+		return value >= 0.f ? 1.f : -1.f;
+	}
+
+	inline Normal normalize(float x, float y, float z)
+	{
+		float length = std::sqrt(x * x + y * y + z * z);
+		if (length == 0.f)
+			return { 0.f, 1.f, 0.f };
+		return { x / length, y / length, z / length };
+	}
+
+	uint32_t getPositionSize(PositionFormat format)
+	{
+		//Half and unorm16 positions are padded to 4 components to keep every attribute 4 byte aligned
+		return format == PositionFormat::Float ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+	}
+
+	uint32_t getNormalSize(NormalFormat format)
+	{
+		switch (format)
+		{
+		case NormalFormat::Octahedral16:
+			return 2 * sizeof(int16_t);
+		case NormalFormat::Int2101010:
+			return sizeof(uint32_t);
+		default:
+			return 3 * sizeof(float);
+		}
+	}
+
+	uint32_t getUVSize(UVFormat format)
+	{
+		return format == UVFormat::Float ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+	}
+}
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (bits >> 16) & 0x8000;
+	uint32_t floatExponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	int exponent = (int)floatExponent - 127 + 15;
+
+	if (floatExponent == 0xFF)
+		return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+	if (exponent >= 31)
+		return sign | 0x7C00;
+	if (exponent <= 0)
+	{
+		//Denormal half, or too small to represent at all
+		if (exponent < -10)
+			return sign;
+		mantissa |= 0x800000;
+		uint32_t shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
+	}
+
+	//A carry out of the mantissa correctly rounds up into the exponent
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return sign | (uint16_t)half;
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		float denormal = mantissa / 16777216.f;
+		return sign ? -denormal : denormal;
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void encodeOctahedral(const Normal& normal, int16_t encoded[2])
+{
+	float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	float u = l1 > 0.f ? normal.x / l1 : 0.f;
+	float v = l1 > 0.f ? normal.y / l1 : 0.f;
+	//The lower hemisphere is folded over the diagonals of the octahedron
+	if (normal.z < 0.f)
+	{
+		float foldedU = (1.f - std::fabs(v)) * signNotZero(u);
+		float foldedV = (1.f - std::fabs(u)) * signNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+	encoded[0] = toSnorm16(u);
+	encoded[1] = toSnorm16(v);
+}
+
+Normal decodeOctahedral(const int16_t encoded[2])
+{
+	float u = std::max(encoded[0] / 32767.f, -1.f);
+	float v = std::max(encoded[1] / 32767.f, -1.f);
+	float z = 1.f - std::fabs(u) - std::fabs(v);
+	if (z < 0.f)
+	{
+		float unfoldedU = (1.f - std::fabs(v)) * signNotZero(u);
+		float unfoldedV = (1.f - std::fabs(u)) * signNotZero(v);
+		u = unfoldedU;
+		v = unfoldedV;
+	}
+	return normalize(u, v, z);
+}
+
+uint32_t encodeInt2101010(const Normal& normal)
+{
+	const float* components = &normal.x;
+	uint32_t packed = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int value = (int)std::lround(std::min(std::max(components[i], -1.f), 1.f) * 511.f);
+		packed |= ((uint32_t)value & 0x3FF) << (i * 10);
+	}
+	return packed;
+}
+
+Normal decodeInt2101010(uint32_t packed)
+{
+	float components[3];
+	for (int i = 0; i < 3; i++)
+	{
+		//Sign extends the 10 bit field
+		int value = (int)(packed << (22 - i * 10)) >> 22;
+		components[i] = std::max(value / 511.f, -1.f);
+	}
+	return normalize(components[0], components[1], components[2]);
+}
+
+uint32_t getVertexStride(const VertexFormat& format, bool hasUVs)
+{
+	return getPositionSize(format.position) + getNormalSize(format.normal) + (hasUVs ? getUVSize(format.uv) : 0);
+}
+
+void setPackedLayout(const VertexFormat& format, bool hasUVs, const float boundsMin[3], const float boundsMax[3], PackedVertices& packed)
+{
+	bool relative = format.position != PositionFormat::Float;
+	for (int i = 0; i < 3; i++)
+	{
+		float extent = boundsMax[i] - boundsMin[i];
+		packed.boundsMin[i] = boundsMin[i];
+		packed.boundsMax[i] = boundsMax[i];
+		packed.positionOffset[i] = relative ? boundsMin[i] : 0.f;
+		packed.positionScale[i] = relative && extent > 0.f ? extent : 1.f;
+	}
+
+	uint32_t positionSize = getPositionSize(format.position);
+	uint32_t normalSize = getNormalSize(format.normal);
+	packed.stride = getVertexStride(format, hasUVs);
+
+	packed.attributes.clear();
+	switch (format.position)
+	{
+	case PositionFormat::Float:
+		packed.attributes.push_back({ 0, 3, GL_FLOAT, GL_FALSE, packed.stride, 0 });
+		break;
+	case PositionFormat::Half:
+		packed.attributes.push_back({ 0, 3, GL_HALF_FLOAT, GL_FALSE, packed.stride, 0 });
+		break;
+	case PositionFormat::Unorm16:
+		packed.attributes.push_back({ 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, packed.stride, 0 });
+		break;
+	}
+	switch (format.normal)
+	{
+	case NormalFormat::Float:
+		packed.attributes.push_back({ 1, 3, GL_FLOAT, GL_FALSE, packed.stride, positionSize });
+		break;
+	case NormalFormat::Octahedral16:
+		packed.attributes.push_back({ 1, 2, GL_SHORT, GL_TRUE, packed.stride, positionSize });
+		break;
+	case NormalFormat::Int2101010:
+		packed.attributes.push_back({ 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, packed.stride, positionSize });
+		break;
+	}
+	if (hasUVs)
+	{
+		GLenum uvType = format.uv == UVFormat::Float ? GL_FLOAT : GL_HALF_FLOAT;
+		packed.attributes.push_back({ 2, 2, uvType, GL_FALSE, packed.stride, positionSize + normalSize });
+	}
+}
+
+void encodeVertices(const VertexFormat& format, const PackedVertices& layout, const Vertex* positions, const Normal* normals, const UV* uvs, size_t count, char* out)
+{
+	uint32_t positionSize = getPositionSize(format.position);
+	uint32_t normalSize = getNormalSize(format.normal);
+	for (size_t v = 0; v < count; v++)
+	{
+		char* vertex = out + v * layout.stride;
+		const float* position = &positions[v].x;
+		if (format.position == PositionFormat::Float)
+			memcpy(vertex, position, positionSize);
+		else
+		{
+			uint16_t encoded[4] = { 0, 0, 0, 0 };
+			for (int i = 0; i < 3; i++)
+			{
+				float local = (position[i] - layout.positionOffset[i]) / layout.positionScale[i];
+				encoded[i] = format.position == PositionFormat::Half ? floatToHalf(local) : toUnorm16(local);
+			}
+			memcpy(vertex, encoded, positionSize);
+		}
+		vertex += positionSize;
+
+		if (format.normal == NormalFormat::Float)
+			memcpy(vertex, &normals[v], normalSize);
+		else if (format.normal == NormalFormat::Octahedral16)
+		{
+			int16_t encoded[2];
+			encodeOctahedral(normals[v], encoded);
+			memcpy(vertex, encoded, normalSize);
+		}
+		else
+		{
+			uint32_t encoded = encodeInt2101010(normals[v]);
+			memcpy(vertex, &encoded, normalSize);
+		}
+		vertex += normalSize;
+
+		if (!uvs)
+			continue;
+		if (format.uv == UVFormat::Float)
+			memcpy(vertex, &uvs[v], sizeof(UV));
+		else
+		{
+			uint16_t encoded[2] = { floatToHalf(uvs[v].u), floatToHalf(uvs[v].v) };
+			memcpy(vertex, encoded, sizeof(encoded));
+		}
+	}
+}
+
+void packVertices(const VertexFormat& format, const Vertex* positions, const Normal* normals, const UV* uvs, size_t count, PackedVertices& packed)
+{
+	float boundsMin[3], boundsMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		boundsMin[i] = count ? FLT_MAX : 0.f;
+		boundsMax[i] = count ? -FLT_MAX : 0.f;
+	}
+	for (size_t v = 0; v < count; v++)
+	{
+		const float* position = &positions[v].x;
+		for (int i = 0; i < 3; i++)
+		{
+			boundsMin[i] = std::min(boundsMin[i], position[i]);
+			boundsMax[i] = std::max(boundsMax[i], position[i]);
+		}
+	}
+
+	setPackedLayout(format, uvs != nullptr, boundsMin, boundsMax, packed);
+	packed.data.assign(count * packed.stride, 0);
+	encodeVertices(format, packed, positions, normals, uvs, count, packed.data.data());
+}
+
+std::string getVertexFormatDefines(const VertexFormat& format)
+{
+	std::string defines;
+	if (format.normal == NormalFormat::Octahedral16)
+		defines += "#define OCTAHEDRAL_NORMALS\n";
+	return defines;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "OBJLoader.h"
+
+enum class PositionFormat : uint32_t { Float, Half, Unorm16 };
+enum class NormalFormat : uint32_t { Float, Octahedral16, Int2101010 };
+enum class UVFormat : uint32_t { Float, Half };
+
+//Selects how each vertex attribute is stored. Half and unorm16 positions are stored relative to the mesh bounds
+struct VertexFormat
+{
+	PositionFormat position = PositionFormat::Float;
+	NormalFormat normal = NormalFormat::Float;
+	UVFormat uv = UVFormat::Float;
+};
+
+//Describes where one vertex attribute lives in a vertex buffer. type is a GLenum
+struct VertexAttribute
+{
+	uint32_t location, components, type, normalized, stride, offset;
+};
+
+//Interleaved vertex data along with what is needed to decode it. position = positionOffset + positionScale * stored position
+struct PackedVertices
+{
+	std::vector<char> data;
+	std::vector<VertexAttribute> attributes;
+	uint32_t stride = 0;
+	float boundsMin[3], boundsMax[3];
+	float positionOffset[3], positionScale[3];
+};
+
+//IEEE half float conversion with round to nearest even
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+//Octahedral normal encoding into two snorm16 values
+void encodeOctahedral(const Normal& normal, int16_t encoded[2]);
+Normal decodeOctahedral(const int16_t encoded[2]);
+
+//Signed normalized 10_10_10_2 normal encoding (GL_INT_2_10_10_10_REV)
+uint32_t encodeInt2101010(const Normal& normal);
+Normal decodeInt2101010(uint32_t packed);
+
+//Returns the size in bytes of a single vertex. uvs are left out if hasUVs is false
+uint32_t getVertexStride(const VertexFormat& format, bool hasUVs);
+
+//Fills in the stride, attributes, bounds and position decode values of packed for vertices within the given bounds. packed.data is left untouched
+void setPackedLayout(const VertexFormat& format, bool hasUVs, const float boundsMin[3], const float boundsMax[3], PackedVertices& packed);
+
+//Encodes count vertices into out with a layout made by setPackedLayout. uvs may only be null if the layout has no uvs
+void encodeVertices(const VertexFormat& format, const PackedVertices& layout, const Vertex* positions, const Normal* normals, const UV* uvs, size_t count, char* out);
+
+//Interleaves and encodes separate position, normal and uv arrays. Attributes go to locations 0, 1 and 2. uvs may be null
+void packVertices(const VertexFormat& format, const Vertex* positions, const Normal* normals, const UV* uvs, size_t count, PackedVertices& packed);
+
+//Returns the #define lines that make the shaders decode the given format
+std::string getVertexFormatDefines(const VertexFormat& format);
@@ -1,14 +1,36 @@
 #include <SFML/Graphics.hpp>
-#include <random>
-#include <time.h>
 #include <GL/glew.h>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <cfloat>
+#include <memory>
+#include <map>
 #include <glm/gtc/matrix_transform.hpp>
 #include "CameraFP.h"
+#include "OBJLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
+#include "VertexFormat.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "TerrainLOD.h"
+#include "TerrainGeneration.h"
+#include "InstanceCulling.h"
+#include "OcclusionCulling.h"
+#include "InstanceTransform.h"
+#include "Scatter.h"
+#include "HeightField.h"
+#include "HeightPyramid.h"
+#include "ShaderProgram.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "ShadowCache.h"
+#include "RenderQueue.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Simulation.h"
 
 constexpr int GLEW_INIT_FAILURE = -1;
+constexpr int BENCHMARK_HASH_MISMATCH = 2;
 const GLfloat quadVertices[] = {
 		1.f, 1.f, 0.f,
 		0.f, 1.f, 0.f,
@@ -18,55 +40,58 @@ const GLfloat quadVertices[] = {
 		1.f, 1.f, 0.f
 };
 sf::Image heightMap;
+//Vertex format shared by the terrain and all models. Shaders are compiled with the matching defines
+const VertexFormat meshFormat = { PositionFormat::Unorm16, NormalFormat::Octahedral16, UVFormat::Half };
 
-//Loads a .glsl file and compiles in into a shader
-GLuint loadShader(const char* source, GLenum type)
+//Texture that holds a 1x1 placeholder until its image has been decoded and uploaded. texture is valid from the start
+struct TextureAsset
 {
-	std::ifstream file;
-	file.open(source);
-	if (!file.is_open())
-		return 0;
-	std::stringstream ss;
-	ss << file.rdbuf();
-	std::string lines = ss.str();
-	const char* raw_shader = lines.c_str();
-
-	GLuint shader = glCreateShader(type);
-	glShaderSource(shader, 1, &raw_shader, NULL);
-	glCompileShader(shader);
-
-	char infoLog[512];
-	int success;
-	glGetShaderiv(type, GL_COMPILE_STATUS, &success);
-	if (!success)
-	{
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << infoLog << std::endl;
-	}
+	GLuint texture = 0;
+	AssetState state = AssetState::Loading;
+};
 
-	return shader;
-}
+//Baked texture decoded on a loader thread. view points into cache when the baked file was mapped, otherwise into baked
+struct TexturePayload
+{
+	MappedFile cache;
+	std::vector<char> baked;
+	BakedTextureView view;
+	bool valid = false;
+};
 
-//Creates a shader program
-GLuint genShaderProgram(GLuint vertexShader, GLuint fragmentShader)
+//Maps the baked texture of an image, or decodes the image and bakes its mip chain next to the source if there is no valid baked texture yet
+bool decodeTexture(const char* source, TextureCompression compression, bool srgb, TexturePayload& payload)
 {
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glLinkProgram(program);
-	glDetachShader(program, vertexShader);
-	glDetachShader(program, fragmentShader);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-	return program;
+	sf::Clock clock;
+	std::string cachePath = std::string(source) + ".btex";
+	SourceStamp stamp;
+	if (!getSourceStamp(source, stamp))
+		return false;
+
+	if (payload.cache.open(cachePath.c_str()) && readBakedTexture(payload.cache.data(), payload.cache.size(), stamp, compression, srgb, payload.view))
+		return true;
+	payload.cache.close();
+
+	sf::Image image;
+	if (!image.loadFromFile(source))
+		return false;
+	bakeTexture(image.getPixelsPtr(), image.getSize().x, image.getSize().y, compression, srgb, stamp, payload.baked);
+	if (!writeFile(cachePath, payload.baked))
+		std::cout << "Failed to write texture cache: " << cachePath << std::endl;
+	readBakedTexture(payload.baked.data(), payload.baked.size(), stamp, compression, srgb, payload.view);
+	std::cout << "Baked " << source << " in " << clock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+	return true;
 }
 
-//Loads an image and generates a texture id
-GLuint loadTexture(const char* source, GLenum colorSpace = GL_SRGB)
+//Creates a texture filled with the placeholder color and queues its baked mip chain to be decoded on a loader thread. The mip chain replaces the placeholder once it is uploaded.
+//Compressed textures fall back to uncompressed ones on drivers without S3TC
+void loadTexture(AssetLoader& loader, TextureAsset& asset, const char* source, sf::Color placeholder, bool srgb = true, TextureCompression compression = TextureCompression::Auto)
 {
-	GLuint texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	if (!GLEW_EXT_texture_compression_s3tc || (srgb && !GLEW_EXT_texture_sRGB))
+		compression = TextureCompression::None;
+
+	glGenTextures(1, &asset.texture);
+	glBindTexture(GL_TEXTURE_2D, asset.texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -74,13 +99,231 @@ GLuint loadTexture(const char* source, GLenum colorSpace = GL_SRGB)
 	float aniso = 0.f;
 	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
-	sf::Image image;
-	if (!image.loadFromFile(source))
-		return -3;
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glTexImage2D(GL_TEXTURE_2D, 0, colorSpace, image.getSize().x, image.getSize().y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.getPixelsPtr());
+	glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	std::shared_ptr<TexturePayload> payload = std::make_shared<TexturePayload>();
+	std::string path = source;
+	TextureAsset* target = &asset;
+	loader.load([payload, path, compression, srgb]() -> size_t
+	{
+		payload->valid = decodeTexture(path.c_str(), compression, srgb, *payload);
+		if (!payload->valid)
+			return 0;
+		size_t bytes = 0;
+		for (uint32_t i = 0; i < payload->view.header->levelCount; i++)
+			bytes += payload->view.levels[i].bytes;
+		return bytes;
+	}, [payload, path, target]()
+	{
+		if (!payload->valid)
+		{
+			std::cout << "Failed to load texture: " << path << std::endl;
+			target->state = AssetState::Failed;
+			return;
+		}
+		//The levels were filtered offline, so they are uploaded as they are instead of being generated by the driver
+		const BakedTextureHeader& header = *payload->view.header;
+		glBindTexture(GL_TEXTURE_2D, target->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levelCount - 1);
+		for (uint32_t i = 0; i < header.levelCount; i++)
+		{
+			const BakedTextureLevel& level = payload->view.levels[i];
+			const char* data = payload->view.data + level.offset;
+			if (header.compression == TextureCompression::None)
+				glTexImage2D(GL_TEXTURE_2D, i, header.internalFormat, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			else
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, header.internalFormat, level.width, level.height, 0, (GLsizei)level.bytes, data);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		target->state = AssetState::Ready;
+	});
+}
+
+//Ground material of the terrain. Its weight is read from one channel of a splat map, so one RGBA splat map holds the weights of four materials
+struct TerrainLayer
+{
+	const char* texture;
+	sf::Color placeholder;
+	const char* weightMap;
+	int weightChannel;
+};
+
+//Ground materials of the terrain as two texture arrays: the detail textures with one layer per material, and the splat weights with four materials per layer.
+//Both hold placeholders until the materials are uploaded, so adding materials never adds binds
+struct TerrainMaterials
+{
+	GLuint layers = 0, weights = 0;
+	int layerCount = 0;
+	AssetState state = AssetState::Loading;
+};
+
+//Terrain materials packed on a loader thread. levels holds every mip level of all the detail textures one after the other, ready for a single upload per level
+struct TerrainMaterialPayload
+{
+	uint32_t width = 0, height = 0;
+	GLenum internalFormat = 0;
+	bool compressed = false;
+	std::vector<std::vector<char>> levels;
+	uint32_t weightWidth = 0, weightHeight = 0;
+	std::vector<uint8_t> weights;
+	bool valid = false;
+};
+
+//Loads the baked detail textures and the splat maps of the layers and packs them into texture array levels. Every layer is cut down to the size of the
+//smallest one by skipping its top mip levels, so they have to be the same size up to a power of two
+bool decodeTerrainMaterials(const std::vector<TerrainLayer>& layers, TextureCompression compression, TerrainMaterialPayload& payload)
+{
+	std::vector<std::unique_ptr<TexturePayload>> textures;
+	for (const TerrainLayer& layer : layers)
+	{
+		textures.emplace_back(new TexturePayload());
+		if (!decodeTexture(layer.texture, compression, true, *textures.back()))
+			return false;
+		const BakedTextureHeader& header = *textures.back()->view.header;
+		if (textures.size() == 1 || header.width < payload.width)
+		{
+			payload.width = header.width;
+			payload.height = header.height;
+		}
+		payload.internalFormat = header.internalFormat;
+		payload.compressed = header.compression != TextureCompression::None;
+	}
+
+	for (const std::unique_ptr<TexturePayload>& texture : textures)
+	{
+		const BakedTextureView& view = texture->view;
+		uint32_t base = 0;
+		while (base < view.header->levelCount && (view.levels[base].width != payload.width || view.levels[base].height != payload.height))
+			base++;
+		if (base == view.header->levelCount || view.header->internalFormat != payload.internalFormat)
+			return false;
+		payload.levels.resize(view.header->levelCount - base);
+		for (uint32_t i = base; i < view.header->levelCount; i++)
+		{
+			const char* data = view.data + view.levels[i].offset;
+			payload.levels[i - base].insert(payload.levels[i - base].end(), data, data + view.levels[i].bytes);
+		}
+	}
+
+	//Splat maps are decoded once each, however many layers read from them
+	std::map<std::string, sf::Image> weightMaps;
+	for (const TerrainLayer& layer : layers)
+	{
+		if (weightMaps.count(layer.weightMap))
+			continue;
+		sf::Image& image = weightMaps[layer.weightMap];
+		if (!image.loadFromFile(layer.weightMap))
+			return false;
+		if (weightMaps.size() == 1)
+		{
+			payload.weightWidth = image.getSize().x;
+			payload.weightHeight = image.getSize().y;
+		}
+		else if (image.getSize().x != payload.weightWidth || image.getSize().y != payload.weightHeight)
+			return false;
+	}
+	size_t sliceSize = (size_t)payload.weightWidth * payload.weightHeight * 4;
+	payload.weights.assign(sliceSize * ((layers.size() + 3) / 4), 0);
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		const uint8_t* source = weightMaps[layers[i].weightMap].getPixelsPtr() + layers[i].weightChannel;
+		uint8_t* target = &payload.weights[sliceSize * (i / 4) + i % 4];
+		for (size_t texel = 0; texel < sliceSize; texel += 4)
+			target[texel] = source[texel];
+	}
+	return true;
+}
+
+//Creates the material arrays of the terrain with every layer set to its placeholder color and equal weights, and queues the layers to be loaded.
+//Detail textures are block compressed when the driver supports it
+void loadTerrainMaterials(AssetLoader& loader, TerrainMaterials& materials, const std::vector<TerrainLayer>& layers)
+{
+	materials.layerCount = (int)layers.size();
+	int slices = (materials.layerCount + 3) / 4;
+	std::vector<sf::Color> colors;
+	for (const TerrainLayer& layer : layers)
+		colors.push_back(layer.placeholder);
+	std::vector<uint8_t> weights(slices * 4, 0);
+	for (int i = 0; i < materials.layerCount; i++)
+		weights[i] = (uint8_t)(255 / materials.layerCount);
+
+	float aniso = 0.f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
+	glGenTextures(1, &materials.layers);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, materials.layers);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_SRGB8_ALPHA8, 1, 1, materials.layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors.data());
+	glGenTextures(1, &materials.weights);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, materials.weights);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, slices, 0, GL_RGBA, GL_UNSIGNED_BYTE, weights.data());
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	TextureCompression compression = GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB ? TextureCompression::BC1 : TextureCompression::None;
+	std::shared_ptr<TerrainMaterialPayload> payload = std::make_shared<TerrainMaterialPayload>();
+	TerrainMaterials* target = &materials;
+	loader.load([payload, layers, compression]() -> size_t
+	{
+		payload->valid = decodeTerrainMaterials(layers, compression, *payload);
+		if (!payload->valid)
+			return 0;
+		size_t bytes = payload->weights.size();
+		for (const std::vector<char>& level : payload->levels)
+			bytes += level.size();
+		return bytes;
+	}, [payload, target]()
+	{
+		if (!payload->valid)
+		{
+			std::cout << "Failed to load the terrain materials" << std::endl;
+			target->state = AssetState::Failed;
+			return;
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, target->layers);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)payload->levels.size() - 1);
+		for (size_t i = 0; i < payload->levels.size(); i++)
+		{
+			GLsizei width = std::max(payload->width >> i, 1u), height = std::max(payload->height >> i, 1u);
+			const std::vector<char>& level = payload->levels[i];
+			if (payload->compressed)
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, payload->internalFormat, width, height, target->layerCount, 0, (GLsizei)level.size(), level.data());
+			else
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, i, payload->internalFormat, width, height, target->layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+		//Weights are plain linear data, so the driver's mip chain is good enough for them
+		glBindTexture(GL_TEXTURE_2D_ARRAY, target->weights);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, payload->weightWidth, payload->weightHeight, (GLsizei)payload->weights.size() / (payload->weightWidth * payload->weightHeight * 4),
+			0, GL_RGBA, GL_UNSIGNED_BYTE, payload->weights.data());
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		target->state = AssetState::Ready;
+	});
+}
+
+//Generates a texture holding raw data that shaders read with texelFetch
+GLuint genDataTexture(GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* data)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	return texture;
 }
 
@@ -102,10 +345,11 @@ struct VAOslot
 	GLenum type;
 	GLsizei stride;
 	const void* offset;
+	GLboolean normalized = GL_FALSE;
 };
 
-//Generates a vertex array object (VAO)
-GLuint genVAO(VAOslot* slots, size_t count)
+//Generates a vertex array object (VAO). If ebo is not 0 it is bound as the element buffer of the VAO
+GLuint genVAO(VAOslot* slots, size_t count, GLuint ebo = 0)
 {
 	GLuint vao;
 	glGenVertexArrays(1, &vao);
@@ -114,271 +358,331 @@ GLuint genVAO(VAOslot* slots, size_t count)
 	{
 		glBindBuffer(GL_ARRAY_BUFFER, slots[i].vbo);
 		glEnableVertexAttribArray(slots[i].index);
-		glVertexAttribPointer(slots[i].index, slots[i].vs, slots[i].type, GL_FALSE, slots[i].stride, slots[i].offset);
+		glVertexAttribPointer(slots[i].index, slots[i].vs, slots[i].type, slots[i].normalized, slots[i].stride, slots[i].offset);
 	}
+	if (ebo)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	glBindVertexArray(0);
 
 	return vao;
 }
 
-//Container for buffers of obj datae
+//Generates a VAO whose attributes all read from a single (usually interleaved) vbo
+GLuint genVAO(GLuint vbo, const VertexAttribute* attributes, size_t count, GLuint ebo = 0)
+{
+	std::vector<VAOslot> slots(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexAttribute& attribute = attributes[i];
+		slots[i] = { vbo, attribute.location, attribute.components, attribute.type, (GLsizei)attribute.stride, (const void*)(uintptr_t)attribute.offset, (GLboolean)attribute.normalized };
+	}
+	return genVAO(&slots[0], count, ebo);
+}
+
+//Container for buffers of obj datae. The buffers only exist once state is Ready
 struct OBJ
 {
-	GLuint v_vbo, n_vbo, u_vbo, vao, vertexCount = 0;
+	GLuint vbo = 0, ebo = 0, vao = 0, vertexCount = 0, indexCount = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	glm::vec3 boundsMin, boundsMax, positionOffset, positionScale;
+	AssetState state = AssetState::Loading;
 };
 
-//Vector 3 used to store either a 3D vertex or a normal vector
-struct Vertex
+//Parses an .obj file and turns it into an indexed mesh optimized for the post transform cache and vertex fetch
+bool buildOBJMesh(const char* source, IndexedMesh& indexed)
 {
-	float x, y, z;
-};
-typedef Vertex Normal;
+	sf::Clock clock;
+	std::vector<char> buffer;
+	OBJMesh mesh;
+	if (!readFile(source, buffer) || !parseOBJ(buffer.data(), buffer.size(), mesh) || mesh.corners.empty())
+		return false;
+	float parseTime = clock.getElapsedTime().asSeconds();
+	std::cout << "Parsed " << source << ": " << mesh.corners.size() / 3 << " triangles in " << parseTime * 1000.f << "ms ("
+		<< buffer.size() / (1024.f * 1024.f) / parseTime << " MB/s)" << std::endl;
+
+	std::vector<Vertex> nonIndexedVertices;
+	std::vector<Normal> nonIndexedNormals;
+	std::vector<UV> nonIndexedUvs;
+	expandOBJ(mesh, nonIndexedVertices, nonIndexedNormals, nonIndexedUvs);
+
+	buildIndexedMesh(nonIndexedVertices, nonIndexedNormals, nonIndexedUvs, indexed);
+	float acmrUnordered = computeACMR(&indexed.indices[0], indexed.indices.size(), indexed.vertices.size());
+	optimizeVertexCache(&indexed.indices[0], indexed.indices.size(), indexed.vertices.size());
+	optimizeVertexFetch(indexed);
+	float acmrOptimized = computeACMR(&indexed.indices[0], indexed.indices.size(), indexed.vertices.size());
+	std::cout << "Indexed " << source << ": " << nonIndexedVertices.size() << " -> " << indexed.vertices.size() << " vertices, ACMR 3.00 (non indexed) -> "
+		<< acmrUnordered << " (file order) -> " << acmrOptimized << " (optimized)" << std::endl;
+	return true;
+}
+
+//Uploads the blobs of a baked mesh as they are and creates a VAO from its attribute descriptors
+void uploadBakedMesh(const BakedMeshView& view, OBJ& obj)
+{
+	const BakedMeshHeader& header = *view.header;
+	obj.vertexCount = header.vertexCount;
+	obj.indexCount = header.indexCount;
+	obj.indexType = header.indexType;
+	obj.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	obj.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	obj.positionOffset = glm::vec3(header.positionOffset[0], header.positionOffset[1], header.positionOffset[2]);
+	obj.positionScale = glm::vec3(header.positionScale[0], header.positionScale[1], header.positionScale[2]);
+	obj.vbo = genArrayVBO(header.vertexBytes, view.vertexData);
+	obj.ebo = genArrayVBO(header.indexBytes, view.indexData);
+	obj.vao = genVAO(obj.vbo, view.attributes, header.attributeCount, obj.ebo);
+
+	std::cout << "Mesh memory: " << header.vertexCount << " vertices * " << header.vertexBytes / std::max(header.vertexCount, 1u) << " bytes ("
+		<< sizeof(Vertex) + sizeof(Normal) + sizeof(UV) << " unpacked) + " << header.indexBytes << " index bytes = " << (header.vertexBytes + header.indexBytes) / 1024.f << "KB" << std::endl;
+}
 
-//Vector 2 for containing uv coords
-struct UV
+//Baked mesh decoded on a loader thread. view points into cache when the baked file was mapped, otherwise into baked
+struct MeshPayload
 {
-	float u, v;
+	MappedFile cache;
+	std::vector<char> baked;
+	BakedMeshView view;
+	bool valid = false;
 };
 
-//Loads an .obj file
-void loadOBJ(const char* source, OBJ& obj)
+//Maps the baked mesh of an .obj file, or parses and bakes the .obj next to the source if there is no valid baked mesh yet
+bool decodeOBJ(const char* source, MeshPayload& payload)
 {
-	std::ifstream file;
-	file.open(source);
-	int lines = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n') + 1;
-	file.seekg(file.beg);
-	int faces = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), 'f');
-	file.seekg(file.beg);
-	std::vector<Vertex> vertices(lines / 3);
-	std::vector<Normal> normals(lines / 3);
-	std::vector<UV> uvs(lines / 3);
-	std::vector<Vertex> nonIndexedVertices(faces * 3 * 3);
-	std::vector<Normal> nonIndexedNormals(faces * 3);
-	std::vector<UV> nonIndexedUvs(faces * 3);
-	if (!file.is_open())
-	{
-		std::cout << "Failed to load obj: " << source << "! Exiting...";
-		exit(-5);
-	}
+	sf::Clock clock;
+	std::string cachePath = std::string(source) + ".bmesh";
+	SourceStamp stamp;
+	if (!getSourceStamp(source, stamp))
+		return false;
 
-	std::stringstream stream;
-	stream << file.rdbuf();
+	if (payload.cache.open(cachePath.c_str()) && readBakedMesh(payload.cache.data(), payload.cache.size(), stamp, meshFormat, payload.view))
+	{
+		std::cout << "Loaded " << source << " from " << cachePath << " in " << clock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+		return true;
+	}
+	payload.cache.close();
+
+	IndexedMesh indexed;
+	if (!buildOBJMesh(source, indexed))
+		return false;
+	bakeMesh(indexed, meshFormat, stamp, payload.baked);
+	if (!writeFile(cachePath, payload.baked))
+		std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+	readBakedMesh(payload.baked.data(), payload.baked.size(), stamp, meshFormat, payload.view);
+	std::cout << "Loaded " << source << " without cache in " << clock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+	return true;
+}
 
-	int vIndex = 0, nIndex = 0, uvIndex = 0, niVIndex = 0, niNIndex = 0, niUVIndex = 0;
-	std::string type;
-	
-	while (stream >> type)
+//Loads an .obj file. Decoding runs on a loader thread, the buffers are created when the loader uploads it. obj.state tells when it can be drawn
+void loadOBJ(AssetLoader& loader, const char* source, OBJ& obj)
+{
+	std::shared_ptr<MeshPayload> payload = std::make_shared<MeshPayload>();
+	std::string path = source;
+	OBJ* target = &obj;
+	loader.load([payload, path]() -> size_t
 	{
-		if (type == "v")
-		{
-			Vertex vertex;
-			stream >> vertex.x >> vertex.y >> vertex.z;
-			vertices[vIndex] = vertex;
-			vIndex++;
-		}
-		else if (type == "vn")
-		{
-			Normal normal;
-			stream >> normal.x >> normal.y >> normal.z;
-			normals[nIndex] = normal;
-			nIndex++;
-		}
-		else if (type == "vt")
+		payload->valid = decodeOBJ(path.c_str(), *payload);
+		return payload->valid ? payload->view.header->vertexBytes + payload->view.header->indexBytes : 0;
+	}, [payload, path, target]()
+	{
+		if (!payload->valid)
 		{
-			UV uv;
-			stream >> uv.u >> uv.v;
-			uvs[uvIndex] = uv;
-			uvIndex++;
+			std::cout << "Failed to load obj: " << path << std::endl;
+			target->state = AssetState::Failed;
+			return;
 		}
-		else if (type == "f")
-		{
-			char temp;
-			int i1, i2, i3;
-
-			for (int i = 0; i < 3; i++)
-			{
-				stream >> i1 >> temp >> i2 >> temp >> i3;
-				nonIndexedVertices[niVIndex] = vertices[i1 - 1];
-				nonIndexedNormals[niNIndex] = normals[i3 - 1];
-				nonIndexedUvs[niUVIndex] = uvs[i2 - 1];
-				niVIndex++;
-				niNIndex++;
-				niUVIndex++;
-			}
-			obj.vertexCount += 3;
-		}
-	}
-
-	obj.v_vbo = genArrayVBO(nonIndexedVertices.size() * sizeof(Vertex), &nonIndexedVertices[0]);
-	obj.n_vbo = genArrayVBO(nonIndexedNormals.size() * sizeof(Normal), &nonIndexedNormals[0]);
-	obj.u_vbo = genArrayVBO(nonIndexedUvs.size() * sizeof(UV), &nonIndexedUvs[0].u);
+		uploadBakedMesh(payload->view, *target);
+		target->state = AssetState::Ready;
+	});
 }
 
 //Container for terrain data buffers and properties
 struct Terrain
 {
-	GLuint v_vbo, n_vbo, vao;
+	GLuint heightTexture, normalTexture, patchVao;
+	size_t quadrantOffsets[5];
 	int size, samples;
 	std::vector<float> heights;
+	TerrainLOD lod;
+	HeightPyramid pyramid;
 };
 
-//Returns the height of the terrain at a given x and z pos
-float getTerrainHeight(float xpos, float zpos)
+//Returns a view of the terrain heights for height queries
+HeightField getHeightField(const Terrain& terrain)
 {
-	sf::Color pixel = heightMap.getPixel(xpos * (heightMap.getSize().x - 1), zpos * (heightMap.getSize().y - 1));
-	float value = (pixel.r + pixel.g + pixel.b) / 256.f;
-	return value * 3.f;
+	return { &terrain.heights[0], terrain.samples, (float)terrain.size };
 }
 
-//Gets the height of a triangle at x, y within vertices p1, p2, and p3. I have no idea how this works at all
-float getBaryCentricHeight(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float x, float z)
+//Returns the collision height of the terrain based on the worldX and worldZ. Positions outside of the terrain get the height at its edge
+float getTerrainCollisionHeight(const Terrain& terrain, float worldX, float worldZ)
 {
-	float det = (p2.z - p3.z) * (p1.x - p3.x) + (p3.x - p2.x) * (p1.z - p3.z);
-
-	float l1 = ((p2.z - p3.z) * (x - p3.x) + (p3.x - p2.x) * (z - p3.z)) / det;
-	float l2 = ((p3.z - p1.z) * (x - p3.x) + (p1.x - p3.x) * (z - p3.z)) / det;
-	float l3 = 1.0f - l1 - l2;
-
-	return l1 * p1.y + l2 * p2.y + l3 * p3.y;
+	return sampleHeight(getHeightField(terrain), worldX, worldZ);
 }
 
-//Returns the collision height of the terrain based on the worldX and worldZ
-float getTerrainCollisionHeight(Terrain& terrain, float worldX, float worldZ)
+//Index that splits a strip into separate strips when primitive restart is enabled
+constexpr GLuint PRIMITIVE_RESTART_INDEX = 0xFFFFFFFF;
+
+//Generates a terrain of (samples + 1)^2 height samples from the height map. Heights and normals are stored in textures that the patches selected by the LOD quadtree are displaced with
+void generateTerrain(Terrain& terrain, int size, int samples, JobSystem& jobs)
 {
-	if (worldX > terrain.size || worldZ > terrain.size)
-		return INT_MIN;
-
-	float localX = worldX / terrain.size;
-	float localZ = worldZ / terrain.size;
-	float gridSquareSize = 1.f / terrain.samples;
-	int gridX = std::floor(localX / gridSquareSize);
-	int gridZ = std::floor(localZ / gridSquareSize);
-	float xCoord = fmod(localX, gridSquareSize) / gridSquareSize;
-	float zCoord = fmod(localZ, gridSquareSize) / gridSquareSize;
-	if (xCoord < 1 - zCoord)
-	{
-		return getBaryCentricHeight(
-			glm::vec3(0, terrain.heights[gridZ * terrain.samples + gridX], 0),
-			glm::vec3(1, terrain.heights[gridZ * terrain.samples + (gridX + 1)], 0),
-			glm::vec3(0, terrain.heights[(gridZ + 1) * terrain.samples + gridX], 1),
-			xCoord, zCoord
-		);
+	sf::Clock clock;
+	terrain.size = size;
+	terrain.samples = samples;
+	int rowLength = samples + 1;
+	HeightMapImage image = { heightMap.getPixelsPtr(), (int)heightMap.getSize().x, (int)heightMap.getSize().y };
+	generateTerrainHeights(image, samples, jobs, terrain.heights);
+	std::vector<int16_t> normals;
+	generateTerrainNormals(&terrain.heights[0], samples, jobs, normals);
+	buildTerrainLOD(&terrain.heights[0], samples, (float)size, terrain.lod);
+	buildHeightPyramid(getHeightField(terrain), terrain.pyramid);
+	float generationTime = clock.getElapsedTime().asSeconds();
+
+	terrain.heightTexture = genDataTexture(GL_R32F, rowLength, rowLength, GL_RED, GL_FLOAT, &terrain.heights[0]);
+	terrain.normalTexture = genDataTexture(GL_RG16_SNORM, rowLength, rowLength, GL_RG, GL_SHORT, &normals[0]);
+
+	//Every patch is drawn with the same grid mesh, placed and displaced in the vertex shader
+	std::vector<GLfloat> gridVertices;
+	for (int z = 0; z <= TERRAIN_PATCH_SIZE; z++)
+	{
+		for (int x = 0; x <= TERRAIN_PATCH_SIZE; x++)
+		{
+			gridVertices.push_back((GLfloat)x);
+			gridVertices.push_back((GLfloat)z);
+		}
 	}
-	return getBaryCentricHeight(
-		glm::vec3(1, terrain.heights[(gridZ) * terrain.samples + (gridX + 1)], 0),
-		glm::vec3(1, terrain.heights[(gridZ + 1) * terrain.samples + (gridX + 1)], 1),
-		glm::vec3(0, terrain.heights[(gridZ + 1) * terrain.samples + (gridX)], 1),
-		xCoord, zCoord
-	);
+	std::vector<GLuint> indices;
+	genPatchIndices(PRIMITIVE_RESTART_INDEX, indices, terrain.quadrantOffsets);
+	VAOslot gridSlot;
+	gridSlot.vbo = genArrayVBO(gridVertices.size() * sizeof(GLfloat), &gridVertices[0]);
+	gridSlot.index = 0;
+	gridSlot.vs = 2;
+	gridSlot.type = GL_FLOAT;
+	gridSlot.stride = 2 * sizeof(GLfloat);
+	gridSlot.offset = (void*)0;
+	terrain.patchVao = genVAO(&gridSlot, 1, genArrayVBO(indices.size() * sizeof(GLuint), &indices[0]));
+
+	std::cout << "Terrain: " << rowLength * rowLength << " samples, " << terrain.lod.nodes.size() << " quadtree nodes in " << terrain.lod.ranges.size() << " levels, "
+		<< rowLength * rowLength * (sizeof(float) + 2 * sizeof(int16_t)) / (1024.f * 1024.f) << "MB of textures, generated in " << generationTime * 1000.f << "ms on "
+		<< jobs.getThreadCount() << " threads" << std::endl;
 }
 
-//Container for a 3 float vector
-struct Vector3
+//Textures and VAO of a terrain draw. The material arrays are only bound when materials is given, the depth pass doesn't read them
+DrawState getTerrainDrawState(GLuint program, const TerrainMaterials* materials, const Terrain& terrain)
 {
-	float x, y, z;
-
-	Vector3 operator+(const Vector3& vector)
+	DrawState state;
+	state.program = program;
+	state.vao = terrain.patchVao;
+	if (materials)
 	{
-		return { x + vector.x, y + vector.y, z + vector.z };
+		state.textureTargets[0] = state.textureTargets[1] = GL_TEXTURE_2D_ARRAY;
+		state.textures[0] = materials->layers;
+		state.textures[1] = materials->weights;
 	}
+	state.textureTargets[5] = state.textureTargets[6] = GL_TEXTURE_2D;
+	state.textures[5] = terrain.heightTexture;
+	state.textures[6] = terrain.normalTexture;
+	return state;
+}
 
-	template<class T>
-	Vector3 operator/(const T& t)
+//Draws the patches of a terrain draw list with the program and the state from getTerrainDrawState
+void drawTerrainPatches(const ShaderProgram& program, const Terrain& terrain, const TerrainDrawList& drawList)
+{
+	GLint originLocation = getUniformLocation(program, "patchOrigin");
+	GLint spacingLocation = getUniformLocation(program, "patchSpacing");
+	GLint morphLocation = getUniformLocation(program, "morphRange");
+	for (const TerrainPatch& patch : drawList.patches)
 	{
-		return { x / t, y / t, z / t };
-	}
-};
+		glUniform2f(originLocation, (float)patch.x, (float)patch.z);
+		glUniform1f(spacingLocation, patch.size / (float)TERRAIN_PATCH_SIZE);
+		if (drawList.morph)
+			glUniform2f(morphLocation, terrain.lod.morphStarts[patch.level], terrain.lod.morphScales[patch.level]);
+		else
+			glUniform2f(morphLocation, FLT_MAX, 0.f);
 
-//Returns the normal vector of a triangle
-glm::vec3 getTriangleNormal(Vector3 v1, Vector3 v2, Vector3 v3)
-{
-	glm::vec3 normalizedTriVectors1[2] = {
-		glm::vec3(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z),
-		glm::vec3(v2.x - v3.x, v2.y - v3.y, v2.z - v3.z)
-	};
-	return glm::cross(normalizedTriVectors1[1], normalizedTriVectors1[0]);
+		//Quadrants are stored one after the other, so every run of selected quadrants is a single draw
+		for (int first = 0; first < 4; first++)
+		{
+			if (!(patch.quadrantMask & (1 << first)))
+				continue;
+			int last = first;
+			while (last < 4 && (patch.quadrantMask & (1 << last)))
+				last++;
+			size_t offset = terrain.quadrantOffsets[first];
+			glDrawElements(GL_TRIANGLE_STRIP, terrain.quadrantOffsets[last] - offset, GL_UNSIGNED_INT, (void*)(offset * sizeof(GLuint)));
+			first = last;
+		}
+	}
 }
 
-//Retunns the vertices of a terrain quad based on the terrain x and y positions
-void getQuadVertices(Vector3 vectors[4], float xpos, float zpos, float d)
+//Per instance attributes streamed to the GPU every frame. The buffer is orphaned before every update so the driver never waits for draws still reading the old contents
+struct InstanceStream
 {
-	vectors[0] = { xpos + d, getTerrainHeight(xpos + d, zpos + d), zpos + d };
-	vectors[1] = { xpos, getTerrainHeight(xpos, zpos + d), zpos + d };
-	vectors[2] = { xpos, getTerrainHeight(xpos, zpos), zpos };
-	vectors[3] = { xpos + d, getTerrainHeight(xpos + d, zpos), zpos };
-}
+	GLuint vbo = 0;
+	size_t capacity = 0;
+};
 
-//Generates a terrain -- TODO: Implement normal smoothing
-void generateTerrain(Terrain& terrain, int size, int samples, bool smoothNormals)
+//Writes the transforms of the instances in each list one list after the other into the stream, so list i starts at the total size of the lists before it
+void streamInstances(InstanceStream& stream, const glm::mat4* models, const std::vector<const std::vector<uint32_t>*>& lists)
 {
-	terrain.size = size;
-	terrain.samples = samples;
-	terrain.heights.resize(samples * samples);
-
-	std::vector<Vector3> vertices(samples * samples * 6);
-	std::vector<Vector3> normals(samples * samples * 6);
-
-	float xpos = 0, ypos = 0, zpos = 0, d = 1 / (float)samples;
-	int index = 0;
-	for (int z = 0; z < samples; z++)
+	size_t count = 0;
+	for (const std::vector<uint32_t>* list : lists)
+		count += list->size();
+	if (!stream.vbo)
+		glGenBuffers(1, &stream.vbo);
+	while (stream.capacity < count)
+		stream.capacity = std::max(stream.capacity * 2, (size_t)1024);
+
+	glBindBuffer(GL_ARRAY_BUFFER, stream.vbo);
+	glBufferData(GL_ARRAY_BUFFER, stream.capacity * sizeof(InstanceTransform), NULL, GL_STREAM_DRAW);
+	if (count)
 	{
-		for (int x = 0; x < samples; x++)
+		InstanceTransform* out = (InstanceTransform*)glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceTransform), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		for (const std::vector<uint32_t>* list : lists)
 		{
-			Vector3 quad[4];
-			getQuadVertices(quad, xpos, zpos, d);
-
-			vertices[index] = quad[0];
-			vertices[index + 1] = quad[1];
-			vertices[index + 2] = quad[2];
-			vertices[index + 3] = quad[2];
-			vertices[index + 4] = quad[3];
-			vertices[index + 5] = quad[0];
-
-			glm::vec3 normal1 = getTriangleNormal(quad[0], quad[1], quad[2]);
-			glm::vec3 normal2 = getTriangleNormal(quad[2], quad[3], quad[0]);
-
-			normals[index] = { normal1.x, normal1.y, normal1.z };
-			normals[index + 1] = { normal1.x, normal1.y, normal1.z };
-			normals[index + 2] = { normal1.x, normal1.y, normal1.z };
-			normals[index + 3] = { normal2.x, normal2.y, normal2.z };
-			normals[index + 4] = { normal2.x, normal2.y, normal2.z };
-			normals[index + 5] = { normal2.x, normal2.y, normal2.z };
-
-			terrain.heights[z * samples + x] = getTerrainHeight(xpos, zpos);
-
-			xpos += d;
-			index += 6;
+			writeInstanceTransforms(models, list->data(), list->size(), out);
+			out += list->size();
 		}
-		xpos = 0;
-		zpos += d;
+		glUnmapBuffer(GL_ARRAY_BUFFER);
 	}
-
-	terrain.v_vbo = genArrayVBO(vertices.size() * sizeof(Vector3), &vertices[0]);
-	terrain.n_vbo = genArrayVBO(normals.size() * sizeof(Vector3), &normals[0]);
-	terrain.vao = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-//Renders a terrain object to screen
-void drawTerrain(GLuint textures[4], Terrain terrain)
+//Points the instance attributes of a VAO (model matrix at locations 3 to 6, normal matrix at 7 to 9) at the stream, starting at firstInstance
+void bindInstanceRange(GLuint vao, const InstanceStream& stream, size_t firstInstance)
 {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, textures[0]);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, textures[1]);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, textures[2]);
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, textures[3]);
-
-	glBindVertexArray(terrain.vao);
-	glDrawArrays(GL_TRIANGLES, 0, terrain.samples * terrain.samples * 6);
+	size_t offset = firstInstance * sizeof(InstanceTransform);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, stream.vbo);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)(offset + offsetof(InstanceTransform, model) + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	for (GLuint column = 0; column < 3; column++)
+	{
+		glEnableVertexAttribArray(7 + column);
+		glVertexAttribPointer(7 + column, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)(offset + offsetof(InstanceTransform, normal) + column * 3 * sizeof(float)));
+		glVertexAttribDivisor(7 + column, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-int main()
+int main(int argc, char** argv)
 {
-	//Defines random seed to be used by the rand function and loads the terrain height map
-	srand(time(NULL));
-	heightMap.loadFromFile("images/heightMap.png");
+	sf::Clock startupClock;
+	BenchmarkSettings benchmark;
+	if (!parseBenchmarkSettings(argc, argv, benchmark))
+		return -1;
+	bool benchmarking = !benchmark.trackPath.empty();
+	std::vector<CameraInput> inputTrack, recordedTrack;
+	if (benchmarking && !loadInputTrack(benchmark.trackPath, inputTrack))
+	{
+		std::cout << "Failed to load the input track " << benchmark.trackPath << std::endl;
+		return -1;
+	}
+
+	//Decodes and uploads assets. The terrain height map starts decoding while the window is created
+	AssetLoader assets;
+	bool heightMapValid = false;
+	assets.load([&heightMapValid]() -> size_t { heightMapValid = heightMap.loadFromFile("images/heightMap.png"); return 0; }, []() {});
 
 	//Initializes the window and it's properties
 	bool wireframe = false;
@@ -388,7 +692,14 @@ int main()
 	settings.minorVersion = 3;
 	settings.depthBits = 24;
 	settings.stencilBits = 8;
-	sf::RenderWindow window(sf::VideoMode(1920, 1080), "SFML Thing", sf::Style::Default, settings);
+	//Benchmarks don't open a window. They render into an offscreen framebuffer of a context without one, so nothing depends on the desktop
+	std::unique_ptr<sf::RenderWindow> window;
+	std::unique_ptr<sf::Context> headlessContext;
+	if (benchmarking)
+		headlessContext.reset(new sf::Context(settings, benchmark.width, benchmark.height));
+	else
+		window.reset(new sf::RenderWindow(sf::VideoMode(1920, 1080), "SFML Thing", sf::Style::Default, settings));
+	sf::Vector2u viewSize = window ? window->getSize() : sf::Vector2u(benchmark.width, benchmark.height);
 
 	//Initalizes OpenGL and enables neccesarry functionality
 	if (glewInit() != GLEW_OK)
@@ -399,94 +710,192 @@ int main()
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glClearColor(0.0625f, 0.304f, 0.519f, 1.f);
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+	BenchmarkTarget benchmarkTarget;
+	if (benchmarking)
+		genBenchmarkTarget(benchmarkTarget, benchmark.width, benchmark.height);
+
+	//The terrain is generated from the height map, so it is the one asset everything waits for
+	assets.finish();
+	if (!heightMapValid)
+	{
+		std::cout << "Failed to load height map: images/heightMap.png" << std::endl;
+		return -1;
+	}
+
+	//Queues the textures, the tree model and the tree mask. They decode on the loader threads while the terrain and the shaders are built, and are
+	//uploaded a few per frame. Until then the textures hold a placeholder color and the trees aren't drawn
+	//The terrain texture map holds the weights of the path, dirt and grass in its red, green and blue channels
+	const std::vector<TerrainLayer> terrainLayers = {
+		{ "images/PathTexture.png", sf::Color(140, 120, 95, 255), "images/TerrainTextureMap.png", 0 },
+		{ "images/DirtTexture.png", sf::Color(110, 80, 55, 255), "images/TerrainTextureMap.png", 1 },
+		{ "images/GrassTexture.jpg", sf::Color(70, 105, 40, 255), "images/TerrainTextureMap.png", 2 }
+	};
+	TerrainMaterials terrainMaterials;
+	loadTerrainMaterials(assets, terrainMaterials, terrainLayers);
+	TextureAsset sunTexture, treeTexture;
+	loadTexture(assets, sunTexture, "images/sun.png", sf::Color(0, 0, 0, 0), false);
+	OBJ treeOBJ;
+	loadOBJ(assets, "models/obj/OakTree1.obj", treeOBJ);
+	loadTexture(assets, treeTexture, "images/tree/TreeTexture.png", sf::Color(60, 85, 40, 255));
+	sf::Image treeMask;
+	AssetState treeMaskState = AssetState::Loading;
+	bool treeMaskValid = false;
+	//The mask stays on the CPU, so it never counts against the upload budget. Without it the trees aren't placed at all
+	assets.load([&treeMask, &treeMaskValid]() -> size_t
+	{
+		treeMaskValid = treeMask.loadFromFile("images/TerrainTextureMap.png");
+		return 0;
+	}, [&treeMaskValid, &treeMaskState]()
+	{
+		if (!treeMaskValid)
+		{
+			std::cout << "Failed to load tree mask: images/TerrainTextureMap.png" << std::endl;
+			treeMaskState = AssetState::Failed;
+			return;
+		}
+		treeMaskState = AssetState::Ready;
+	});
+
+	//Creates the job system that runs parallel work on every hardware thread
+	JobSystem jobs;
 
 	//Creates a new vao for the terrain
 	Terrain terrain;
-	generateTerrain(terrain, 50, 256, true);
-	VAOslot tvaoSlots[2];
-	tvaoSlots[0].vbo = terrain.v_vbo;
-	tvaoSlots[0].index = 0;
-	tvaoSlots[0].vs = 3;
-	tvaoSlots[0].type = GL_FLOAT;
-	tvaoSlots[0].stride = sizeof(Vector3);
-	tvaoSlots[0].offset = (void*)0;
-	tvaoSlots[1].vbo = terrain.n_vbo;
-	tvaoSlots[1].index = 1;
-	tvaoSlots[1].vs = 3;
-	tvaoSlots[1].type = GL_FLOAT;
-	tvaoSlots[1].stride = 3 * sizeof(GLfloat);
-	tvaoSlots[1].offset = (void*)0;
-	terrain.vao = genVAO(tvaoSlots, 2);
+	generateTerrain(terrain, 50, benchmark.terrainSamples, jobs);
 	glm::mat4 terrainModel = glm::mat4(1.f);
 	terrainModel = glm::scale(terrainModel, glm::vec3(terrain.size, 1.f, terrain.size));
+	const float fieldOfView = glm::radians(70.f);
+	const float nearPlane = 0.5f, farPlane = 150.f;
+	const float terrainPixelError = 2.f;
+	computeLODRanges(terrain.lod, fieldOfView, (float)viewSize.y, terrainPixelError);
+	TerrainDrawList cameraTerrain, lightTerrain[MAX_SHADOW_CASCADES];
+
+	//Trees the camera sees are also tested against a low resolution depth buffer of a coarse mesh under the terrain, which hides the trees behind hills
+	OccluderMesh terrainOccluder;
+	buildTerrainOccluder(getHeightField(terrain), 64, terrainOccluder);
+	OcclusionBuffer occlusionBuffer;
+	initOcclusionBuffer(occlusionBuffer, 256, 144);
+	bool occlusionCulling = benchmark.occlusionCulling;
+	size_t frustumTreeCount = 0, occludedTreeCount = 0;
+
+	//Box around everything that casts shadows. The shadow cascades reach through all of it towards the light
+	AABB sceneBounds = { glm::vec3(0.f, FLT_MAX, 0.f), glm::vec3((float)terrain.size, -FLT_MAX, (float)terrain.size) };
+	for (int root : terrain.lod.roots)
+	{
+		sceneBounds.min.y = std::min(sceneBounds.min.y, terrain.lod.nodes[root].minHeight);
+		sceneBounds.max.y = std::max(sceneBounds.max.y, terrain.lod.nodes[root].maxHeight);
+	}
 
-	//Creates all of the shaders
-	GLuint terrainShader, floraShader, basicShader, depthPassShader, depthPassInstShader;
-	terrainShader = genShaderProgram(loadShader("Shaders/terrainVertexShader.glsl", GL_VERTEX_SHADER), loadShader("Shaders/terrainFragmentShader.glsl", GL_FRAGMENT_SHADER));
-	floraShader = genShaderProgram(loadShader("Shaders/modelVertexShader.glsl", GL_VERTEX_SHADER), loadShader("Shaders/modelFragmentShader.glsl", GL_FRAGMENT_SHADER));
-	basicShader = genShaderProgram(loadShader("Shaders/basicVertexShader.glsl", GL_VERTEX_SHADER), loadShader("Shaders/basicFragmentShader.glsl", GL_FRAGMENT_SHADER));
-	depthPassShader = genShaderProgram(loadShader("Shaders/depthVertexShader.glsl", GL_VERTEX_SHADER), loadShader("Shaders/depthFragmentShader.glsl", GL_FRAGMENT_SHADER));
-	depthPassInstShader = genShaderProgram(loadShader("Shaders/depthVertexShader2.glsl", GL_VERTEX_SHADER), loadShader("Shaders/depthFragmentShader2.glsl", GL_FRAGMENT_SHADER));
-
-	//Loads all the terrain textures and the sun texture
-	GLuint terrainTextures[4];
-	terrainTextures[0] = loadTexture("images/TerrainTextureMap.png", GL_RGBA);
-	terrainTextures[1] = loadTexture("images/PathTexture.png");
-	terrainTextures[2] = loadTexture("images/DirtTexture.png");
-	terrainTextures[3] = loadTexture("images/GrassTexture.jpg");
-	glUseProgram(terrainShader);
-	glUniform1i(glGetUniformLocation(terrainShader, "textureMap"), 0);
-	glUniform1i(glGetUniformLocation(terrainShader, "texture_r"), 1);
-	glUniform1i(glGetUniformLocation(terrainShader, "texture_g"), 2);
-	glUniform1i(glGetUniformLocation(terrainShader, "texture_b"), 3);
-	glUniform1i(glGetUniformLocation(terrainShader, "depthMap"), 4);
-	GLuint sunTexture = loadTexture("images/sun.png", GL_RGBA);
-
-	//Creates a VAO for the tree model
-	OBJ treeOBJ;
-	loadOBJ("models/obj/OakTree1.obj", treeOBJ);
-	VAOslot treeVaoSlots[3];
-	treeVaoSlots[0].vbo = treeOBJ.v_vbo;
-	treeVaoSlots[0].index = 0;
-	treeVaoSlots[0].vs = 3;
-	treeVaoSlots[0].type = GL_FLOAT;
-	treeVaoSlots[0].stride = 3 * sizeof(GLfloat);
-	treeVaoSlots[0].offset = (void*)0;
-	treeVaoSlots[1].vbo = treeOBJ.n_vbo;
-	treeVaoSlots[1].index = 1;
-	treeVaoSlots[1].vs = 3;
-	treeVaoSlots[1].type = GL_FLOAT;
-	treeVaoSlots[1].stride = 3 * sizeof(GLfloat);
-	treeVaoSlots[1].offset = (void*)0;
-	treeVaoSlots[2].vbo = treeOBJ.u_vbo;
-	treeVaoSlots[2].index = 2;
-	treeVaoSlots[2].vs = 2;
-	treeVaoSlots[2].type = GL_FLOAT;
-	treeVaoSlots[2].stride = 2 * sizeof(GLfloat);
-	treeVaoSlots[2].offset = (void*)0;
-	treeOBJ.vao = genVAO(treeVaoSlots, 3);
-	glm::mat4 treeModel = glm::mat4(1.f);
-	glUseProgram(floraShader);
-	GLuint treeTexture = loadTexture("images/tree/TreeTexture.png");
-	glUniform1i(glGetUniformLocation(terrainShader, "tex"), 0);
-	glUniform1i(glGetUniformLocation(terrainShader, "depthMap"), 1);
-	//Creates all of the trees in the scene scattered and rotated randomly 
-	glm::mat4 positions[50];
-	for (int i = 0; i < 50; i++)
-	{
-		float x = rand() / (float)RAND_MAX + rand() % (terrain.size - 1);
-		float z = rand() / (float)RAND_MAX + rand() % (terrain.size - 1);
-		float rot = rand() % 360 * 3.14f / 180.f;
-		float bias = 0.5;
-		glm::vec3 pos = glm::vec3(x, getTerrainCollisionHeight(terrain, x, z) - bias, z);
-		positions[i] = glm::translate(glm::mat4(1.f), pos);
-		positions[i] = glm::rotate(positions[i], rot, glm::vec3(0, 1, 0));
-		positions[i] = glm::scale(positions[i], glm::vec3(2, 2, 2));
-		glUseProgram(floraShader);
-		glUniformMatrix4fv(glGetUniformLocation(floraShader, ("models[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, &positions[i][0][0]);
-		glUseProgram(depthPassInstShader);
-		glUniformMatrix4fv(glGetUniformLocation(depthPassInstShader, ("models[" + std::to_string(i) + "]").c_str()), 1, GL_FALSE, &positions[i][0][0]);
+	//Creates all of the shaders. Programs are loaded from the binary cache when their sources haven't changed
+	ShaderProgram terrainShader, floraShader, basicShader, depthPassShader, depthPassInstShader;
+	std::string formatDefines = getVertexFormatDefines(meshFormat);
+	sf::Clock shaderClock;
+	//Skipping the terrain layers a fragment barely uses saves texture fetches on a GPU. Software rasterizers run both sides of the branch for every
+	//pixel of a quad and pay for the branch on top, so they sample every layer
+	std::string terrainDefines = isSoftwareRenderer() ? "" : "#define SKIP_LIGHT_LAYERS\n";
+	bool linked = loadShaderProgram(terrainShader, "Shaders/terrainVertexShader.glsl", "Shaders/terrainFragmentShader.glsl", formatDefines, terrainDefines);
+	linked &= loadShaderProgram(floraShader, "Shaders/modelVertexShader.glsl", "Shaders/modelFragmentShader.glsl", formatDefines);
+	linked &= loadShaderProgram(basicShader, "Shaders/basicVertexShader.glsl", "Shaders/basicFragmentShader.glsl");
+	linked &= loadShaderProgram(depthPassShader, "Shaders/depthVertexShader.glsl", "Shaders/depthFragmentShader.glsl");
+	linked &= loadShaderProgram(depthPassInstShader, "Shaders/depthVertexShader2.glsl", "Shaders/depthFragmentShader2.glsl");
+	if (!linked)
+	{
+		std::cout << "Failed to create the shader programs! Exiting...";
+		return -1;
 	}
+	std::cout << "Shader programs ready in " << shaderClock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+	GLuint frameUniforms = genFrameUniformBuffer();
+
+	glm::mat4 sunModel = glm::scale(
+		glm::rotate(
+			glm::translate(
+				glm::mat4(1.f),
+				glm::vec3(110, 50.f, 110)),
+			glm::radians(45.f),
+			glm::vec3(0, 1, 0)
+		),
+		glm::vec3(30, 30, 1));
+
+	//Uniforms that don't change between frames are set here, everything shared per frame goes through the frame uniform buffer.
+	//Reloading a program resets its uniforms, so this runs again after every hot reload
+	auto setStaticUniforms = [&]()
+	{
+		for (const ShaderProgram* program : { &terrainShader, &depthPassShader })
+		{
+			glUseProgram(program->id);
+			glUniform1i(getUniformLocation(*program, "heightMap"), 5);
+			glUniform1i(getUniformLocation(*program, "normalMap"), 6);
+			glUniform1i(getUniformLocation(*program, "samples"), terrain.samples);
+			glUniformMatrix4fv(getUniformLocation(*program, "model"), 1, GL_FALSE, &terrainModel[0][0]);
+		}
+		glUseProgram(terrainShader.id);
+		glUniform1i(getUniformLocation(terrainShader, "materials"), 0);
+		glUniform1i(getUniformLocation(terrainShader, "splatMap"), 1);
+		glUniform1i(getUniformLocation(terrainShader, "layerCount"), terrainMaterials.layerCount);
+		glUniform1i(getUniformLocation(terrainShader, "depthMap"), 4);
+		glUniform1i(getUniformLocation(terrainShader, "terrainSize"), terrain.size);
+		glUseProgram(basicShader.id);
+		glUniformMatrix4fv(getUniformLocation(basicShader, "model"), 1, GL_FALSE, &sunModel[0][0]);
+		for (const ShaderProgram* program : { &floraShader, &depthPassInstShader })
+		{
+			glUseProgram(program->id);
+			glUniform3fv(getUniformLocation(*program, "positionOffset"), 1, &treeOBJ.positionOffset[0]);
+			glUniform3fv(getUniformLocation(*program, "positionScale"), 1, &treeOBJ.positionScale[0]);
+		}
+		glUseProgram(floraShader.id);
+		glUniform1i(getUniformLocation(floraShader, "tex"), 0);
+		glUniform1i(getUniformLocation(floraShader, "depthMap"), 1);
+	};
+	setStaticUniforms();
+
+	//Scatters the trees over the grass of the terrain texture map with a fixed seed, so every run places them the same way.
+	//Runs once the tree model and the mask have loaded, since the bounding spheres depend on the model. A tree density of d brings the trees
+	//1 / sqrt(d) times closer together, which scales their number by about d
+	std::vector<glm::mat4> positions;
+	InstanceBounds treeBounds;
+	std::vector<uint32_t> cameraTrees, lightTrees[MAX_SHADOW_CASCADES];
+	InstanceStream treeInstances;
+	bool treesPlaced = false;
+	auto placeTrees = [&]()
+	{
+		std::vector<uint8_t> treeDensity(treeMask.getSize().x * treeMask.getSize().y);
+		for (size_t i = 0; i < treeDensity.size(); i++)
+			treeDensity[i] = treeMask.getPixelsPtr()[i * 4 + 2];
+		ScatterSettings treeScatter;
+		treeScatter.seed = benchmark.treeSeed;
+		treeScatter.size = (float)terrain.size;
+		treeScatter.minDistance = 3.f / std::sqrt(benchmark.treeDensity);
+		treeScatter.maxSlope = glm::radians(35.f);
+		treeScatter.minScale = 1.8f;
+		treeScatter.maxScale = 2.2f;
+		treeScatter.densityMask = treeDensity.empty() ? nullptr : &treeDensity[0];
+		treeScatter.maskWidth = treeMask.getSize().x;
+		treeScatter.maskHeight = treeMask.getSize().y;
+		ScatterInstances trees;
+		sf::Clock scatterClock;
+		scatterInstances(treeScatter, [&terrain](float x, float z) { return getTerrainCollisionHeight(terrain, x, z); }, jobs, trees);
+		std::cout << "Scattered " << trees.x.size() << " trees in " << scatterClock.getElapsedTime().asSeconds() * 1000.f << "ms" << std::endl;
+
+		//Builds the model matrix and bounding sphere of every tree
+		size_t treeCount = trees.x.size();
+		positions.resize(treeCount);
+		glm::vec3 treeCenter = (treeOBJ.boundsMin + treeOBJ.boundsMax) * 0.5f;
+		float treeRadius = glm::length(treeOBJ.boundsMax - treeOBJ.boundsMin) * 0.5f;
+		for (size_t i = 0; i < treeCount; i++)
+		{
+			float bias = 0.5;
+			glm::vec3 pos = glm::vec3(trees.x[i], trees.y[i] - bias, trees.z[i]);
+			positions[i] = glm::translate(glm::mat4(1.f), pos);
+			positions[i] = glm::rotate(positions[i], trees.rotation[i], glm::vec3(0, 1, 0));
+			positions[i] = glm::scale(positions[i], glm::vec3(trees.scale[i]));
+			glm::vec3 center = glm::vec3(positions[i] * glm::vec4(treeCenter, 1.f));
+			addInstance(treeBounds, center, treeRadius * trees.scale[i]);
+			sceneBounds.max.y = std::max(sceneBounds.max.y, center.y + treeRadius * trees.scale[i]);
+		}
+		treesPlaced = true;
+	};
 
 	//Creates a new vao that only contains the vertices of a quad
 	VAOslot quadSlot;
@@ -498,172 +907,491 @@ int main()
 	quadSlot.vbo = genArrayVBO(sizeof(quadVertices), quadVertices);
 	GLuint quadVAO = genVAO(&quadSlot, 1);
 
-	//Defines the depth texture and its parameters for the depth render framebuffer
-	GLuint shadowResolution = 2048;
-	GLuint depthTexture;
-	glGenTextures(1, &depthTexture);
-	glBindTexture(GL_TEXTURE_2D, depthTexture);
-	float border[] = { 1.f, 1.f, 1.f, 1.f };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadowResolution, shadowResolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	//Sets up the depth render framebuffer. Most depth information in the scene is rendered to this buffer
-	GLuint framebuffer;
-	glGenFramebuffers(1, &framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	//Camera control variables
+	//Creates the cascaded shadow maps. More cascades or a higher resolution sharpen the shadows but cost more depth passes and fill.
+	//The static casters of a cascade are cached and only rendered again when the cascade moves or staticShadowVersion changes
+	CascadeSettings shadowSettings;
+	shadowSettings.count = 4;
+	shadowSettings.resolution = 2048;
+	shadowSettings.maxDistance = farPlane;
+	ShadowCache shadowCache;
+	genShadowCache(shadowCache, shadowSettings.resolution, shadowSettings.count);
+	uint32_t staticShadowVersion = 0;
+	bool shadowCacheEnabled = true;
+
+	//Draws are collected into a queue every frame, sorted by pass and state, and their state is set through a cache that skips redundant calls.
+	//Passes run in this order: one per shadow cascade, the scene, then the sun, which doesn't write depth and has to come after everything it can be behind
+	const uint32_t shadowPass = 0, scenePass = MAX_SHADOW_CASCADES, sunPass = scenePass + 1;
+	RenderQueue renderQueue;
+	GLStateCache stateCache;
+	initStateCache(stateCache, getGLBackend());
+
+	//Camera control variables. The camera is moved by the simulation thread, the renderer only sees the snapshots it publishes
 	CameraFP cameraFP(glm::vec3(20, 10, 20), 3.f);
 	cameraFP.setBounds(glm::vec2(0, terrain.size), glm::vec2(0, terrain.size));
-	glm::vec3 lightDir = glm::vec3(-0.2f, -1.0f, -0.3f);
+	glm::vec3 lightDir = glm::vec3(-11.f, -5.f, -11.f);
 	float g = 9.8f;
 	float v = 0.f;
 	bool onGround = false;
+	//Mouse movement has to be read on the window's thread. It is summed up every frame and handed to the next tick
+	std::mutex mouseMutex;
+	glm::vec2 mouseDelta(0.f);
 
 	sf::Clock clock; //Used for timing purposes
+	const size_t assetUploadBudget = 8 * 1024 * 1024; //Bytes of asset data uploaded per frame
+	bool firstFrame = true, assetsLoaded = false;
+	sf::Clock shaderWatchClock; //Shader files are checked for changes a few times a second
+
+	//Average CPU and GPU frame times are printed every few seconds. GPU times come from the profiler's draw timers, which are read a few frames late so reading them doesn't stall
+#ifdef PROFILER_ENABLED
+	initGpuProfiler();
+#endif
+	int timedFrames = 0;
+	float cpuFrameTime = 0.f, inputLatency = 0.f;
+	sf::Clock frameStatsClock;
+
+	//Benchmarks start with every asset in place so their frames don't depend on how fast the loader threads were. Frames are timed
+	//until the GPU has finished them, and the hash covers every frame
+	if (benchmarking)
+		assets.finish();
+	BenchmarkResults benchmarkResults;
+	sf::Clock benchmarkClock;
+	size_t frameIndex = 0;
+
+	//Input sampling, camera movement, gravity and terrain collision run on the simulation thread at a fixed tick rate. Interactive runs tick in
+	//real time, benchmarks step the simulation to the time of every frame, so the ticks and their input are the same whatever the frame rate
+	auto sampleInput = [&](uint64_t tick) -> CameraInput
+	{
+		if (benchmarking)
+			return tick < inputTrack.size() ? inputTrack[tick] : CameraInput();
+		glm::vec2 mouse;
+		{
+			std::lock_guard<std::mutex> lock(mouseMutex);
+			mouse = mouseDelta;
+			mouseDelta = glm::vec2(0.f);
+		}
+		CameraInput input = readCameraInput(mouse.x, mouse.y);
+		if (!benchmark.recordPath.empty())
+			recordedTrack.push_back(input);
+		return input;
+	};
+	auto stepCamera = [&](const CameraInput& input, float dt) -> CameraState
+	{
+		if (input.jump && onGround)
+		{
+			v = -g * 0.5;
+			onGround = false;
+		}
+
+		v += g * dt;
+		float terrainHeight;
+		{
+			PROFILE_SCOPE("Terrain collision");
+			terrainHeight = getTerrainCollisionHeight(terrain, cameraFP.getPosition().x, cameraFP.getPosition().z) + 3.f;
+		}
+		cameraFP.inputProc(input, dt);
+		cameraFP.move(0, -v * dt, 0);
+		if (cameraFP.getPosition().y < terrainHeight)
+		{
+			cameraFP.setPosition(cameraFP.getPosition().x, terrainHeight, cameraFP.getPosition().z);
+			onGround = true;
+		}
+		CameraState state;
+		state.position = cameraFP.getPosition();
+		state.front = cameraFP.getFront();
+		return state;
+	};
+	//Tick 0 is the camera before any input, facing where it does before the mouse first moves
+	CameraState initialCamera;
+	cameraFP.inputProc(CameraInput(), 0.f);
+	initialCamera.position = cameraFP.getPosition();
+	initialCamera.front = cameraFP.getFront();
+	Simulation simulation(benchmark.tickTime, !benchmarking, initialCamera, sampleInput, stepCamera);
+	CameraState camera = initialCamera;
+	//Benchmarks render frames dt apart on the simulation's clock, up to the first frame that shows the end of the track
+	uint64_t frameLength = (uint64_t)std::llround(benchmark.dt * 1e9);
+	uint64_t trackLength = inputTrack.size() * simulation.getTickLength();
+	size_t benchmarkFrames = (size_t)((trackLength + frameLength - 1) / frameLength) + 1;
 
 	//Game loop
-	while (window.isOpen())
+	while (benchmarking ? frameIndex < benchmarkFrames : window->isOpen())
 	{
+		PROFILE_SCOPE("Frame");
 		//Event loop -> Manages key presses and other window events
-		float dt = clock.restart().asSeconds();
+		float frameTime = clock.restart().asSeconds();
+		benchmarkClock.restart();
 		sf::Event event;
-		while (window.pollEvent(event))
+		while (window && window->pollEvent(event))
 		{
 			switch (event.type)
 			{
 			case sf::Event::Closed:
-				window.close();
+				window->close();
 				break;
 			case sf::Event::KeyReleased:
 				if (event.key.code == sf::Keyboard::Escape)
-					window.close();
+					window->close();
 				if (event.key.code == sf::Keyboard::Tab)
 					wireframe ^= 1; //Toggles wireframe mode if the tab key is released
+				if (event.key.code == sf::Keyboard::C)
+				{
+					shadowCacheEnabled ^= 1;
+					std::cout << "Shadow cache " << (shadowCacheEnabled ? "on" : "off") << std::endl;
+				}
+				if (event.key.code == sf::Keyboard::O)
+				{
+					occlusionCulling ^= 1;
+					std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+				}
+#ifdef PROFILER_ENABLED
+				//Writes the profile of the last frames as a Chrome trace and prints the percentiles of every timer
+				if (event.key.code == sf::Keyboard::P)
+				{
+					if (exportProfilerTrace("profile.json"))
+						std::cout << "Profile written to profile.json" << std::endl;
+					printProfilerSummary(std::cout);
+				}
+#endif
 				break;
 			case sf::Event::Resized:
-				window.setView(sf::View(sf::FloatRect(0, 0, event.size.width, event.size.height)));
+				window->setView(sf::View(sf::FloatRect(0, 0, event.size.width, event.size.height)));
 				glViewport(0, 0, event.size.width, event.size.height);
+				viewSize = sf::Vector2u(event.size.width, event.size.height);
+				computeLODRanges(terrain.lod, fieldOfView, (float)event.size.height, terrainPixelError);
+				break;
+			case sf::Event::MouseButtonPressed:
+				//Picks the terrain point in the center of the screen
+				if (event.mouseButton.button == sf::Mouse::Left)
+				{
+					RayHit hit = raycastHeightField(getHeightField(terrain), terrain.pyramid, camera.position, camera.front, 150.f);
+					if (hit.hit)
+						std::cout << "Picked terrain at (" << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << "), " << hit.distance << " units away" << std::endl;
+				}
 				break;
 			}
 		}
 
-		//Turns wireframe on or off
-		if (wireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		//Hot reloads every program whose shader files changed on disk
+		if (!benchmarking && shaderWatchClock.getElapsedTime().asSeconds() > 0.5f)
+		{
+			PROFILE_SCOPE("Shader reload");
+			shaderWatchClock.restart();
+			bool reloaded = false;
+			for (ShaderProgram* program : { &terrainShader, &floraShader, &basicShader, &depthPassShader, &depthPassInstShader })
+				reloaded |= reloadShaderProgram(*program);
+			if (reloaded)
+			{
+				setStaticUniforms();
+				invalidateStateCache(stateCache);
+			}
+		}
+
+		//Uploads the assets that finished decoding within the frame's budget. The trees are placed as soon as their model and mask are in
+		//Uploads bind textures and buffers, and setting the uniforms binds programs, so the state cache has to forget what it knew
+		size_t pendingAssets = assets.getPendingCount();
+		{
+			PROFILE_SCOPE("Asset uploads");
+			assets.uploadAssets(assetUploadBudget);
+		}
+		if (assets.getPendingCount() != pendingAssets)
+			invalidateStateCache(stateCache);
+		if (!treesPlaced && treeOBJ.state == AssetState::Ready && treeMaskState == AssetState::Ready)
+		{
+			placeTrees();
+			setStaticUniforms();
+			invalidateStateCache(stateCache);
+			staticShadowVersion++;
+		}
+		if (!assetsLoaded && assets.getPendingCount() == 0)
+		{
+			std::cout << "All assets loaded " << startupClock.getElapsedTime().asSeconds() * 1000.f << "ms after startup" << std::endl;
+			assetsLoaded = true;
+		}
+
+		//Hands the mouse movement to the simulation and places the camera between its two latest ticks. The view trails the simulation by a tick,
+		//so it never has to extrapolate. Benchmarks first step the simulation to the frame's time, interactive runs take whatever it has published
+		uint64_t renderTime;
+		if (benchmarking)
+		{
+			renderTime = frameIndex * frameLength;
+			simulation.advanceTo(std::min(renderTime / simulation.getTickLength(), (uint64_t)inputTrack.size()));
+		}
 		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		{
+			sf::Vector2i mousePos = sf::Mouse::getPosition(*window);
+			sf::Mouse::setPosition(sf::Vector2i(viewSize.x / 2, viewSize.y / 2), *window);
+			std::lock_guard<std::mutex> lock(mouseMutex);
+			mouseDelta.x += (mousePos.x - viewSize.x / 2.f) * 0.05f;
+			mouseDelta.y -= (mousePos.y - viewSize.y / 2.f) * 0.05f;
+			renderTime = getSimulationTime();
+		}
+		const SimulationSnapshot& snapshot = simulation.getSnapshot();
+		camera = interpolateCamera(snapshot, renderTime, simulation.getTickLength());
+		float aspect = viewSize.x / (float)viewSize.y;
+		glm::mat4 projection = glm::perspective(fieldOfView, aspect, nearPlane, farPlane);
+		glm::mat4 cameraView = glm::lookAt(camera.position, camera.position + camera.front, glm::vec3(0.f, 1.f, 0.f));
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		{
+			PROFILE_SCOPE("Fit cascades");
+			fitShadowCascades(shadowSettings, cameraView, fieldOfView, aspect, nearPlane, lightDir, sceneBounds, cascades);
+		}
 
-		//Camera controls and terrain collision detection
-		sf::Vector2i mousePos = sf::Mouse::getPosition(window);
-		float moffsetx = (mousePos.x - window.getSize().x / 2.f) * 0.05;
-		float moffsety = -(mousePos.y - window.getSize().y / 2.f) * 0.05;
-		sf::Mouse::setPosition(sf::Vector2i(window.getSize().x / 2, window.getSize().y / 2), window);
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space) && onGround)
+		FrameData frame;
+		frame.view = cameraView;
+		frame.projection = projection;
+		for (int i = 0; i < shadowCache.cascadeCount; i++)
 		{
-			v = -g * 0.5;
-			onGround = false;
+			frame.lightSpaceTransforms[i] = cascades[i].lightTransform;
+			frame.cascadeSplits[i] = i < shadowCache.cascadeCount - 1 ? cascades[i].splitDepth : FLT_MAX;
 		}
+		for (int i = shadowCache.cascadeCount; i < MAX_SHADOW_CASCADES; i++)
+			frame.cascadeSplits[i] = FLT_MAX;
+		frame.lightDirection = glm::vec4(lightDir, 0.f);
+		frame.cameraPos = glm::vec4(camera.position, 1.f);
+		updateFrameUniformBuffer(frameUniforms, frame);
 
-		v += g * dt;
-		float terrainHeight = getTerrainCollisionHeight(terrain, cameraFP.getPosition().x, cameraFP.getPosition().z) + 3.f;
-		glm::mat4 projection = glm::perspective(glm::radians(70.f), window.getSize().x / (float)window.getSize().y, 0.5f, 150.f);
-		cameraFP.inputProc(event, dt, moffsetx, moffsety);
-		cameraFP.move(0, -v * dt, 0);
-		if (cameraFP.getPosition().y < terrainHeight)
+		Frustum cameraFrustum = extractFrustum(projection * cameraView);
 		{
-			cameraFP.setPosition(cameraFP.getPosition().x, terrainHeight, cameraFP.getPosition().z);
-			onGround = true;
+			PROFILE_SCOPE("Terrain LOD");
+			selectTerrainLOD(terrain.lod, camera.position, cameraFrustum, cameraTerrain);
+		}
+
+		//The static shadow casters of a cascade are only selected and drawn when its cached layer is out of date. With the cache off they are drawn every
+		//frame with the camera's LODs, otherwise the terrain is drawn at full resolution so the cached layers don't depend on the camera
+		if (!shadowCacheEnabled)
+			invalidateShadowCache(shadowCache);
+		bool renderStaticShadows[MAX_SHADOW_CASCADES];
+		std::vector<const std::vector<uint32_t>*> treeLists;
+		for (int i = 0; i < shadowCache.cascadeCount; i++)
+		{
+			renderStaticShadows[i] = !isShadowCacheValid(shadowCache, i, cascades[i].lightTransform, staticShadowVersion);
+			if (renderStaticShadows[i])
+			{
+				Frustum lightFrustum = extractFrustum(cascades[i].lightTransform);
+				if (shadowCacheEnabled)
+					selectTerrainFullResolution(terrain.lod, lightFrustum, lightTerrain[i]);
+				else
+					selectTerrainLOD(terrain.lod, camera.position, lightFrustum, lightTerrain[i]);
+				cullInstances(lightFrustum, treeBounds, lightTrees[i]);
+			}
+			else
+				lightTrees[i].clear();
+			treeLists.push_back(&lightTrees[i]);
+		}
+
+		//Culls the trees for the camera and streams all visible lists into one instance buffer, the shadow casters of each cascade first
+		{
+			PROFILE_SCOPE("Tree culling");
+			cullInstances(cameraFrustum, treeBounds, cameraTrees);
+		}
+		size_t frustumTrees = cameraTrees.size();
+		if (occlusionCulling && !cameraTrees.empty())
+		{
+			PROFILE_SCOPE("Occlusion culling");
+			rasterizeOccluders(occlusionBuffer, projection * cameraView, terrainOccluder, jobs);
+			cullOccludedInstances(occlusionBuffer, treeBounds, jobs, cameraTrees);
+		}
+		frustumTreeCount += frustumTrees;
+		occludedTreeCount += frustumTrees - cameraTrees.size();
+		if (benchmarking && (int)frameIndex >= benchmark.warmupFrames)
+		{
+			benchmarkResults.frustumTrees += frustumTrees;
+			benchmarkResults.visibleTrees += cameraTrees.size();
+		}
+		treeLists.push_back(&cameraTrees);
+		{
+			PROFILE_SCOPE("Instance streaming");
+			streamInstances(treeInstances, positions.data(), treeLists);
 		}
-		cameraFP.activateView();
-		glm::mat4 cameraView = cameraFP.getView();
-
-		//Depth pass -> Renders the screen to the depth buffer for shadow mapping
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, shadowResolution, shadowResolution);
-		glUseProgram(depthPassShader);
-		glm::mat4 lightProj = glm::ortho(-80.f, 80.f, -80.f, 80.f, 2.f, 200.f);
-		glm::mat4 lightView = glm::lookAt(glm::vec3(110/1.1f, 50.f, 110 / 1.1f), glm::vec3(0), glm::vec3(0, 1, 0));
-		glUniformMatrix4fv(glGetUniformLocation(depthPassShader, "lightSpaceTransform"), 1, GL_FALSE, &(lightProj * lightView)[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(depthPassShader, "model"), 1, GL_FALSE, &terrainModel[0][0]);
-		drawTerrain(terrainTextures, terrain);
-		glCullFace(GL_FRONT);
-		glUseProgram(depthPassInstShader);
-		glUniformMatrix4fv(glGetUniformLocation(depthPassInstShader, "lightSpaceTransform"), 1, GL_FALSE, &(lightProj * lightView)[0][0]);
-		glBindVertexArray(treeOBJ.vao);
-		glDrawArraysInstanced(GL_TRIANGLES, 0, treeOBJ.vertexCount, 15);
-		glCullFace(GL_BACK);
+
+		//Depth pass -> Renders the static shadow casters of every out of date cascade to its cached layer
+		clearRenderQueue(renderQueue);
+		GLenum polygonMode = wireframe ? GL_LINE : GL_FILL;
+		size_t firstCameraTree = 0;
+		for (int i = 0; i < shadowCache.cascadeCount; i++)
+		{
+			if (renderStaticShadows[i])
+			{
+				glm::mat4 lightTransform = cascades[i].lightTransform;
+				setPassSetup(renderQueue, shadowPass + i, [&shadowCache, i, lightTransform, staticShadowVersion]() { beginStaticShadows(shadowCache, i, lightTransform, staticShadowVersion); });
+				DrawState terrainState = getTerrainDrawState(depthPassShader.id, nullptr, terrain);
+				terrainState.polygonMode = polygonMode;
+				addDraw(renderQueue, makeSortKey(shadowPass + i, depthPassShader.id, 0, terrain.patchVao), "Shadow terrain", terrainState, [&, i]()
+				{
+					glUniform1i(getUniformLocation(depthPassShader, "cascade"), i);
+					drawTerrainPatches(depthPassShader, terrain, lightTerrain[i]);
+				});
+				if (treesPlaced)
+				{
+					DrawState treeState;
+					treeState.program = depthPassInstShader.id;
+					treeState.vao = treeOBJ.vao;
+					treeState.polygonMode = polygonMode;
+					addDraw(renderQueue, makeSortKey(shadowPass + i, depthPassInstShader.id, 0, treeOBJ.vao), "Shadow trees", treeState, [&, i, firstCameraTree]()
+					{
+						glUniform1i(getUniformLocation(depthPassInstShader, "cascade"), i);
+						bindInstanceRange(treeOBJ.vao, treeInstances, firstCameraTree);
+						glDrawElementsInstanced(GL_TRIANGLES, treeOBJ.indexCount, treeOBJ.indexType, (void*)0, lightTrees[i].size());
+					});
+				}
+			}
+			firstCameraTree += lightTrees[i].size();
+		}
+
+		//Moving casters would be drawn after beginDynamicShadows and read from the dynamic map, which it creates on first use. Nothing in the scene moves, so the
+		//static map is read directly and the dynamic map is never allocated
+		GLuint shadowMap = shadowCache.staticMap;
 
 		//Render pass -> Renders the scene to the screen
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, window.getSize().x, window.getSize().y);
+		setPassSetup(renderQueue, scenePass, [&benchmarkTarget, viewSize]()
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, benchmarkTarget.framebuffer);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glViewport(0, 0, viewSize.x, viewSize.y);
+		});
 
 		//Renders the terrain
-		glUseProgram(terrainShader);
-		glUniformMatrix4fv(glGetUniformLocation(terrainShader, "projection"), 1, GL_FALSE, &projection[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(terrainShader, "view"), 1, GL_FALSE, &cameraView[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(terrainShader, "model"), 1, GL_FALSE, &terrainModel[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(terrainShader, "lightSpaceTransform"), 1, GL_FALSE, &(lightProj* lightView)[0][0]);
-		glUniform1i(glGetUniformLocation(terrainShader, "terrainSize"), terrain.size);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
-		drawTerrain(terrainTextures, terrain);
+		DrawState terrainState = getTerrainDrawState(terrainShader.id, &terrainMaterials, terrain);
+		terrainState.textureTargets[4] = GL_TEXTURE_2D_ARRAY;
+		terrainState.textures[4] = shadowMap;
+		terrainState.polygonMode = polygonMode;
+		addDraw(renderQueue, makeSortKey(scenePass, terrainShader.id, terrainMaterials.layers, terrain.patchVao), "Terrain", terrainState, [&]()
+		{
+			drawTerrainPatches(terrainShader, terrain, cameraTerrain);
+		});
 
 		//Draws all of the treees
-		glEnable(GL_CULL_FACE);
-		glUseProgram(floraShader);
-		glUniformMatrix4fv(glGetUniformLocation(floraShader, "projection"), 1, GL_FALSE, &projection[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(floraShader, "view"), 1, GL_FALSE, &cameraView[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(floraShader, "model"), 1, GL_FALSE, &treeModel[0][0]);
-		glUniformMatrix4fv(glGetUniformLocation(floraShader, "lightSpaceTransform"), 1, GL_FALSE, &(lightProj* lightView)[0][0]);
-		glUniform3fv(glGetUniformLocation(floraShader, "lightDirection"), 1, &lightDir[0]);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, treeTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
-		glBindVertexArray(treeOBJ.vao);
-		glDrawArraysInstanced(GL_TRIANGLES, 0, treeOBJ.vertexCount, 15);
-		glDisable(GL_CULL_FACE);
+		if (treesPlaced)
+		{
+			DrawState treeState;
+			treeState.program = floraShader.id;
+			treeState.vao = treeOBJ.vao;
+			treeState.textureTargets[0] = GL_TEXTURE_2D;
+			treeState.textures[0] = treeTexture.texture;
+			treeState.textureTargets[1] = GL_TEXTURE_2D_ARRAY;
+			treeState.textures[1] = shadowMap;
+			treeState.cullFace = GL_BACK;
+			treeState.polygonMode = polygonMode;
+			addDraw(renderQueue, makeSortKey(scenePass, floraShader.id, treeTexture.texture, treeOBJ.vao), "Trees", treeState, [&, firstCameraTree]()
+			{
+				bindInstanceRange(treeOBJ.vao, treeInstances, firstCameraTree);
+				glDrawElementsInstanced(GL_TRIANGLES, treeOBJ.indexCount, treeOBJ.indexType, (void*)0, cameraTrees.size());
+			});
+		}
 
 		//Renders the sun
-		glDepthMask(GL_FALSE);
-		glUseProgram(basicShader);
-		glm::mat4 proj = projection * cameraView * glm::scale(
-			glm::rotate(
-				glm::translate(
-					glm::mat4(1.f),
-					glm::vec3(110, 50.f, 110)),
-				glm::radians(45.f),
-				glm::vec3(0, 1, 0)
-			),
-			glm::vec3(30, 30, 1));
-		glUniformMatrix4fv(glGetUniformLocation(basicShader, "proj"), 1, GL_FALSE, &proj[0][0]);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, sunTexture);
-		glBindVertexArray(quadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDepthMask(GL_TRUE);
+		DrawState sunState;
+		sunState.program = basicShader.id;
+		sunState.vao = quadVAO;
+		sunState.textureTargets[0] = GL_TEXTURE_2D;
+		sunState.textures[0] = sunTexture.texture;
+		sunState.depthWrite = false;
+		sunState.polygonMode = polygonMode;
+		addDraw(renderQueue, makeSortKey(sunPass, basicShader.id, sunTexture.texture, quadVAO), "Sun", sunState, []()
+		{
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		});
+
+		{
+			PROFILE_SCOPE("Render queue");
+			executeRenderQueue(renderQueue, stateCache);
+		}
 		
 		/*
 		 * Renders the depth map to the screen
 		basicShader2.bind();
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, depthTexture);
+		glBindTexture(GL_TEXTURE_2D, shadowMap);
 		glBindVertexArray(depthQuadVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		*/
 
-		window.display();
+		if (window)
+		{
+			PROFILE_SCOPE("Display");
+			window->display();
+		}
+		else
+		{
+			glFinish();
+			if ((int)frameIndex >= benchmark.warmupFrames)
+				benchmarkResults.frameTimes.push_back(benchmarkClock.getElapsedTime().asSeconds());
+		}
+		//Input to photon latency of the newest input the frame shows. The initial snapshot has no input
+		float frameLatency = snapshot.tick ? (getSimulationTime() - snapshot.inputTime) / 1e9f : 0.f;
+		if (benchmarking && (int)frameIndex >= benchmark.warmupFrames && snapshot.tick)
+			benchmarkResults.inputLatencies.push_back(frameLatency);
+#ifdef PROFILER_ENABLED
+		endProfilerFrame();
+		if (benchmarking && (int)frameIndex + 1 == benchmark.warmupFrames)
+			clearProfilerHistory();
+#endif
+		if (benchmarking)
+		{
+			PROFILE_SCOPE("Image hash");
+			hashBenchmarkTarget(benchmarkTarget, benchmarkResults.imageHash);
+		}
+		frameIndex++;
+
+		timedFrames++;
+		cpuFrameTime += frameTime;
+		inputLatency += frameLatency;
+		if (frameStatsClock.getElapsedTime().asSeconds() > 2.f)
+		{
+			std::cout << "Frame time: " << cpuFrameTime / timedFrames * 1000.f << "ms CPU, "
+#ifdef PROFILER_ENABLED
+				<< takeGpuFrameTime() * 1000.f << "ms GPU, "
+#endif
+				<< inputLatency / timedFrames * 1000.f << "ms input latency, "
+				<< occludedTreeCount / timedFrames << " of " << frustumTreeCount / timedFrames << " trees in view occluded, "
+				<< "shadow cache " << (shadowCacheEnabled ? "on" : "off") << ", " << stateCache.issuedCalls / timedFrames << " state changes and "
+				<< stateCache.skippedCalls / timedFrames << " skipped per frame" << std::endl;
+			frameStatsClock.restart();
+			stateCache.issuedCalls = stateCache.skippedCalls = 0;
+			timedFrames = 0;
+			cpuFrameTime = inputLatency = 0.f;
+			frustumTreeCount = occludedTreeCount = 0;
+		}
+
+		if (firstFrame)
+		{
+			std::cout << "First frame " << startupClock.getElapsedTime().asSeconds() * 1000.f << "ms after startup" << std::endl;
+			firstFrame = false;
+		}
+	}
+
+	//The simulation thread writes the recorded track and the final hash
+	simulation.stop();
+	if (!benchmark.recordPath.empty())
+	{
+		if (saveInputTrack(benchmark.recordPath, recordedTrack))
+			std::cout << "Recorded " << recordedTrack.size() << " ticks of input to " << benchmark.recordPath << std::endl;
+		else
+			std::cout << "Failed to write the input track " << benchmark.recordPath << std::endl;
+	}
+	if (benchmarking)
+	{
+		benchmarkResults.treeCount = positions.size();
+		const SimulationSnapshot& lastSnapshot = simulation.getSnapshot();
+		benchmarkResults.ticks = lastSnapshot.tick;
+		benchmarkResults.simulationHash = lastSnapshot.stateHash;
+		std::string imageHash = formatImageHash(benchmarkResults.imageHash);
+		std::string simulationHash = formatImageHash(benchmarkResults.simulationHash);
+		if (writeBenchmarkReport(benchmark, benchmarkResults))
+			std::cout << "Benchmark report written to " << benchmark.reportPath << ", image hash " << imageHash << ", simulation hash " << simulationHash << std::endl;
+		else
+			std::cout << "Failed to write the benchmark report " << benchmark.reportPath << std::endl;
+		bool mismatch = false;
+		if (!benchmark.expectedHash.empty() && benchmark.expectedHash != imageHash)
+		{
+			std::cout << "Image hash mismatch: expected " << benchmark.expectedHash << ", rendered " << imageHash << std::endl;
+			mismatch = true;
+		}
+		if (!benchmark.expectedSimulationHash.empty() && benchmark.expectedSimulationHash != simulationHash)
+		{
+			std::cout << "Simulation hash mismatch: expected " << benchmark.expectedSimulationHash << ", simulated " << simulationHash << std::endl;
+			mismatch = true;
+		}
+		if (mismatch)
+			return BENCHMARK_HASH_MISMATCH;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include "HeightField.h"
+#include "SyntheticData.h"
+
+//The SIMD paths of sampleHeights are checked against the scalar one it falls back to for the last few positions. One position at a time always takes
+//the scalar path. Heights, normal components and slopes have to agree within TOLERANCE
+
+namespace
+{
+	const int SAMPLES = 64;
+	const float FIELD_SIZE = 50.f;
+	const float TOLERANCE = 1e-5f;
+
+	struct Queries
+	{
+		std::vector<float> x, z;
+
+		void add(float px, float pz)
+		{
+			x.push_back(px);
+			z.push_back(pz);
+		}
+	};
+
+	//Random points over the field and past its edges, then the edges and corners themselves in an order that puts them in SIMD lanes and in the tail
+	Queries makeQueries()
+	{
+		Queries queries;
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> inside(0.f, FIELD_SIZE), outside(-10.f, FIELD_SIZE + 10.f);
+		for (int i = 0; i < 1000; i++)
+			queries.add(inside(random), inside(random));
+		for (int i = 0; i < 200; i++)
+			queries.add(outside(random), outside(random));
+		const float edges[] = { 0.f, FIELD_SIZE, -1.f, FIELD_SIZE + 1.f, -1e6f, 1e6f, FIELD_SIZE * 0.5f, std::nextafter(FIELD_SIZE, 0.f) };
+		for (float x : edges)
+		{
+			for (float z : edges)
+				queries.add(x, z);
+		}
+		//Exactly on sample rows and columns, where cells meet
+		for (int i = 0; i <= SAMPLES; i += 7)
+			queries.add(i * FIELD_SIZE / SAMPLES, (SAMPLES - i) * FIELD_SIZE / SAMPLES);
+		queries.add(1.f, 2.f);
+		return queries;
+	}
+
+	void expectNear(const glm::vec3& a, const glm::vec3& b, size_t index)
+	{
+		EXPECT_NEAR(a.x, b.x, TOLERANCE) << "position " << index;
+		EXPECT_NEAR(a.y, b.y, TOLERANCE) << "position " << index;
+		EXPECT_NEAR(a.z, b.z, TOLERANCE) << "position " << index;
+	}
+}
+
+TEST(HeightField, BatchMatchesScalar)
+{
+	std::vector<float> heights = makeTerrainHeights(SAMPLES);
+	HeightField field = { heights.data(), SAMPLES, FIELD_SIZE };
+	Queries queries = makeQueries();
+	size_t count = queries.x.size();
+	ASSERT_NE(count % 8, 0u);
+
+	std::vector<float> batchHeights(count), batchSlopes(count);
+	std::vector<glm::vec3> batchNormals(count);
+	sampleHeights(field, queries.x.data(), queries.z.data(), count, batchHeights.data(), batchNormals.data(), batchSlopes.data());
+	for (size_t i = 0; i < count; i++)
+	{
+		float height, slope;
+		glm::vec3 normal;
+		sampleHeights(field, &queries.x[i], &queries.z[i], 1, &height, &normal, &slope);
+		EXPECT_NEAR(batchHeights[i], height, TOLERANCE) << "position " << i;
+		EXPECT_NEAR(batchHeights[i], sampleHeight(field, queries.x[i], queries.z[i]), TOLERANCE) << "position " << i;
+		EXPECT_NEAR(batchSlopes[i], slope, TOLERANCE) << "position " << i;
+		expectNear(batchNormals[i], normal, i);
+	}
+
+	//Heights alone take the same path
+	std::vector<float> heightsOnly(count);
+	sampleHeights(field, queries.x.data(), queries.z.data(), count, heightsOnly.data());
+	EXPECT_EQ(heightsOnly, batchHeights);
+}
+
+TEST(HeightField, ClampsToEdges)
+{
+	std::vector<float> heights = makeTerrainHeights(SAMPLES);
+	HeightField field = { heights.data(), SAMPLES, FIELD_SIZE };
+	int last = SAMPLES * (SAMPLES + 1);
+	EXPECT_NEAR(sampleHeight(field, 0.f, 0.f), heights[0], TOLERANCE);
+	EXPECT_NEAR(sampleHeight(field, -5.f, -5.f), heights[0], TOLERANCE);
+	EXPECT_NEAR(sampleHeight(field, FIELD_SIZE, FIELD_SIZE), heights[last + SAMPLES], TOLERANCE);
+	EXPECT_NEAR(sampleHeight(field, 1e6f, 1e6f), heights[last + SAMPLES], TOLERANCE);
+	EXPECT_NEAR(sampleHeight(field, FIELD_SIZE + 3.f, 0.f), heights[SAMPLES], TOLERANCE);
+	EXPECT_NEAR(sampleHeight(field, 0.f, FIELD_SIZE + 3.f), heights[last], TOLERANCE);
+}
+
+TEST(HeightField, PlaneIsExact)
+{
+	//Every triangle of a plane is the plane, so heights, normals and slopes are known everywhere inside the field
+	const float gradientX = 0.3f, gradientZ = -0.2f;
+	std::vector<float> heights((SAMPLES + 1) * (SAMPLES + 1));
+	for (int z = 0; z <= SAMPLES; z++)
+	{
+		for (int x = 0; x <= SAMPLES; x++)
+			heights[z * (SAMPLES + 1) + x] = 4.f + (gradientX * x + gradientZ * z) * FIELD_SIZE / SAMPLES;
+	}
+	HeightField field = { heights.data(), SAMPLES, FIELD_SIZE };
+	std::vector<float> x, z;
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> inside(0.f, FIELD_SIZE);
+	for (int i = 0; i < 101; i++)
+	{
+		x.push_back(inside(random));
+		z.push_back(inside(random));
+	}
+	std::vector<float> sampled(x.size()), slopes(x.size());
+	std::vector<glm::vec3> normals(x.size());
+	sampleHeights(field, x.data(), z.data(), x.size(), sampled.data(), normals.data(), slopes.data());
+	glm::vec3 normal = glm::normalize(glm::vec3(-gradientX, 1.f, -gradientZ));
+	for (size_t i = 0; i < x.size(); i++)
+	{
+		EXPECT_NEAR(sampled[i], 4.f + gradientX * x[i] + gradientZ * z[i], 1e-4f) << "position " << i;
+		EXPECT_NEAR(slopes[i], std::sqrt(gradientX * gradientX + gradientZ * gradientZ), TOLERANCE) << "position " << i;
+		expectNear(normals[i], normal, i);
+	}
+}
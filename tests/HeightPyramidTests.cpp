@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include "HeightPyramid.h"
+#include "SyntheticData.h"
+
+namespace
+{
+	const float FIELD_SIZE = 50.f;
+	const float MAX_DISTANCE = 150.f;
+
+	//Closest hit over both triangles of every cell, split like the terrain is drawn
+	RayHit raycastBruteForce(const HeightField& field, const glm::vec3& origin, const glm::vec3& direction)
+	{
+		RayHit closest;
+		closest.distance = FLT_MAX;
+		float cellSize = field.size / field.samples;
+		int stride = field.samples + 1;
+		for (int z = 0; z < field.samples; z++)
+		{
+			for (int x = 0; x < field.samples; x++)
+			{
+				const float* corner = field.heights + z * stride + x;
+				glm::vec3 p00(x * cellSize, corner[0], z * cellSize);
+				glm::vec3 p10((x + 1) * cellSize, corner[1], z * cellSize);
+				glm::vec3 p01(x * cellSize, corner[stride], (z + 1) * cellSize);
+				glm::vec3 p11((x + 1) * cellSize, corner[stride + 1], (z + 1) * cellSize);
+				const glm::vec3* triangles[2][3] = { { &p00, &p01, &p10 }, { &p10, &p01, &p11 } };
+				for (const auto& triangle : triangles)
+				{
+					glm::vec3 edge1 = *triangle[1] - *triangle[0], edge2 = *triangle[2] - *triangle[0];
+					glm::vec3 p = glm::cross(direction, edge2);
+					float determinant = glm::dot(edge1, p);
+					if (std::fabs(determinant) < 1e-12f)
+						continue;
+					glm::vec3 s = origin - *triangle[0];
+					float u = glm::dot(s, p) / determinant;
+					glm::vec3 q = glm::cross(s, edge1);
+					float v = glm::dot(direction, q) / determinant;
+					float t = glm::dot(edge2, q) / determinant;
+					if (u >= 0.f && v >= 0.f && u + v <= 1.f && t >= 0.f && t <= MAX_DISTANCE && t < closest.distance)
+					{
+						closest.hit = true;
+						closest.distance = t;
+					}
+				}
+			}
+		}
+		return closest;
+	}
+
+	void expectMatchesBruteForce(int samples)
+	{
+		std::vector<float> heights = makeTerrainHeights(samples);
+		HeightField field = { heights.data(), samples, FIELD_SIZE };
+		HeightPyramid pyramid;
+		buildHeightPyramid(field, pyramid);
+
+		std::mt19937 random(samples);
+		std::uniform_real_distribution<float> position(-10.f, FIELD_SIZE + 10.f), height(0.f, 6.f), component(-1.f, 1.f);
+		int hits = 0;
+		for (int i = 0; i < 1000; i++)
+		{
+			glm::vec3 origin(position(random), height(random), position(random));
+			glm::vec3 direction = glm::normalize(glm::vec3(component(random), component(random) * 0.5f - 0.2f, component(random)));
+			//Straight down and axis aligned rays, where the inverse direction is infinite
+			if (i % 50 == 0)
+				direction = glm::vec3(0.f, -1.f, 0.f);
+			else if (i % 50 == 1)
+				direction = glm::vec3(1.f, 0.f, 0.f);
+			RayHit expected = raycastBruteForce(field, origin, direction);
+			RayHit hit = raycastHeightField(field, pyramid, origin, direction, MAX_DISTANCE);
+			ASSERT_EQ(hit.hit, expected.hit) << samples << " samples, ray " << i;
+			if (!hit.hit)
+				continue;
+			hits++;
+			EXPECT_NEAR(hit.distance, expected.distance, 1e-3f) << samples << " samples, ray " << i;
+			EXPECT_NEAR(glm::length(hit.position - (origin + direction * expected.distance)), 0.f, 1e-3f) << samples << " samples, ray " << i;
+			EXPECT_NEAR(glm::length(hit.normal), 1.f, 1e-4f);
+		}
+		//Enough of both to mean something
+		EXPECT_GT(hits, 200);
+		EXPECT_LT(hits, 1000);
+	}
+}
+
+TEST(HeightPyramid, MatchesBruteForce)
+{
+	expectMatchesBruteForce(64);
+}
+
+TEST(HeightPyramid, MatchesBruteForceOnOddSizes)
+{
+	//Leaves on the last row and column only cover one cell, and levels aren't powers of two
+	expectMatchesBruteForce(37);
+	expectMatchesBruteForce(50);
+}
+
+TEST(HeightPyramid, RootBoundsAllHeights)
+{
+	std::vector<float> heights = makeTerrainHeights(37);
+	HeightField field = { heights.data(), 37, FIELD_SIZE };
+	HeightPyramid pyramid;
+	buildHeightPyramid(field, pyramid);
+	ASSERT_EQ(pyramid.levels.back().bounds.size(), 1u);
+	glm::vec2 root = pyramid.levels.back().bounds[0];
+	EXPECT_EQ(root.x, *std::min_element(heights.begin(), heights.end()));
+	EXPECT_EQ(root.y, *std::max_element(heights.begin(), heights.end()));
+}
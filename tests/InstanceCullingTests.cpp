@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <random>
+#include "InstanceCulling.h"
+
+namespace
+{
+	//Instances spread around the frustum so a good share is on either side of every plane
+	InstanceBounds makeInstances(size_t count)
+	{
+		std::mt19937 random((uint32_t)count);
+		std::uniform_real_distribution<float> position(-60.f, 60.f), radius(0.f, 3.f);
+		InstanceBounds bounds;
+		for (size_t i = 0; i < count; i++)
+			addInstance(bounds, glm::vec3(position(random), position(random) * 0.2f, position(random)), radius(random));
+		return bounds;
+	}
+
+	Frustum getFrustum()
+	{
+		glm::mat4 view = glm::lookAt(glm::vec3(0.f, 3.f, 0.f), glm::vec3(10.f, 1.f, 4.f), glm::vec3(0.f, 1.f, 0.f));
+		return extractFrustum(glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.5f, 40.f) * view);
+	}
+}
+
+TEST(InstanceCulling, MatchesScalarReference)
+{
+	Frustum frustum = getFrustum();
+	//Counts that leave every possible tail behind the 4 and 8 wide loops
+	for (size_t count : { 0, 1, 3, 4, 5, 7, 8, 9, 13, 15, 17, 1001, 10007 })
+	{
+		InstanceBounds bounds = makeInstances(count);
+		std::vector<uint32_t> expected;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (isSphereVisible(frustum, bounds.x[i], bounds.y[i], bounds.z[i], bounds.radius[i]))
+				expected.push_back((uint32_t)i);
+		}
+		std::vector<uint32_t> visible;
+		EXPECT_EQ(cullInstances(frustum, bounds, visible), expected.size()) << count << " instances";
+		EXPECT_EQ(visible, expected) << count << " instances";
+	}
+}
+
+TEST(InstanceCulling, SpheresTouchingPlanes)
+{
+	//Spheres whose surface lies on the near plane are kept, ones just past it are culled
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	Frustum frustum = extractFrustum(glm::perspective(glm::radians(90.f), 1.f, 1.f, 10.f) * view);
+	InstanceBounds bounds;
+	for (int i = 0; i < 9; i++)
+		addInstance(bounds, glm::vec3(0.f, 0.f, -0.5f + i * 0.25f), 0.5f);
+	std::vector<uint32_t> visible;
+	cullInstances(frustum, bounds, visible);
+	for (size_t i = 0; i < bounds.x.size(); i++)
+	{
+		bool kept = std::find(visible.begin(), visible.end(), (uint32_t)i) != visible.end();
+		EXPECT_EQ(kept, isSphereVisible(frustum, bounds.x[i], bounds.y[i], bounds.z[i], bounds.radius[i])) << "sphere " << i;
+	}
+	EXPECT_FALSE(visible.empty());
+	EXPECT_LT(visible.size(), bounds.x.size());
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <GL/glew.h>
+#include <cstring>
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "OBJLoader.h"
+#include "SyntheticData.h"
+
+namespace
+{
+	const VertexFormat floatFormat = { PositionFormat::Float, NormalFormat::Float, UVFormat::Float };
+	const SourceStamp stamp = { 1234, 5678 };
+
+	//Parses and indexes a synthetic grid the way the demo loads an .obj
+	IndexedMesh makeGridMesh(int quads)
+	{
+		std::string text = makeGridOBJ(quads);
+		OBJMesh mesh;
+		EXPECT_TRUE(parseOBJ(text.data(), text.size(), mesh));
+		std::vector<Vertex> vertices;
+		std::vector<Normal> normals;
+		std::vector<UV> uvs;
+		expandOBJ(mesh, vertices, normals, uvs);
+		IndexedMesh indexed;
+		buildIndexedMesh(vertices, normals, uvs, indexed);
+		return indexed;
+	}
+
+	BakedMeshHeader& getHeader(std::vector<char>& baked)
+	{
+		return *(BakedMeshHeader*)baked.data();
+	}
+}
+
+TEST(MeshCache, RoundTripMatchesIndexedMesh)
+{
+	IndexedMesh indexed = makeGridMesh(16);
+	std::vector<char> baked;
+	bakeMesh(indexed, floatFormat, stamp, baked);
+	BakedMeshView view;
+	ASSERT_TRUE(readBakedMesh(baked.data(), baked.size(), stamp, floatFormat, view));
+
+	const BakedMeshHeader& header = *view.header;
+	ASSERT_EQ(header.vertexCount, indexed.vertices.size());
+	ASSERT_EQ(header.indexCount, indexed.indices.size());
+	ASSERT_EQ(header.indexType, (uint32_t)GL_UNSIGNED_SHORT);
+	const uint16_t* indices = (const uint16_t*)view.indexData;
+	for (size_t i = 0; i < indexed.indices.size(); i++)
+		ASSERT_EQ(indices[i], indexed.indices[i]) << "index " << i;
+
+	//Float vertices are stored as they are, position, normal and uv interleaved
+	const float* vertices = (const float*)view.vertexData;
+	for (size_t v = 0; v < indexed.vertices.size(); v++, vertices += 8)
+	{
+		const Vertex& position = indexed.vertices[v];
+		const Normal& normal = indexed.normals[v];
+		const UV& uv = indexed.uvs[v];
+		float expected[8] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.u, uv.v };
+		ASSERT_EQ(memcmp(vertices, expected, sizeof(expected)), 0) << "vertex " << v;
+	}
+}
+
+TEST(MeshCache, LargeMeshesUseIntIndices)
+{
+	IndexedMesh indexed = makeGridMesh(256);
+	ASSERT_GT(indexed.vertices.size(), 0xFFFFu);
+	std::vector<char> baked;
+	bakeMesh(indexed, floatFormat, stamp, baked);
+	BakedMeshView view;
+	ASSERT_TRUE(readBakedMesh(baked.data(), baked.size(), stamp, floatFormat, view));
+	EXPECT_EQ(view.header->indexType, (uint32_t)GL_UNSIGNED_INT);
+	EXPECT_EQ(memcmp(view.indexData, indexed.indices.data(), indexed.indices.size() * sizeof(uint32_t)), 0);
+}
+
+TEST(MeshCache, RejectsStaleOrOtherFormat)
+{
+	IndexedMesh indexed = makeGridMesh(4);
+	std::vector<char> baked;
+	bakeMesh(indexed, floatFormat, stamp, baked);
+	BakedMeshView view;
+	EXPECT_FALSE(readBakedMesh(baked.data(), baked.size(), { stamp.size + 1, stamp.time }, floatFormat, view));
+	EXPECT_FALSE(readBakedMesh(baked.data(), baked.size(), stamp, { PositionFormat::Unorm16, NormalFormat::Float, UVFormat::Float }, view));
+}
+
+TEST(MeshCache, RejectsCorruptFiles)
+{
+	IndexedMesh indexed = makeGridMesh(4);
+	std::vector<char> original;
+	bakeMesh(indexed, floatFormat, stamp, original);
+	BakedMeshView view;
+
+	//Each case corrupts a fresh copy, which has to be rejected
+	auto isRejected = [&](void (*corrupt)(std::vector<char>& baked))
+	{
+		std::vector<char> baked = original;
+		corrupt(baked);
+		return !readBakedMesh(baked.data(), baked.size(), stamp, floatFormat, view);
+	};
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { baked.resize(baked.size() - 1); }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { baked.resize(sizeof(BakedMeshHeader) - 1); }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).vertexCount++; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).vertexBytes -= 4; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).indexCount++; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).indexBytes -= 2; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).indexType = GL_UNSIGNED_BYTE; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).attributeCount = 7; }));
+	//Offsets that only pass a bounds check by wrapping around
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).indexBytes = ~(uint64_t)0 - 15; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).vertexOffset = ~(uint64_t)0 - 15; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked)
+	{
+		VertexAttribute* attributes = (VertexAttribute*)(baked.data() + sizeof(BakedMeshHeader));
+		attributes[1].offset = attributes[1].stride;
+	}));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked)
+	{
+		uint16_t* indices = (uint16_t*)(baked.data() + getHeader(baked).indexOffset);
+		indices[3] = (uint16_t)getHeader(baked).vertexCount;
+	}));
+}
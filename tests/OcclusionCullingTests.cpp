@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include "HeightPyramid.h"
+#include "OcclusionCulling.h"
+#include "SyntheticData.h"
+
+namespace
+{
+	const int SAMPLES = 256;
+	const float TERRAIN_SIZE = 50.f;
+	const float TREE_RADIUS = 1.5f;
+
+	//Hills twice as steep as the occlusion benchmarks', so a good share of the trees is hidden
+	std::vector<float> makeHillyHeights()
+	{
+		std::vector<float> heights = makeTerrainHeights(SAMPLES);
+		for (float& height : heights)
+			height *= 8.f;
+		return heights;
+	}
+
+	//True if a ray from the eye reaches a point of the sphere that lies in the frustum. The points cover the disk through the center facing the eye
+	bool isSphereSeen(const HeightField& field, const HeightPyramid& pyramid, const Frustum& frustum, const glm::vec3& eye, const glm::vec3& center, float radius)
+	{
+		glm::vec3 forward = glm::normalize(center - eye);
+		glm::vec3 right = glm::normalize(glm::cross(forward, std::fabs(forward.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)));
+		glm::vec3 up = glm::cross(right, forward);
+		for (float ring : { 0.f, 0.5f, 0.95f })
+		{
+			for (int step = 0; step < (ring > 0.f ? 12 : 1); step++)
+			{
+				float angle = step * 6.2831853f / 12.f;
+				glm::vec3 point = center + (right * std::cos(angle) + up * std::sin(angle)) * (ring * radius);
+				if (!isSphereVisible(frustum, point.x, point.y, point.z, 0.f))
+					continue;
+				float distance = glm::length(point - eye);
+				RayHit hit = raycastHeightField(field, pyramid, eye, (point - eye) / distance, distance);
+				if (!hit.hit)
+					return true;
+			}
+		}
+		return false;
+	}
+}
+
+//Every tree the occlusion buffer removes has to be hidden from every ray the terrain's triangles allow. The ray casts are checked against brute force
+//in HeightPyramidTests
+TEST(OcclusionCulling, NeverCullsASeenTree)
+{
+	std::vector<float> heights = makeHillyHeights();
+	HeightField field = { heights.data(), SAMPLES, TERRAIN_SIZE };
+	HeightPyramid pyramid;
+	buildHeightPyramid(field, pyramid);
+	OccluderMesh occluder;
+	buildTerrainOccluder(field, 64, occluder);
+
+	std::vector<glm::vec3> points = makeRandomPoints(4000, glm::vec3(0.f), glm::vec3(TERRAIN_SIZE, 0.f, TERRAIN_SIZE));
+	InstanceBounds bounds;
+	for (const glm::vec3& point : points)
+		addInstance(bounds, glm::vec3(point.x, sampleHeight(field, point.x, point.z) + TREE_RADIUS, point.z), TREE_RADIUS);
+
+	JobSystem jobs(4);
+	OcclusionBuffer buffer;
+	initOcclusionBuffer(buffer, 256, 144);
+	glm::mat4 projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.5f, 150.f);
+	size_t culledTrees = 0;
+	const glm::vec3 positions[][2] = { { glm::vec3(20.f, 0.f, 20.f), glm::vec3(45.f, 0.f, 40.f) }, { glm::vec3(40.f, 0.f, 8.f), glm::vec3(10.f, 0.f, 30.f) },
+		{ glm::vec3(5.f, 0.f, 45.f), glm::vec3(30.f, 0.f, 5.f) } };
+	for (const auto& position : positions)
+	{
+		glm::vec3 eye = position[0], target = position[1];
+		eye.y = sampleHeight(field, eye.x, eye.z) + 1.5f;
+		target.y = eye.y;
+		glm::mat4 viewProjection = projection * glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f));
+		Frustum frustum = extractFrustum(viewProjection);
+
+		std::vector<uint32_t> inFrustum, visible;
+		cullInstances(frustum, bounds, inFrustum);
+		visible = inFrustum;
+		rasterizeOccluders(buffer, viewProjection, occluder, jobs);
+		cullOccludedInstances(buffer, bounds, jobs, visible);
+
+		//Both lists keep the order of bounds, so the culled trees are the ones missing from visible
+		std::vector<uint32_t> culled;
+		std::set_difference(inFrustum.begin(), inFrustum.end(), visible.begin(), visible.end(), std::back_inserter(culled));
+		for (uint32_t index : culled)
+		{
+			glm::vec3 center(bounds.x[index], bounds.y[index], bounds.z[index]);
+			EXPECT_FALSE(isSphereSeen(field, pyramid, frustum, eye, center, bounds.radius[index])) << "Tree " << index << " at " << center.x << ", " << center.z;
+		}
+		culledTrees += culled.size();
+	}
+	//The test only means something if the hills hide a good share of the trees
+	EXPECT_GT(culledTrees, 1000u);
+}
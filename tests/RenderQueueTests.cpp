@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "RenderQueue.h"
+
+namespace
+{
+	//Every call the recording backend received, the draws and pass setups of a queue log themselves in between
+	std::vector<std::string> calls;
+
+	std::string call(const char* function, GLuint a)
+	{
+		return std::string(function) + " " + std::to_string(a);
+	}
+
+	std::string call(const char* function, GLuint a, GLuint b)
+	{
+		return call(function, a) + " " + std::to_string(b);
+	}
+
+	GLBackend getRecordingBackend()
+	{
+		GLBackend backend;
+		backend.useProgram = [](GLuint program) { calls.push_back(call("useProgram", program)); };
+		backend.activeTexture = [](GLenum unit) { calls.push_back(call("activeTexture", unit)); };
+		backend.bindTexture = [](GLenum target, GLuint texture) { calls.push_back(call("bindTexture", target, texture)); };
+		backend.bindVertexArray = [](GLuint vao) { calls.push_back(call("bindVertexArray", vao)); };
+		backend.setCapability = [](GLenum capability, bool enabled) { calls.push_back(call(enabled ? "enable" : "disable", capability)); };
+		backend.cullFace = [](GLenum face) { calls.push_back(call("cullFace", face)); };
+		backend.depthMask = [](GLboolean flag) { calls.push_back(call("depthMask", flag)); };
+		backend.polygonMode = [](GLenum face, GLenum mode) { calls.push_back(call("polygonMode", face, mode)); };
+		return backend;
+	}
+
+	struct RecordingTest : testing::Test
+	{
+		GLStateCache cache;
+
+		void SetUp() override
+		{
+			calls.clear();
+			initStateCache(cache, getRecordingBackend());
+		}
+	};
+
+	DrawState makeState(GLuint program, GLuint vao)
+	{
+		DrawState state;
+		state.program = program;
+		state.vao = vao;
+		return state;
+	}
+
+	void addLoggedDraw(RenderQueue& queue, uint64_t key, const char* name, const DrawState& state)
+	{
+		addDraw(queue, key, name, state, [name]() { calls.push_back(std::string("draw ") + name); });
+	}
+}
+
+TEST_F(RecordingTest, StateCacheSkipsCallsThatChangeNothing)
+{
+	setProgram(cache, 3);
+	setProgram(cache, 3);
+	setTexture(cache, 0, GL_TEXTURE_2D, 5);
+	setTexture(cache, 0, GL_TEXTURE_2D, 5);
+	setTexture(cache, 0, GL_TEXTURE_2D_ARRAY, 5);
+	setTexture(cache, 2, GL_TEXTURE_2D, 6);
+	setTexture(cache, 2, GL_TEXTURE_2D, 7);
+	setCullFace(cache, GL_BACK);
+	setCullFace(cache, GL_FRONT);
+	setCullFace(cache, GL_NONE);
+	setCullFace(cache, GL_NONE);
+	setDepthMask(cache, false);
+	setDepthMask(cache, false);
+	setPolygonMode(cache, GL_LINE);
+	setVertexArray(cache, 0);
+
+	std::vector<std::string> expected =
+	{
+		call("useProgram", 3),
+		call("activeTexture", GL_TEXTURE0), call("bindTexture", GL_TEXTURE_2D, 5),
+		//Another target on the same unit is bound again, the active unit stays
+		call("bindTexture", GL_TEXTURE_2D_ARRAY, 5),
+		call("activeTexture", GL_TEXTURE2), call("bindTexture", GL_TEXTURE_2D, 6),
+		call("bindTexture", GL_TEXTURE_2D, 7),
+		call("enable", GL_CULL_FACE), call("cullFace", GL_BACK),
+		call("cullFace", GL_FRONT),
+		call("disable", GL_CULL_FACE),
+		call("depthMask", GL_FALSE),
+		call("polygonMode", GL_FRONT_AND_BACK, GL_LINE),
+		call("bindVertexArray", 0),
+	};
+	EXPECT_EQ(calls, expected);
+	EXPECT_EQ(cache.issuedCalls, 13u);
+	EXPECT_EQ(cache.skippedCalls, 6u);
+}
+
+TEST_F(RecordingTest, InvalidatedStateIsSetOnceMore)
+{
+	setProgram(cache, 1);
+	setTexture(cache, 1, GL_TEXTURE_2D, 4);
+	invalidateStateCache(cache);
+	calls.clear();
+	for (int i = 0; i < 2; i++)
+	{
+		setProgram(cache, 1);
+		setTexture(cache, 1, GL_TEXTURE_2D, 4);
+	}
+	std::vector<std::string> expected = { call("useProgram", 1), call("activeTexture", GL_TEXTURE1), call("bindTexture", GL_TEXTURE_2D, 4) };
+	EXPECT_EQ(calls, expected);
+}
+
+TEST_F(RecordingTest, QueueRunsDrawsInKeyOrderWithTheirState)
+{
+	RenderQueue queue;
+	setPassSetup(queue, 0, []() { calls.push_back("setup 0"); });
+	//Pass 2 has no draws, its setup runs after the last draw
+	setPassSetup(queue, 2, []() { calls.push_back("setup 2"); });
+
+	DrawState tree = makeState(2, 3);
+	tree.textureTargets[0] = GL_TEXTURE_2D;
+	tree.textures[0] = 7;
+	tree.cullFace = GL_BACK;
+	DrawState terrain = makeState(1, 3);
+	terrain.textureTargets[0] = GL_TEXTURE_2D;
+	terrain.textures[0] = 9;
+	terrain.textureTargets[1] = GL_TEXTURE_2D_ARRAY;
+	terrain.textures[1] = 11;
+	terrain.depthWrite = false;
+
+	addLoggedDraw(queue, makeSortKey(1, 2, 7, 3), "first tree", tree);
+	addLoggedDraw(queue, makeSortKey(0, 1, 0, 4), "shadow", makeState(1, 4));
+	addLoggedDraw(queue, makeSortKey(1, 2, 7, 3), "second tree", tree);
+	addLoggedDraw(queue, makeSortKey(1, 1, 9, 3), "terrain", terrain);
+	executeRenderQueue(queue, cache);
+
+	std::vector<std::string> expected =
+	{
+		//Setups run with depth writes on
+		call("depthMask", GL_TRUE),
+		"setup 0",
+		call("useProgram", 1), call("bindVertexArray", 4), call("disable", GL_CULL_FACE), call("polygonMode", GL_FRONT_AND_BACK, GL_FILL),
+		"draw shadow",
+		call("activeTexture", GL_TEXTURE0), call("bindTexture", GL_TEXTURE_2D, 9),
+		call("activeTexture", GL_TEXTURE1), call("bindTexture", GL_TEXTURE_2D_ARRAY, 11),
+		call("bindVertexArray", 3), call("depthMask", GL_FALSE),
+		"draw terrain",
+		call("useProgram", 2), call("activeTexture", GL_TEXTURE0), call("bindTexture", GL_TEXTURE_2D, 7),
+		call("enable", GL_CULL_FACE), call("cullFace", GL_BACK), call("depthMask", GL_TRUE),
+		"draw first tree",
+		//Draws with equal keys keep the order they were added in and share all of their state
+		"draw second tree",
+		"setup 2",
+	};
+	EXPECT_EQ(calls, expected);
+	EXPECT_EQ(cache.issuedCalls, 16u);
+	EXPECT_EQ(cache.skippedCalls, 13u);
+
+	//The next frame starts from the state the last draw left behind
+	calls.clear();
+	executeRenderQueue(queue, cache);
+	expected =
+	{
+		"setup 0",
+		call("useProgram", 1), call("bindVertexArray", 4), call("disable", GL_CULL_FACE),
+		"draw shadow",
+		call("bindTexture", GL_TEXTURE_2D, 9), call("bindVertexArray", 3), call("depthMask", GL_FALSE),
+		"draw terrain",
+		call("useProgram", 2), call("bindTexture", GL_TEXTURE_2D, 7), call("enable", GL_CULL_FACE), call("cullFace", GL_BACK), call("depthMask", GL_TRUE),
+		"draw first tree",
+		"draw second tree",
+		"setup 2",
+	};
+	EXPECT_EQ(calls, expected);
+}
+
+TEST(RenderQueue, RadixSortMatchesStableSort)
+{
+	std::mt19937 random(7);
+	for (size_t count : { 0, 1, 2, 255, 256, 5000 })
+	{
+		//Few distinct ids per field, so many keys are equal and whole bytes are the same in every key
+		std::uniform_int_distribution<uint32_t> pass(0, 3), program(1, 5), material(0, 300), vao(1, 2);
+		RenderQueue queue;
+		for (size_t i = 0; i < count; i++)
+			addDraw(queue, makeSortKey(pass(random), program(random), material(random), vao(random)), "", DrawState(), nullptr);
+		sortRenderQueue(queue);
+
+		std::vector<uint32_t> expected(count);
+		std::iota(expected.begin(), expected.end(), 0);
+		std::stable_sort(expected.begin(), expected.end(), [&queue](uint32_t a, uint32_t b) { return queue.items[a].key < queue.items[b].key; });
+		EXPECT_EQ(queue.order, expected) << count << " draws";
+	}
+
+	//Keys that differ in every byte
+	RenderQueue queue;
+	std::uniform_int_distribution<uint64_t> key;
+	for (int i = 0; i < 1000; i++)
+		addDraw(queue, key(random), "", DrawState(), nullptr);
+	sortRenderQueue(queue);
+	for (size_t i = 1; i < queue.order.size(); i++)
+		EXPECT_LE(queue.items[queue.order[i - 1]].key, queue.items[queue.order[i]].key);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include "ShadowCascades.h"
+
+namespace
+{
+	const float FOV_Y = glm::radians(70.f);
+	const float ASPECT = 16.f / 9.f;
+	const float NEAR = 0.5f;
+
+	//Large enough to hold every slice, so no cascade is clamped to the scene and the depth range covers the whole frustum
+	const AABB SCENE_BOUNDS = { glm::vec3(-1000.f), glm::vec3(1000.f) };
+
+	struct Camera
+	{
+		glm::vec3 position, forward;
+	};
+
+	const Camera CAMERAS[] =
+	{
+		{ glm::vec3(20.f, 4.f, 20.f), glm::vec3(25.f, -2.f, 20.f) },
+		{ glm::vec3(-3.f, 12.f, 40.f), glm::vec3(0.f, -1.f, -4.f) },
+		{ glm::vec3(7.f, 1.f, -9.f), glm::vec3(-1.f, 0.3f, 0.f) },
+	};
+
+	const glm::vec3 LIGHT_DIRECTIONS[] = { glm::vec3(-11.f, -5.f, -11.f), glm::vec3(0.f, -1.f, 0.f), glm::vec3(3.f, -8.f, 1.f) };
+
+	glm::mat4 getView(const Camera& camera)
+	{
+		return glm::lookAt(camera.position, camera.position + camera.forward, glm::vec3(0.f, 1.f, 0.f));
+	}
+
+	//Corner c of the slice of the view frustum between the two view space depths
+	glm::vec3 getSliceCorner(const glm::mat4& view, float sliceNear, float sliceFar, int c)
+	{
+		float tanY = std::tan(FOV_Y / 2.f);
+		float depth = (c & 4) ? sliceFar : sliceNear;
+		glm::vec4 viewCorner(((c & 1) ? 1.f : -1.f) * tanY * ASPECT * depth, ((c & 2) ? 1.f : -1.f) * tanY * depth, -depth, 1.f);
+		return glm::vec3(glm::inverse(view) * viewCorner);
+	}
+
+	//Row of the light transform that gives the x (0) or y (1) coordinate in clip space
+	glm::vec3 getClipRow(const glm::mat4& lightTransform, int row)
+	{
+		return glm::vec3(lightTransform[0][row], lightTransform[1][row], lightTransform[2][row]);
+	}
+}
+
+TEST(ShadowCascades, LastSplitIsMaxDistance)
+{
+	for (int count = 1; count <= MAX_SHADOW_CASCADES; count++)
+	{
+		for (float lambda : { 0.f, 0.5f, 0.8f, 1.f })
+		{
+			CascadeSettings settings;
+			settings.count = count;
+			settings.splitLambda = lambda;
+			settings.maxDistance = 137.f;
+			ShadowCascade cascades[MAX_SHADOW_CASCADES];
+			fitShadowCascades(settings, getView(CAMERAS[0]), FOV_Y, ASPECT, NEAR, LIGHT_DIRECTIONS[0], SCENE_BOUNDS, cascades);
+			EXPECT_EQ(cascades[count - 1].splitDepth, settings.maxDistance) << count << " cascades, lambda " << lambda;
+			float previous = NEAR;
+			for (int i = 0; i < count; i++)
+			{
+				EXPECT_GT(cascades[i].splitDepth, previous) << "Cascade " << i << " of " << count << ", lambda " << lambda;
+				previous = cascades[i].splitDepth;
+			}
+		}
+	}
+}
+
+TEST(ShadowCascades, SliceCornersAreInsideTheirCascade)
+{
+	for (float snapFraction : { 0.f, 0.125f, 0.5f })
+	{
+		for (const Camera& camera : CAMERAS)
+		{
+			for (const glm::vec3& lightDir : LIGHT_DIRECTIONS)
+			{
+				CascadeSettings settings;
+				settings.snapFraction = snapFraction;
+				glm::mat4 view = getView(camera);
+				ShadowCascade cascades[MAX_SHADOW_CASCADES];
+				fitShadowCascades(settings, view, FOV_Y, ASPECT, NEAR, lightDir, SCENE_BOUNDS, cascades);
+				float sliceNear = NEAR;
+				for (int i = 0; i < settings.count; i++)
+				{
+					for (int c = 0; c < 8; c++)
+					{
+						glm::vec4 clip = cascades[i].lightTransform * glm::vec4(getSliceCorner(view, sliceNear, cascades[i].splitDepth, c), 1.f);
+						for (int axis = 0; axis < 3; axis++)
+							EXPECT_LE(std::fabs(clip[axis]), 1.f + 1e-4f) << "Cascade " << i << ", corner " << c << ", axis " << axis << ", snap " << snapFraction;
+					}
+					sliceNear = cascades[i].splitDepth;
+				}
+			}
+		}
+	}
+}
+
+//The center of a slice's bounding sphere sits on the view axis, halfway between the ends of the slice. Moving the camera so that center stays within
+//half a snapping step of the cascade's center keeps the cascade where it is, moving it further shifts the cascade
+TEST(ShadowCascades, StaysPutForMovesWithinASnapStep)
+{
+	CascadeSettings settings;
+	const float halfStep = settings.snapFraction;
+	for (const Camera& camera : CAMERAS)
+	{
+		for (const glm::vec3& lightDir : LIGHT_DIRECTIONS)
+		{
+			ShadowCascade cascades[MAX_SHADOW_CASCADES];
+			fitShadowCascades(settings, getView(camera), FOV_Y, ASPECT, NEAR, lightDir, SCENE_BOUNDS, cascades);
+			float sliceNear = NEAR;
+			for (int i = 0; i < settings.count; i++)
+			{
+				const glm::mat4& lightTransform = cascades[i].lightTransform;
+				glm::vec3 sphereCenter = camera.position + glm::normalize(camera.forward) * ((sliceNear + cascades[i].splitDepth) / 2.f);
+				glm::vec4 clipCenter = lightTransform * glm::vec4(sphereCenter, 1.f);
+				ASSERT_LE(std::fabs(clipCenter.x), halfStep + 1e-4f);
+				ASSERT_LE(std::fabs(clipCenter.y), halfStep + 1e-4f);
+
+				//Puts the sphere's center at the given clip space position of the original cascade
+				auto moveTo = [&](float x, float y)
+				{
+					glm::vec3 rowX = getClipRow(lightTransform, 0), rowY = getClipRow(lightTransform, 1);
+					glm::vec3 offset = rowX * ((x - clipCenter.x) / glm::dot(rowX, rowX)) + rowY * ((y - clipCenter.y) / glm::dot(rowY, rowY));
+					Camera moved = { camera.position + offset, camera.forward };
+					ShadowCascade movedCascades[MAX_SHADOW_CASCADES];
+					fitShadowCascades(settings, getView(moved), FOV_Y, ASPECT, NEAR, lightDir, SCENE_BOUNDS, movedCascades);
+					return movedCascades[i].lightTransform;
+				};
+				for (float x : { -0.9f, 0.f, 0.9f })
+				{
+					for (float y : { -0.9f, 0.9f })
+						EXPECT_TRUE(moveTo(x * halfStep, y * halfStep) == lightTransform) << "Cascade " << i << " moved to " << x << ", " << y;
+				}
+				EXPECT_FALSE(moveTo(1.5f * halfStep, 0.f) == lightTransform) << "Cascade " << i;
+				EXPECT_FALSE(moveTo(0.f, -1.5f * halfStep) == lightTransform) << "Cascade " << i;
+				sliceNear = cascades[i].splitDepth;
+			}
+		}
+	}
+}
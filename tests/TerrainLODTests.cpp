@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "SyntheticData.h"
+#include "TerrainLOD.h"
+
+namespace
+{
+	const int SAMPLES = 256;
+	const float TERRAIN_SIZE = 50.f;
+	const size_t QUADRANT_TRIANGLES = (TERRAIN_PATCH_SIZE / 2) * (TERRAIN_PATCH_SIZE / 2) * 2;
+
+	struct TerrainLODTest : testing::Test
+	{
+		TerrainLOD lod;
+		TerrainDrawList drawList;
+
+		void SetUp() override
+		{
+			std::vector<float> heights = makeTerrainHeights(SAMPLES);
+			buildTerrainLOD(heights.data(), SAMPLES, TERRAIN_SIZE, lod);
+		}
+	};
+
+	//Orthographic view straight down that holds the whole terrain
+	Frustum getTopDownFrustum()
+	{
+		glm::vec3 center(TERRAIN_SIZE / 2.f, 0.f, TERRAIN_SIZE / 2.f);
+		glm::mat4 view = glm::lookAt(center + glm::vec3(0.f, 100.f, 0.f), center, glm::vec3(0.f, 0.f, 1.f));
+		return extractFrustum(glm::ortho(-30.f, 30.f, -30.f, 30.f, 1.f, 200.f) * view);
+	}
+
+	Frustum getCameraFrustum(const glm::vec3& position, const glm::vec3& target)
+	{
+		glm::mat4 view = glm::lookAt(position, target, glm::vec3(0.f, 1.f, 0.f));
+		return extractFrustum(glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 100.f) * view);
+	}
+
+	//Area in samples covered by the drawn quadrants of every patch
+	size_t getDrawnArea(const TerrainDrawList& drawList)
+	{
+		size_t area = 0;
+		for (const TerrainPatch& patch : drawList.patches)
+		{
+			for (int i = 0; i < 4; i++)
+				area += patch.quadrantMask & (1 << i) ? (size_t)(patch.size / 2) * (patch.size / 2) : 0;
+		}
+		return area;
+	}
+
+	size_t countTriangles(const TerrainDrawList& drawList)
+	{
+		size_t triangles = 0;
+		for (const TerrainPatch& patch : drawList.patches)
+		{
+			for (int i = 0; i < 4; i++)
+				triangles += patch.quadrantMask & (1 << i) ? QUADRANT_TRIANGLES : 0;
+		}
+		return triangles;
+	}
+}
+
+TEST_F(TerrainLODTest, UnlimitedRangesDrawFullResolution)
+{
+	//Without computeLODRanges every level reaches any distance, so every node is refined down to level 0
+	selectTerrainLOD(lod, glm::vec3(25.f, 4.f, 25.f), getTopDownFrustum(), drawList);
+	size_t nodes = (SAMPLES / TERRAIN_PATCH_SIZE) * (SAMPLES / TERRAIN_PATCH_SIZE);
+	EXPECT_EQ(drawList.patches.size(), nodes);
+	EXPECT_EQ(drawList.triangleCount, nodes * 4 * QUADRANT_TRIANGLES);
+
+	TerrainDrawList fullResolution;
+	selectTerrainFullResolution(lod, getTopDownFrustum(), fullResolution);
+	EXPECT_EQ(fullResolution.triangleCount, drawList.triangleCount);
+	EXPECT_FALSE(fullResolution.morph);
+}
+
+TEST_F(TerrainLODTest, DistantCameraDrawsRoots)
+{
+	computeLODRanges(lod, glm::radians(70.f), 1080.f, 2.f);
+	selectTerrainLOD(lod, glm::vec3(25.f, 1e6f, 25.f), getTopDownFrustum(), drawList);
+	ASSERT_EQ(drawList.patches.size(), lod.roots.size());
+	EXPECT_EQ(drawList.patches[0].level, (int)lod.ranges.size() - 1);
+	EXPECT_EQ(drawList.triangleCount, lod.roots.size() * 4 * QUADRANT_TRIANGLES);
+}
+
+TEST_F(TerrainLODTest, SelectionTilesTheTerrain)
+{
+	computeLODRanges(lod, glm::radians(70.f), 1080.f, 2.f);
+	selectTerrainLOD(lod, glm::vec3(20.f, 4.f, 20.f), getTopDownFrustum(), drawList);
+	//Every sample is covered by exactly one quadrant, and near nodes are finer than the roots
+	EXPECT_EQ(getDrawnArea(drawList), (size_t)SAMPLES * SAMPLES);
+	EXPECT_EQ(drawList.triangleCount, countTriangles(drawList));
+	EXPECT_GT(drawList.triangleCount, lod.roots.size() * 4 * QUADRANT_TRIANGLES);
+	EXPECT_TRUE(drawList.morph);
+}
+
+TEST_F(TerrainLODTest, CameraViewDrawsPartOfTheTerrain)
+{
+	computeLODRanges(lod, glm::radians(70.f), 1080.f, 2.f);
+	glm::vec3 position(20.f, 4.f, 20.f);
+	selectTerrainLOD(lod, position, getCameraFrustum(position, glm::vec3(45.f, 2.f, 40.f)), drawList);
+	EXPECT_GT(drawList.triangleCount, 0u);
+	EXPECT_EQ(drawList.triangleCount, countTriangles(drawList));
+	EXPECT_LT(getDrawnArea(drawList), (size_t)SAMPLES * SAMPLES);
+}
+
+TEST_F(TerrainLODTest, FrustumFacingAwayDrawsNothing)
+{
+	computeLODRanges(lod, glm::radians(70.f), 1080.f, 2.f);
+	//Standing past the terrain's edge looking further out
+	glm::vec3 position(-5.f, 4.f, 25.f);
+	Frustum frustum = getCameraFrustum(position, glm::vec3(-50.f, 4.f, 25.f));
+	selectTerrainLOD(lod, position, frustum, drawList);
+	EXPECT_TRUE(drawList.patches.empty());
+	EXPECT_EQ(drawList.triangleCount, 0u);
+
+	selectTerrainFullResolution(lod, frustum, drawList);
+	EXPECT_TRUE(drawList.patches.empty());
+	EXPECT_EQ(drawList.triangleCount, 0u);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "TextureCache.h"
+
+namespace
+{
+	const SourceStamp stamp = { 99, 42 };
+
+	std::vector<uint8_t> makeImage(uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> pixels((size_t)width * height * 4);
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = i % 4 == 3 ? 255 : (uint8_t)(i * 37);
+		return pixels;
+	}
+
+	BakedTextureHeader& getHeader(std::vector<char>& baked)
+	{
+		return *(BakedTextureHeader*)baked.data();
+	}
+
+	BakedTextureLevel* getLevels(std::vector<char>& baked)
+	{
+		return (BakedTextureLevel*)(baked.data() + sizeof(BakedTextureHeader));
+	}
+}
+
+TEST(TextureCache, LevelsMatchTheirSize)
+{
+	for (TextureCompression compression : { TextureCompression::None, TextureCompression::BC1, TextureCompression::BC3 })
+	{
+		std::vector<uint8_t> pixels = makeImage(37, 10);
+		std::vector<char> baked;
+		bakeTexture(pixels.data(), 37, 10, compression, false, stamp, baked);
+		BakedTextureView view;
+		ASSERT_TRUE(readBakedTexture(baked.data(), baked.size(), stamp, compression, false, view));
+		ASSERT_EQ(view.header->levelCount, 6u);
+		EXPECT_EQ(view.levels[5].width, 1u);
+		EXPECT_EQ(view.levels[5].height, 1u);
+		if (compression == TextureCompression::None)
+		{
+			EXPECT_EQ(memcmp(view.data + view.levels[0].offset, pixels.data(), pixels.size()), 0);
+		}
+	}
+}
+
+TEST(TextureCache, OddColumnsAreFiltered)
+{
+	//A 5x1 image whose last texel is the only bright one. Halving it has to keep part of that texel in the last of the two texels
+	std::vector<uint8_t> pixels(5 * 4, 0);
+	for (int i = 0; i < 5; i++)
+		pixels[i * 4 + 3] = 255;
+	pixels[4 * 4] = 255;
+	std::vector<char> baked;
+	bakeTexture(pixels.data(), 5, 1, TextureCompression::None, false, stamp, baked);
+	BakedTextureView view;
+	ASSERT_TRUE(readBakedTexture(baked.data(), baked.size(), stamp, TextureCompression::None, false, view));
+	const uint8_t* level = (const uint8_t*)view.data + view.levels[1].offset;
+	ASSERT_EQ(view.levels[1].width, 2u);
+	EXPECT_EQ((int)level[0], 0);
+	EXPECT_EQ((int)level[4], 85);
+	//The 1x1 level averages the two texels of the level above
+	EXPECT_EQ((int)((const uint8_t*)view.data + view.levels[2].offset)[0], 43);
+}
+
+TEST(TextureCache, RejectsCorruptFiles)
+{
+	std::vector<uint8_t> pixels = makeImage(16, 8);
+	std::vector<char> original;
+	bakeTexture(pixels.data(), 16, 8, TextureCompression::None, false, stamp, original);
+	BakedTextureView view;
+	ASSERT_TRUE(readBakedTexture(original.data(), original.size(), stamp, TextureCompression::None, false, view));
+
+	auto isRejected = [&](void (*corrupt)(std::vector<char>& baked))
+	{
+		std::vector<char> baked = original;
+		corrupt(baked);
+		return !readBakedTexture(baked.data(), baked.size(), stamp, TextureCompression::None, false, view);
+	};
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { baked.resize(baked.size() - 1); }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getLevels(baked)[0].bytes -= 4; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getLevels(baked)[0].width++; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getLevels(baked)[2].height = 7; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).width = 32; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).levelCount = 2; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).compression = TextureCompression::BC1; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).compression = TextureCompression::Auto; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getHeader(baked).internalFormat = 0; }));
+	EXPECT_TRUE(isRejected([](std::vector<char>& baked) { getLevels(baked)[1].offset = ~(uint64_t)0 - 8; }));
+}
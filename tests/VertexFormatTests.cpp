@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include "VertexFormat.h"
+
+//Every codec is checked against the largest error its bits allow, measured over random inputs
+
+namespace
+{
+	const int SAMPLE_COUNT = 100000;
+
+	std::vector<Normal> makeRandomNormals(int count)
+	{
+		std::mt19937 random(7);
+		std::normal_distribution<float> gaussian;
+		std::vector<Normal> normals(count);
+		for (Normal& normal : normals)
+		{
+			float x = gaussian(random), y = gaussian(random), z = gaussian(random);
+			float length = std::sqrt(x * x + y * y + z * z);
+			normal = { x / length, y / length, z / length };
+		}
+		//The poles and the folded edges of the octahedron
+		normals[0] = { 0.f, 0.f, 1.f };
+		normals[1] = { 0.f, 0.f, -1.f };
+		normals[2] = { 1.f, 0.f, 0.f };
+		normals[3] = { 0.f, -1.f, 0.f };
+		normals[4] = { 0.70710678f, 0.f, -0.70710678f };
+		return normals;
+	}
+
+	//In degrees. atan2 of the sine and cosine stays exact for small angles where acos of a float cosine doesn't
+	float getAngle(const Normal& a, const Normal& b)
+	{
+		double crossX = (double)a.y * b.z - (double)a.z * b.y, crossY = (double)a.z * b.x - (double)a.x * b.z, crossZ = (double)a.x * b.y - (double)a.y * b.x;
+		double cosine = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+		return (float)(std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), cosine) * 180.0 / 3.14159265358979);
+	}
+
+	//Decodes the positions of packed vertices the way the vertex shader does
+	std::vector<Vertex> decodePositions(const VertexFormat& format, const PackedVertices& packed, size_t count)
+	{
+		std::vector<Vertex> positions(count);
+		for (size_t v = 0; v < count; v++)
+		{
+			uint16_t stored[3];
+			memcpy(stored, &packed.data[v * packed.stride], sizeof(stored));
+			float* position = &positions[v].x;
+			for (int i = 0; i < 3; i++)
+			{
+				float local = format.position == PositionFormat::Half ? halfToFloat(stored[i]) : stored[i] / 65535.f;
+				position[i] = packed.positionOffset[i] + packed.positionScale[i] * local;
+			}
+		}
+		return positions;
+	}
+
+	std::vector<Vertex> makeRandomPositions(int count)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> x(-20.f, 30.f), y(0.f, 9.f), z(100.f, 101.f);
+		std::vector<Vertex> positions(count);
+		for (Vertex& position : positions)
+			position = { x(random), y(random), z(random) };
+		return positions;
+	}
+
+	//Largest error per axis over all positions, relative to the extent of the bounds on that axis
+	float getRelativePositionError(PositionFormat positionFormat)
+	{
+		std::vector<Vertex> positions = makeRandomPositions(SAMPLE_COUNT);
+		std::vector<Normal> normals = makeRandomNormals(SAMPLE_COUNT);
+		VertexFormat format = { positionFormat, NormalFormat::Float, UVFormat::Float };
+		PackedVertices packed;
+		packVertices(format, positions.data(), normals.data(), nullptr, positions.size(), packed);
+		std::vector<Vertex> decoded = decodePositions(format, packed, positions.size());
+
+		float largest = 0.f;
+		for (size_t v = 0; v < positions.size(); v++)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				float extent = packed.boundsMax[i] - packed.boundsMin[i];
+				largest = std::max(largest, std::fabs((&decoded[v].x)[i] - (&positions[v].x)[i]) / extent);
+			}
+		}
+		return largest;
+	}
+}
+
+TEST(VertexFormat, HalfRoundTripsEveryHalf)
+{
+	for (uint32_t bits = 0; bits <= 0xFFFF; bits++)
+	{
+		uint16_t half = (uint16_t)bits;
+		//NaNs keep being NaNs but not their payload
+		if ((half & 0x7C00) == 0x7C00 && (half & 0x3FF))
+			continue;
+		ASSERT_EQ(floatToHalf(halfToFloat(half)), half) << "half 0x" << std::hex << bits;
+	}
+}
+
+TEST(VertexFormat, HalfRoundsToNearest)
+{
+	EXPECT_EQ(halfToFloat(floatToHalf(1.f + 1.f / 4096.f)), 1.f);
+	EXPECT_EQ(halfToFloat(floatToHalf(1.f + 3.f / 4096.f)), 1.f + 1.f / 1024.f);
+	EXPECT_EQ(floatToHalf(70000.f), 0x7C00);
+	EXPECT_EQ(floatToHalf(-1e-9f), 0x8000);
+}
+
+TEST(VertexFormat, Unorm16PositionError)
+{
+	//Half a step of 65535 steps over the bounds, plus float rounding
+	EXPECT_LE(getRelativePositionError(PositionFormat::Unorm16), 0.5f / 65535.f + 1e-6f);
+}
+
+TEST(VertexFormat, HalfPositionError)
+{
+	//Positions are stored in [0, 1] over the bounds, where halves are at most 2^-11 apart
+	EXPECT_LE(getRelativePositionError(PositionFormat::Half), 1.f / 4096.f + 1e-6f);
+}
+
+TEST(VertexFormat, OctahedralNormalError)
+{
+	std::vector<Normal> normals = makeRandomNormals(SAMPLE_COUNT);
+	float largest = 0.f;
+	for (const Normal& normal : normals)
+	{
+		int16_t encoded[2];
+		encodeOctahedral(normal, encoded);
+		largest = std::max(largest, getAngle(normal, decodeOctahedral(encoded)));
+	}
+	//Measured at 0.0037 degrees, snorm16 octahedral normals are good to a few thousandths of a degree
+	EXPECT_LE(largest, 0.005f);
+}
+
+TEST(VertexFormat, Int2101010NormalError)
+{
+	std::vector<Normal> normals = makeRandomNormals(SAMPLE_COUNT);
+	float largest = 0.f;
+	for (const Normal& normal : normals)
+		largest = std::max(largest, getAngle(normal, decodeInt2101010(encodeInt2101010(normal))));
+	//Half a step of 511 on every component, measured at 0.094 degrees
+	EXPECT_LE(largest, 0.15f);
+}
+
+TEST(VertexFormat, HalfUVError)
+{
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> coordinate(-4.f, 4.f);
+	for (int i = 0; i < SAMPLE_COUNT; i++)
+	{
+		UV uv = { coordinate(random), coordinate(random) };
+		VertexFormat format = { PositionFormat::Float, NormalFormat::Float, UVFormat::Half };
+		Vertex position = { 0.f, 0.f, 0.f };
+		Normal normal = { 0.f, 1.f, 0.f };
+		PackedVertices packed;
+		packVertices(format, &position, &normal, &uv, 1, packed);
+		uint16_t stored[2];
+		memcpy(stored, &packed.data[packed.attributes[2].offset], sizeof(stored));
+		//Relative rounding error of a half, and half the spacing of denormals near 0
+		ASSERT_LE(std::fabs(halfToFloat(stored[0]) - uv.u), std::fabs(uv.u) / 2048.f + 1.f / 33554432.f);
+		ASSERT_LE(std::fabs(halfToFloat(stored[1]) - uv.v), std::fabs(uv.v) / 2048.f + 1.f / 33554432.f);
+	}
+}